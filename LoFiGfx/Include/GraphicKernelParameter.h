@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Parameter handles and type names, the only LoFi types a header from LoFiShaderCodegen refers to.
+namespace LoFi::Component {
+      // A struct or struct member resolved once, setting through it skips the name lookup.
+      struct GraphicKernelParameterHandle {
+            uint32_t StructIndex = UINT32_MAX;
+            uint32_t Offset = 0;
+            uint32_t Size = 0;
+            uint64_t TypeHash = 0; // XXH64 of the reflected type name, see ShaderTypeName
+
+            [[nodiscard]] bool IsValid() const { return StructIndex != UINT32_MAX; }
+      };
+
+      // Reflected type names of the C++ types that map one to one onto a glsl scalar, other types are only size checked.
+      // A bool member of a block is reflected as uint, bool is written as a 4 byte uint32_t.
+      template <class T> struct ShaderTypeName { static constexpr std::string_view Value{}; };
+      template <> struct ShaderTypeName<bool> { static constexpr std::string_view Value = "uint"; };
+      template <> struct ShaderTypeName<int32_t> { static constexpr std::string_view Value = "int"; };
+      template <> struct ShaderTypeName<uint32_t> { static constexpr std::string_view Value = "uint"; };
+      template <> struct ShaderTypeName<int64_t> { static constexpr std::string_view Value = "int64"; };
+      template <> struct ShaderTypeName<uint64_t> { static constexpr std::string_view Value = "uint64"; };
+      template <> struct ShaderTypeName<float> { static constexpr std::string_view Value = "float"; };
+      template <> struct ShaderTypeName<double> { static constexpr std::string_view Value = "double"; };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Helper.h"
+
+#include <cstring>
+
+namespace LoFi::Internal {
+
+      // Minimal binary serialization for the on-disk caches, values are stored with the host layout.
+      class BinaryWriter {
+      public:
+            template <class T> requires std::is_trivially_copyable_v<T>
+            void Write(const T& value) {
+                  const auto ptr = (const uint8_t*)&value;
+                  _data.insert(_data.end(), ptr, ptr + sizeof(T));
+            }
+
+            template <class T> requires std::is_trivially_copyable_v<T>
+            void WriteVector(const std::vector<T>& values) {
+                  Write((uint64_t)values.size());
+                  const auto ptr = (const uint8_t*)values.data();
+                  _data.insert(_data.end(), ptr, ptr + values.size() * sizeof(T));
+            }
+
+            void WriteString(std::string_view str) {
+                  Write((uint64_t)str.size());
+                  _data.insert(_data.end(), str.begin(), str.end());
+            }
+
+            [[nodiscard]] const std::vector<uint8_t>& GetData() const { return _data; }
+
+      private:
+            std::vector<uint8_t> _data{};
+      };
+
+      // Every read returns false once the stream is exhausted, a truncated file simply fails to load.
+      class BinaryReader {
+      public:
+            explicit BinaryReader(std::span<const uint8_t> data) : _data(data) {}
+
+            template <class T> requires std::is_trivially_copyable_v<T>
+            bool Read(T& value) {
+                  if (_cursor + sizeof(T) > _data.size()) return false;
+                  std::memcpy(&value, _data.data() + _cursor, sizeof(T));
+                  _cursor += sizeof(T);
+                  return true;
+            }
+
+            template <class T> requires std::is_trivially_copyable_v<T>
+            bool ReadVector(std::vector<T>& values) {
+                  uint64_t count = 0;
+                  if (!Read(count) || count > (_data.size() - _cursor) / std::max<size_t>(sizeof(T), 1)) return false;
+                  values.resize(count);
+                  std::memcpy(values.data(), _data.data() + _cursor, count * sizeof(T));
+                  _cursor += count * sizeof(T);
+                  return true;
+            }
+
+            bool ReadString(std::string& str) {
+                  uint64_t size = 0;
+                  if (!Read(size) || size > _data.size() - _cursor) return false;
+                  str.assign((const char*)_data.data() + _cursor, size);
+                  _cursor += size;
+                  return true;
+            }
+
+            [[nodiscard]] bool IsEnd() const { return _cursor == _data.size(); }
+
+      private:
+            std::span<const uint8_t> _data;
+
+            size_t _cursor = 0;
+      };
+}
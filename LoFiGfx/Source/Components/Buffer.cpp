@@ -80,40 +80,26 @@ void Buffer::SetData(const void* p, uint64_t size) {
             memcpy(Map(), p, size);
             _vaildSize = size;
       } else {
-            if (_intermediateBuffer == nullptr) {
-                  // create a upload buffer
-
-                  auto str = std::format(R"(Buffer::SetData - Try UpLoad To device buffer, using Intermediate Buffer)");
-                  MessageManager::Log(MessageType::Normal, str);
-
-                  _intermediateBuffer = std::make_unique<Buffer>(VkBufferCreateInfo{
-                        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                        .pNext = nullptr,
-                        .flags = 0,
-                        .size = size,
-                        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                        .queueFamilyIndexCount = 0,
-                        .pQueueFamilyIndices = nullptr
-                  }, VmaAllocationCreateInfo{
-                        .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
-                        .requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                  });
-            }
-
-            _intermediateBuffer->SetData(p, size);
-
-            auto imm_buffer = _intermediateBuffer->GetBuffer();
-            auto trans_size = size;
+            const auto staging = Context::Get()->UploadToStaging(p, size);
 
             const VkBufferCopy copyinfo{
-                  .srcOffset = 0,
+                  .srcOffset = staging.Offset,
                   .dstOffset = 0,
-                  .size = trans_size
+                  .size = size
             };
 
+            auto imm_buffer = staging.Buffer;
             auto buffer = _buffer;
+            auto id = _id;
             LoFi::Context::Get()->EnqueueCommand([ =](VkCommandBuffer cmd) {
+                  // the copy may run after a recreate, only the buffer it targets carries the tracked state
+                  auto ctx = LoFi::Context::Get();
+                  auto& world = *volkGetLoadedEcsWorld();
+                  auto self = id != entt::null && world.valid(id) ? world.try_get<Buffer>(id) : nullptr;
+                  if (self && self->GetBuffer() == buffer) {
+                        ctx->TrackBufferAccess(*self, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+                        ctx->FlushBarriers(cmd);
+                  }
                   vkCmdCopyBuffer(cmd, imm_buffer, buffer, 1, &copyinfo);
             });
 
@@ -129,6 +115,7 @@ void Buffer::Recreate(uint64_t size) {
 
       _bufferCI->size = size;
       _vaildSize = 0;
+      _accessState = {};
 
       if (vmaCreateBuffer(volkGetLoadedVmaAllocator(), _bufferCI.get(), _memoryCI.get(), &_buffer, &_memory, nullptr) != VK_SUCCESS) {
             const std::string msg = "Buffer::Recreate - Failed to create buffer";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Helper.h"
+#include "../ResourceAccess.h"
 
 namespace LoFi {
       class Context;
@@ -79,6 +80,8 @@ namespace LoFi::Component {
 
             std::optional<uint32_t> _bindlessIndex{};
 
+            Internal::ResourceAccessState _accessState{}; // tracked by the context's barrier batcher
+
             VkBuffer _buffer{};
 
             VmaAllocation _memory{};
@@ -87,8 +90,6 @@ namespace LoFi::Component {
 
             std::unique_ptr<VmaAllocationCreateInfo> _memoryCI{};
 
-            std::unique_ptr<Buffer> _intermediateBuffer{};
-
             std::vector<VkBufferView> _views{};
 
             std::vector<VkBufferViewCreateInfo> _viewCIs{};
@@ -10,7 +10,7 @@
 using namespace LoFi::Component;
 using namespace LoFi::Internal;
 
-ComputeKernel::ComputeKernel(entt::entity id, entt::entity program) {
+ComputeKernel::ComputeKernel(entt::entity id, entt::entity program, const std::vector<uint32_t>& spec_data) : _id(id), _program(program) {
       auto& world = *volkGetLoadedEcsWorld();
 
       if(!world.valid(id)) {
@@ -44,6 +44,12 @@ ComputeKernel::ComputeKernel(entt::entity id, entt::entity program) {
             throw std::runtime_error(err);
       }
 
+      _structTable = prog->_structTable;
+      _structMemberTable = prog->_structMemberTable;
+      _sampledTextureTable = prog->_sampledTextureTable;
+      _storageImageTable = prog->_storageImageTable;
+      _storageBufferTable = prog->_storageBufferTable;
+      _marcoParserIdentifier = prog->_marcoParserIdentifier;
       _pushConstantRange = prog->_pushConstantRange;
 
       VkPipelineLayoutCreateInfo pipeline_layout_ci{
@@ -52,8 +58,8 @@ ComputeKernel::ComputeKernel(entt::entity id, entt::entity program) {
             .flags = 0,
             .setLayoutCount = 1,
             .pSetLayouts = &LoFi::Context::Get()->_bindlessDescriptorSetLayout,
-            .pushConstantRangeCount = 1,
-            .pPushConstantRanges = &_pushConstantRange
+            .pushConstantRangeCount = (uint32_t)(_pushConstantRange.size == 0 ? 0 : 1),
+            .pPushConstantRanges = (_pushConstantRange.size == 0 ? nullptr : &_pushConstantRange)
       };
 
       if (vkCreatePipelineLayout(volkGetLoadedDevice(), &pipeline_layout_ci, nullptr, &_pipelineLayout) != VK_SUCCESS) {
@@ -62,6 +68,18 @@ ComputeKernel::ComputeKernel(entt::entity id, entt::entity program) {
             throw std::runtime_error(err);
       }
 
+      std::vector<VkSpecializationMapEntry> spec_entries(spec_data.size());
+      for (uint32_t i = 0; i < spec_entries.size(); i++) {
+            spec_entries[i] = VkSpecializationMapEntry{.constantID = i, .offset = i * (uint32_t)sizeof(uint32_t), .size = sizeof(uint32_t)};
+      }
+
+      const VkSpecializationInfo spec_info{
+            .mapEntryCount = (uint32_t)spec_entries.size(),
+            .pMapEntries = spec_entries.data(),
+            .dataSize = spec_data.size() * sizeof(uint32_t),
+            .pData = spec_data.data()
+      };
+
       VkPipelineShaderStageCreateInfo cs_ci = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .pNext = nullptr,
@@ -69,7 +87,7 @@ ComputeKernel::ComputeKernel(entt::entity id, entt::entity program) {
             .stage = VK_SHADER_STAGE_COMPUTE_BIT,
             .module = prog->GetShaderModules().at(glslang_stage_t::GLSLANG_STAGE_COMPUTE).second,
             .pName = "main",
-            .pSpecializationInfo = nullptr
+            .pSpecializationInfo = spec_data.empty() ? nullptr : &spec_info
       };
 
       VkComputePipelineCreateInfo pipelineInfo{
@@ -80,13 +98,35 @@ ComputeKernel::ComputeKernel(entt::entity id, entt::entity program) {
             .basePipelineIndex = 0
       };
 
-      if(auto res = vkCreateComputePipelines(volkGetLoadedDevice(), nullptr, 1, &pipelineInfo, nullptr, &_pipeline); res != VK_SUCCESS) {
+      if(auto res = vkCreateComputePipelines(volkGetLoadedDevice(), Context::Get()->_pipelineCache.GetCache(), 1, &pipelineInfo, nullptr, &_pipeline); res != VK_SUCCESS) {
             const auto err = std::format("ComputeKernel::ComputeKernel - vkCreateComputePipelines failed with error code {}\n",  GetVkResultString(res));
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 }
 
+GraphicKernelParameterHandle ComputeKernel::ResolveParameter(const std::string& name) const {
+      if (const auto finder = _structMemberTable.find(name); finder != _structMemberTable.end()) {
+            return GraphicKernelParameterHandle{
+                  .StructIndex = finder->second.StructIndex,
+                  .Offset = finder->second.Offset,
+                  .Size = finder->second.Size,
+                  .TypeHash = finder->second.TypeHash
+            };
+      }
+
+      if (const auto finder = _structTable.find(name); finder != _structTable.end()) {
+            return GraphicKernelParameterHandle{
+                  .StructIndex = finder->second.Index,
+                  .Offset = 0,
+                  .Size = finder->second.Size,
+                  .TypeHash = finder->second.TypeHash
+            };
+      }
+
+      return {};
+}
+
 ComputeKernel::~ComputeKernel() {
       if (_pipeline) {
             const ContextResourceRecoveryInfo info {
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "../Helper.h"
+#include "GraphicKernel.h"
 
 namespace LoFi {
       class Context;
@@ -16,16 +17,57 @@ namespace LoFi::Component {
       public:
             NO_COPY_MOVE_CONS(ComputeKernel);
 
-            explicit ComputeKernel(entt::entity id, entt::entity program);
+            // spec_data holds 4 bytes per specialization constant id, empty keeps the shader defaults
+            explicit ComputeKernel(entt::entity id, entt::entity program, const std::vector<uint32_t>& spec_data = {});
 
             ~ComputeKernel();
 
+            [[nodiscard]] VkPipeline GetPipeline() const { return _pipeline; }
+
+            [[nodiscard]] entt::entity GetProgram() const { return _program; }
+
+            [[nodiscard]] VkPipelineLayout GetPipelineLayout() const { return _pipelineLayout; }
+
+            [[nodiscard]] const entt::dense_map<std::string, GraphicKernelStructInfo>& GetStructTable() const {return _structTable;}
+
+            [[nodiscard]] const entt::dense_map<std::string, uint32_t>& GetSampledTextureTable() const {return _sampledTextureTable;}
+
+            [[nodiscard]] const entt::dense_map<std::string, GraphicKernelStructMemberInfo>& GetStructMemberTable() const {return _structMemberTable;}
+
+            [[nodiscard]] const entt::dense_map<std::string, uint32_t>& GetStorageImageTable() const {return _storageImageTable;}
+
+            [[nodiscard]] const entt::dense_map<std::string, uint32_t>& GetStorageBufferTable() const {return _storageBufferTable;}
+
+            [[nodiscard]] const std::vector<std::pair<std::string, std::string>>& GetMarcoParserIdentifierTable() const {return _marcoParserIdentifier;}
+
+            [[nodiscard]] const VkPushConstantRange& GetBindlessInfoPushConstantRange() const {return _pushConstantRange;}
+
+            [[nodiscard]] GraphicKernelParameterHandle ResolveParameter(const std::string& name) const; // likes "Info" or "Info.time"
+
+      private:
+            friend class ::LoFi::Context;
+
       private:
+            entt::entity _id = entt::null;
+
+            entt::entity _program = entt::null;
 
             VkPipeline _pipeline{};
 
             VkPipelineLayout _pipelineLayout{};
 
+            entt::dense_map<std::string, GraphicKernelStructInfo> _structTable{};
+
+            entt::dense_map<std::string, uint32_t> _sampledTextureTable{};
+
+            entt::dense_map<std::string, GraphicKernelStructMemberInfo> _structMemberTable{};
+
+            entt::dense_map<std::string, uint32_t> _storageImageTable{};
+
+            entt::dense_map<std::string, uint32_t> _storageBufferTable{};
+
+            std::vector<std::pair<std::string, std::string>> _marcoParserIdentifier{};
+
             VkPushConstantRange _pushConstantRange{};
 
       };
@@ -11,7 +11,7 @@
 using namespace LoFi::Component;
 using namespace LoFi::Internal;
 
-GraphicKernel::GraphicKernel(entt::entity id, entt::entity program) : _id(id) {
+GraphicKernel::GraphicKernel(entt::entity id, entt::entity program, bool build_pipeline, std::vector<uint32_t> spec_data) : _id(id), _program(program), _specializationData(std::move(spec_data)) {
 
       auto& world = *volkGetLoadedEcsWorld();
 
@@ -52,18 +52,80 @@ GraphicKernel::GraphicKernel(entt::entity id, entt::entity program) : _id(id) {
             throw std::runtime_error(err);
       }
 
+      VkPipelineLayoutCreateInfo pipeline_layout_ci{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = 1,
+            .pSetLayouts = &LoFi::Context::Get()->_bindlessDescriptorSetLayout,
+            .pushConstantRangeCount = (uint32_t)(prog->_pushConstantRange.size == 0 ? 0 : 1),
+            .pPushConstantRanges = (prog->_pushConstantRange.size == 0 ? nullptr : &prog->_pushConstantRange)
+      };
+
+      if (vkCreatePipelineLayout(volkGetLoadedDevice(), &pipeline_layout_ci, nullptr, &_pipelineLayout) != VK_SUCCESS) {
+            const auto err = std::format("GraphicKernel::CreateFromProgram - Create Pipeline Layout Failed\n");
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      _structTable = prog->_structTable;
+      _structMemberTable = prog->_structMemberTable;
+      _sampledTextureTable = prog->_sampledTextureTable;
+      _pushConstantRange = prog->_pushConstantRange;
+      _marcoParserIdentifier = prog->_marcoParserIdentifier;
+      _specConstantTable = prog->_specConstantTable;
+      _dynamicState = prog->_dynamicState;
+      _defaultDynamicState = GraphicKernelDynamicState{
+            .CullMode = prog->_rasterizationStateCreateInfo.cullMode,
+            .FrontFace = prog->_rasterizationStateCreateInfo.frontFace,
+            .Topology = prog->_inputAssemblyStateCreateInfo.topology,
+            .DepthTestEnable = prog->_depthStencilStateCreateInfo.depthTestEnable,
+            .DepthWriteEnable = prog->_depthStencilStateCreateInfo.depthWriteEnable,
+            .DepthCompareOp = prog->_depthStencilStateCreateInfo.depthCompareOp
+      };
+
+      if (build_pipeline) {
+            BuildPipeline(prog);
+      }
+      //
+      // for(int i = 0; i <  _marcoParserIdentifier.size(); i++) {
+      //       if(_marcoParserIdentifier[i].second == "TEXTURE") {
+      //             _sampledTextureTable[_marcoParserIdentifier[i].first] = i;
+      //       }
+      // }
+}
+
+void GraphicKernel::BuildPipeline(Program* prog) {
+      _pipeline = CreatePipeline(prog);
+}
+
+VkPipeline GraphicKernel::CreatePipeline(Program* prog) const {
+      std::vector<VkSpecializationMapEntry> spec_entries(_specializationData.size());
+      for (uint32_t i = 0; i < spec_entries.size(); i++) {
+            spec_entries[i] = VkSpecializationMapEntry{.constantID = i, .offset = i * (uint32_t)sizeof(uint32_t), .size = sizeof(uint32_t)};
+      }
+
+      const VkSpecializationInfo spec_info{
+            .mapEntryCount = (uint32_t)spec_entries.size(),
+            .pMapEntries = spec_entries.data(),
+            .dataSize = _specializationData.size() * sizeof(uint32_t),
+            .pData = _specializationData.data()
+      };
+
       std::vector<VkPipelineShaderStageCreateInfo> stages{
             {
                   .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                   .stage = VK_SHADER_STAGE_VERTEX_BIT,
                   .module = prog->GetShaderModules().at(glslang_stage_t::GLSLANG_STAGE_VERTEX).second,
-                  .pName = "main"
+                  .pName = "main",
+                  .pSpecializationInfo = _specializationData.empty() ? nullptr : &spec_info
             },
             {
                   .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                   .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
                   .module = prog->GetShaderModules().at(glslang_stage_t::GLSLANG_STAGE_FRAGMENT).second,
-                  .pName = "main"
+                  .pName = "main",
+                  .pSpecializationInfo = _specializationData.empty() ? nullptr : &spec_info
             }
       };
 
@@ -88,6 +150,18 @@ GraphicKernel::GraphicKernel(entt::entity id, entt::entity program) : _id(id) {
             VK_DYNAMIC_STATE_SCISSOR
       };
 
+      // core since vulkan 1.3, the topology may only change within the baked topology class
+      if (prog->_dynamicState) {
+            dynamic_states.insert(dynamic_states.end(), {
+                  VK_DYNAMIC_STATE_CULL_MODE,
+                  VK_DYNAMIC_STATE_FRONT_FACE,
+                  VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+                  VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                  VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+                  VK_DYNAMIC_STATE_DEPTH_COMPARE_OP
+            });
+      }
+
       VkPipelineDynamicStateCreateInfo dynamic_state_ci{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
             .pNext = nullptr,
@@ -96,22 +170,6 @@ GraphicKernel::GraphicKernel(entt::entity id, entt::entity program) : _id(id) {
             .pDynamicStates = dynamic_states.data()
       };
 
-      VkPipelineLayoutCreateInfo pipeline_layout_ci{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .setLayoutCount = 1,
-            .pSetLayouts = &LoFi::Context::Get()->_bindlessDescriptorSetLayout,
-            .pushConstantRangeCount = (uint32_t)(prog->_pushConstantRange.size == 0 ? 0 : 1),
-            .pPushConstantRanges = (prog->_pushConstantRange.size == 0 ? nullptr : &prog->_pushConstantRange)
-      };
-
-      if (vkCreatePipelineLayout(volkGetLoadedDevice(), &pipeline_layout_ci, nullptr, &_pipelineLayout) != VK_SUCCESS) {
-            const auto err = std::format("GraphicKernel::CreateFromProgram - Create Pipeline Layout Failed\n");
-            MessageManager::Log(MessageType::Error, err);
-            throw std::runtime_error(err);
-      }
-
       VkGraphicsPipelineCreateInfo pipeline_ci{
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
             .pNext = &prog->_renderingCreateInfo,
@@ -134,23 +192,61 @@ GraphicKernel::GraphicKernel(entt::entity id, entt::entity program) : _id(id) {
             .basePipelineIndex = 0
       };
 
-      if (vkCreateGraphicsPipelines(volkGetLoadedDevice(), nullptr, 1, &pipeline_ci, nullptr, &_pipeline) != VK_SUCCESS) {
+      VkPipeline pipeline{};
+      if (vkCreateGraphicsPipelines(volkGetLoadedDevice(), Context::Get()->_pipelineCache.GetCache(), 1, &pipeline_ci, nullptr, &pipeline) != VK_SUCCESS) {
             const auto err = std::format("GraphicKernel::CreateFromProgram - vkCreateGraphicsPipelines Failed\n");
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
+      return pipeline;
+}
 
-      _structTable = prog->_structTable;
-      _structMemberTable = prog->_structMemberTable;
-      _sampledTextureTable = prog->_sampledTextureTable;
-      _pushConstantRange = prog->_pushConstantRange;
-      _marcoParserIdentifier = prog->_marcoParserIdentifier;
-      //
-      // for(int i = 0; i <  _marcoParserIdentifier.size(); i++) {
-      //       if(_marcoParserIdentifier[i].second == "TEXTURE") {
-      //             _sampledTextureTable[_marcoParserIdentifier[i].first] = i;
-      //       }
-      // }
+bool GraphicKernel::IsLayoutCompatible(const Program* prog) const {
+      auto same_map = [](const auto& a, const auto& b) {
+            if (a.size() != b.size()) return false;
+            for (const auto& [key, value] : a) {
+                  const auto finder = b.find(key);
+                  if (finder == b.end() || !(finder->second == value)) return false;
+            }
+            return true;
+      };
+
+      // defaults may change, the kernel's data already holds the values it was specialized with
+      auto same_spec_constants = [&] {
+            if (_specConstantTable.size() != prog->_specConstantTable.size()) return false;
+            for (const auto& [name, info] : _specConstantTable) {
+                  const auto finder = prog->_specConstantTable.find(name);
+                  if (finder == prog->_specConstantTable.end() || finder->second.ConstantId != info.ConstantId || finder->second.Type != info.Type) return false;
+            }
+            return true;
+      };
+
+      return _pushConstantRange.size == prog->_pushConstantRange.size && _dynamicState == prog->_dynamicState &&
+             _marcoParserIdentifier == prog->_marcoParserIdentifier && same_map(_structTable, prog->_structTable) &&
+             same_map(_structMemberTable, prog->_structMemberTable) && same_map(_sampledTextureTable, prog->_sampledTextureTable) &&
+             (_specializationData.empty() || same_spec_constants());
+}
+
+GraphicKernelParameterHandle GraphicKernel::ResolveParameter(const std::string& name) const {
+      if (const auto finder = _structMemberTable.find(name); finder != _structMemberTable.end()) {
+            return GraphicKernelParameterHandle{
+                  .StructIndex = finder->second.StructIndex,
+                  .Offset = finder->second.Offset,
+                  .Size = finder->second.Size,
+                  .TypeHash = finder->second.TypeHash
+            };
+      }
+
+      if (const auto finder = _structTable.find(name); finder != _structTable.end()) {
+            return GraphicKernelParameterHandle{
+                  .StructIndex = finder->second.Index,
+                  .Offset = 0,
+                  .Size = finder->second.Size,
+                  .TypeHash = finder->second.TypeHash
+            };
+      }
+
+      return {};
 }
 
 GraphicKernel::~GraphicKernel() {
@@ -5,34 +5,86 @@
 #pragma once
 
 #include "../Helper.h"
+#include "../ThreadPool.h"
+
+#include "GraphicKernelParameter.h"
 
 namespace LoFi {
       class Context;
 }
 
 namespace LoFi::Component {
+      class Program;
+
+      // states a "#set dynamic_state = true" kernel takes per draw instead of from its pipeline
+      struct GraphicKernelDynamicState {
+            VkCullModeFlags CullMode = VK_CULL_MODE_BACK_BIT;
+            VkFrontFace FrontFace = VK_FRONT_FACE_CLOCKWISE;
+            VkPrimitiveTopology Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            VkBool32 DepthTestEnable = VK_FALSE;
+            VkBool32 DepthWriteEnable = VK_FALSE;
+            VkCompareOp DepthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+      };
+
+      // present until the pipeline is built, Job stays null while the program is still compiling
+      struct PendingGraphicKernel {
+            entt::entity ProgramEntity = entt::null;
+            std::shared_ptr<Internal::AsyncJob> Job{};
+            bool Failed = false;
+            std::vector<uint32_t> SpecData{}; // passed to the kernel, empty keeps the shader defaults
+      };
+
+      // present while a hot reloaded program's pipeline is built for an existing kernel, swapped in by BeginFrame
+      struct PendingPipelineSwap {
+            std::shared_ptr<Internal::AsyncJob> Job{};
+            std::shared_ptr<VkPipeline> Pipeline = std::make_shared<VkPipeline>(VK_NULL_HANDLE); // written by Job, components may move
+      };
+
+      enum class SpecConstantType : uint32_t {
+            Bool,
+            Int,
+            Uint,
+            Float
+      };
+
+      struct SpecConstantInfo {
+            uint32_t ConstantId;
+            SpecConstantType Type;
+            uint32_t DefaultValue; // 32 bit pattern of the declared default
+      };
 
       struct GraphicKernelStructMemberInfo {
             uint32_t StructIndex;
             uint32_t Size;
             uint32_t Offset;
+            uint64_t TypeHash;
+
+            bool operator==(const GraphicKernelStructMemberInfo&) const = default;
       };
 
       struct GraphicKernelStructInfo {
             uint32_t Index;
             uint32_t Size;
+            uint32_t Stride; // std430 array stride inside a parameter page
+            uint64_t TypeHash;
+
+            bool operator==(const GraphicKernelStructInfo&) const = default;
       };
 
       class GraphicKernel {
       public:
             NO_COPY_MOVE_CONS(GraphicKernel);
 
-            explicit GraphicKernel(entt::entity id, entt::entity program);
+            // build_pipeline = false only creates the layout and copies the tables, BuildPipeline() may then run on a worker thread,
+            // spec_data holds 4 bytes per specialization constant id, empty keeps the shader defaults
+            explicit GraphicKernel(entt::entity id, entt::entity program, bool build_pipeline = true, std::vector<uint32_t> spec_data = {});
 
             ~GraphicKernel();
 
             [[nodiscard]] VkPipeline GetPipeline() const { return _pipeline; }
 
+            [[nodiscard]] entt::entity GetProgram() const { return _program; }
+
             [[nodiscard]] VkPipelineLayout GetPipelineLayout() const { return _pipelineLayout; }
 
             [[nodiscard]] VkPipelineLayout* GetPipelineLayoutPtr() { return &_pipelineLayout; }
@@ -47,12 +99,28 @@ namespace LoFi::Component {
 
             [[nodiscard]] const VkPushConstantRange& GetBindlessInfoPushConstantRange() const {return _pushConstantRange;}
 
+            [[nodiscard]] bool IsDynamicState() const { return _dynamicState; }
+
+            [[nodiscard]] const GraphicKernelDynamicState& GetDefaultDynamicState() const { return _defaultDynamicState; } // from the program's setters
+
+            [[nodiscard]] GraphicKernelParameterHandle ResolveParameter(const std::string& name) const; // likes "Info" or "Info.time"
+
       private:
+            void BuildPipeline(Program* prog);
+
+            // a new pipeline for this kernel's layout and specialization, throws on failure
+            [[nodiscard]] VkPipeline CreatePipeline(Program* prog) const;
+
+            // the program's reflected tables still match, instance parameter data and the pipeline layout stay valid,
+            // a specialized kernel also needs every constant under the same name, id and type
+            [[nodiscard]] bool IsLayoutCompatible(const Program* prog) const;
 
             friend class ::LoFi::Context;
       private:
             entt::entity _id = entt::null;
 
+            entt::entity _program = entt::null;
+
             VkPipeline _pipeline{};
 
             VkPipelineLayout _pipelineLayout{};
@@ -67,5 +135,12 @@ namespace LoFi::Component {
 
             VkPushConstantRange _pushConstantRange{};
 
+            bool _dynamicState = false;
+
+            GraphicKernelDynamicState _defaultDynamicState{};
+
+            std::vector<uint32_t> _specializationData{};
+
+            entt::dense_map<std::string, SpecConstantInfo> _specConstantTable{}; // the program's when the kernel was made, _specializationData follows its ids
       };
 }
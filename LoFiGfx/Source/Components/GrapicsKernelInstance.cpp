@@ -8,16 +8,29 @@
 using namespace LoFi::Component;
 using namespace LoFi::Internal;
 
-GrapicsKernelInstance::~GrapicsKernelInstance() {
+// calls fn with the GraphicKernel or ComputeKernel component of kernel, false when it is neither
+template <class Fn>
+static bool VisitKernel(entt::entity kernel, Fn&& fn) {
       auto& world = *volkGetLoadedEcsWorld();
+      if (const auto graphic_kernel = world.try_get<GraphicKernel>(kernel)) {
+            fn(*graphic_kernel);
+            return true;
+      }
+      if (const auto compute_kernel = world.try_get<ComputeKernel>(kernel)) {
+            fn(*compute_kernel);
+            return true;
+      }
+      return false;
+}
+
+GrapicsKernelInstance::~GrapicsKernelInstance() {
+      auto& pool = Context::Get()->_parameterPagePool;
       for (const auto& resourece_buffer : _buffers) {
-            for (int i = 0; i < 3; i++) {
-                  world.destroy(resourece_buffer.Buffers[i]);
-            }
+            pool.Free(resourece_buffer.Slot);
       }
 }
 
-GrapicsKernelInstance::GrapicsKernelInstance(entt::entity id, entt::entity graphics_kernel, bool is_cpu_side) : _id(id), _isCpuSide(is_cpu_side) {
+GrapicsKernelInstance::GrapicsKernelInstance(entt::entity id, entt::entity kernel, bool is_cpu_side) : _id(id), _isCpuSide(is_cpu_side) {
       auto& world = *volkGetLoadedEcsWorld();
 
       if(!world.valid(id)) {
@@ -28,60 +41,39 @@ GrapicsKernelInstance::GrapicsKernelInstance(entt::entity id, entt::entity graph
 
       auto& ctx = *Context::Get();
 
-      if (!world.valid(graphics_kernel)) {
-            const auto err = std::format("GrapicsKernelInstance::GrapicsKernelInstance - Invalid Graphics Kernel Entity\n");
+      if (!world.valid(kernel)) {
+            const auto err = std::format("GrapicsKernelInstance::GrapicsKernelInstance - Invalid Kernel Entity\n");
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 
-      auto kernel = world.try_get<GraphicKernel>(graphics_kernel);
-      if (!kernel) {
-            const auto err = std::format("GrapicsKernelInstance::GrapicsKernelInstance - this entity is not a Graphics Kernel.\n");
-            MessageManager::Log(MessageType::Warning, err);
-            throw std::runtime_error(err);
-      }
-
-      const auto& arg_count = kernel->GetMarcoParserIdentifierTable().size();
-
-      _pushConstantBindlessIndexInfoBuffer.resize(arg_count);
-      _buffers.resize(arg_count);
+      const bool is_kernel = VisitKernel(kernel, [&](const auto& parent_kernel) {
+            const auto& arg_count = parent_kernel.GetMarcoParserIdentifierTable().size();
 
-      const auto& struct_table = kernel->GetStructTable();
-      for (const auto& i : struct_table) {
+            _pushConstantBindlessIndexInfoBuffer.resize(arg_count);
+            _boundResources.resize(arg_count, entt::null);
+            _buffers.resize(arg_count);
 
-            FrameResourceBuffer& buffer = _buffers.at(i.second.Index);
-            const auto buffer_index = i.second.Index;
-            buffer.CachedBufferData.resize(i.second.Size);
-           
-            for (int idx = 0; idx < 3; idx++) {
+            const auto& struct_table = parent_kernel.GetStructTable();
+            for (const auto& i : struct_table) {
+                  FrameResourceBuffer& buffer = _buffers.at(i.second.Index);
+                  buffer.CachedBufferData.resize(i.second.Size);
+                  buffer.Slot = ctx._parameterPagePool.Allocate(i.second.Stride);
 
-                  auto& it = buffer.Buffers[idx];
-                  const auto buffer_created = ctx.CreateBuffer(buffer.CachedBufferData.size(), is_cpu_side);
-
-                  if(!world.valid(buffer_created)) { //if happend, all dead
-                        const auto err = std::format("GrapicsKernelInstance::GrapicsKernelInstance - Can't Allocate buffer! crashed\n");
-                        MessageManager::Log(MessageType::Error, err);
-                        throw std::runtime_error(err);
+                  const auto line_count = (i.second.Size + DirtyLineSize - 1) / DirtyLineSize;
+                  for (auto& lines : buffer.DirtyLines) {
+                        lines.resize((line_count + 63) / 64);
                   }
-
-                  buffer.Buffers[idx] = buffer_created;
-
-                  const auto& buffer_comp = world.get<Buffer>(buffer_created);
-                  const auto buffer_bindless_index = buffer_comp.GetBindlessIndex();
-
-                  if(!buffer_bindless_index.has_value()) { //should not happend
-                        const auto err = std::format("GrapicsKernelInstance::GrapicsKernelInstance - Buffer has no bindless index ? it's should not happened\n");
-                        MessageManager::Log(MessageType::Error, err);
-                        throw std::runtime_error(err);
-                  }
-
-                  //printf("\tGrapicsKernelInstance Struct: %s - index: %u, size: %u.\n", i.first.c_str(), buffer_index, i.second.Size);
-                  //printf("\t\t create at offset %u in push constant buffer[%u].\n", buffer_index, idx);
-
-                  _pushConstantBindlessIndexInfoBuffer.at(buffer_index) = buffer_bindless_index.value();
+                  MarkDirty(buffer, 0, i.second.Size);
             }
+      });
+
+      if (!is_kernel) {
+            const auto err = std::format("GrapicsKernelInstance::GrapicsKernelInstance - this entity is not a Graphics Kernel or a Compute Kernel.\n");
+            MessageManager::Log(MessageType::Warning, err);
+            throw std::runtime_error(err);
       }
-      _parent = graphics_kernel;
+      _parent = kernel;
 }
 
 bool GrapicsKernelInstance::SetParameterStruct(const std::string& struct_name, const void* data) {
@@ -93,8 +85,9 @@ bool GrapicsKernelInstance::SetParameterStruct(const std::string& struct_name, c
             return false;
       }
 
-      if (const auto parent_kernel = world.try_get<GraphicKernel>(_parent); parent_kernel) {
-            const auto& map = parent_kernel->GetStructTable();
+      bool found = false;
+      const bool is_kernel = VisitKernel(_parent, [&](const auto& parent_kernel) {
+            const auto& map = parent_kernel.GetStructTable();
             if (const auto finder = map.find(struct_name); finder != map.end()) {
                   GraphicKernelStructInfo info = finder->second;
                   const auto index = info.Index;
@@ -102,26 +95,25 @@ bool GrapicsKernelInstance::SetParameterStruct(const std::string& struct_name, c
 
                   uint8_t* ptr = _buffers.at(index).CachedBufferData.data();
                   std::memcpy(ptr, data, size);
-                  _buffers.at(index).Modified = 3;
-            } else {
-                  const auto err = std::format("GrapicsKernelInstance::SetStruct - Struct \"{}\" Not Found\n", struct_name);
-                  MessageManager::Log(MessageType::Error, err);
-                  return false;
+                  MarkDirty(_buffers.at(index), 0, size);
+                  found = true;
             }
-      } else if (const auto parent_framebuffer = world.try_get<GrapicsKernelInstance>(_parent); parent_framebuffer) {
-            // TODO
+      });
 
-            return false;
-      } else {
-            const auto err = std::format("GrapicsKernelInstance::SetStruct - Parent Entity is not a Graphics Kernel or GrapicsKernelInstance\n");
+      if (!is_kernel) {
+            const auto err = std::format("GrapicsKernelInstance::SetStruct - Parent Entity is not a Graphics Kernel or a Compute Kernel\n");
             MessageManager::Log(MessageType::Error, err);
             return false;
       }
 
-      if(!world.any_of<TagGrapicsKernelInstanceParameterChanged>(_id)) {
-            world.emplace<TagGrapicsKernelInstanceParameterChanged>(_id);
+      if (!found) {
+            const auto err = std::format("GrapicsKernelInstance::SetStruct - Struct \"{}\" Not Found\n", struct_name);
+            MessageManager::Log(MessageType::Error, err);
+            return false;
       }
 
+      MarkParameterChanged();
+
       return true;
 }
 
@@ -134,8 +126,9 @@ bool GrapicsKernelInstance::SetParameterStructMember(const std::string& struct_m
             return false;
       }
 
-      if (const auto parent_kernel = world.try_get<GraphicKernel>(_parent); parent_kernel) {
-            const auto& map = parent_kernel->GetStructMemberTable();
+      bool found = false;
+      const bool is_kernel = VisitKernel(_parent, [&](const auto& parent_kernel) {
+            const auto& map = parent_kernel.GetStructMemberTable();
 
             if (const auto finder = map.find(struct_member_name); finder != map.end()) {
                   GraphicKernelStructMemberInfo info = finder->second;
@@ -145,29 +138,56 @@ bool GrapicsKernelInstance::SetParameterStructMember(const std::string& struct_m
 
                   uint8_t* struct_start_ptr = _buffers.at(index).CachedBufferData.data();
                   memcpy(struct_start_ptr + offset, data, size);
-                  _buffers.at(index).Modified = 3;
-            } else {
-                  const auto err = std::format("GrapicsKernelInstance::SetStructMember - Struct Member \"{}\" Not Found", struct_member_name);
-                  MessageManager::Log(MessageType::Error, err);
-                  return false;
+                  MarkDirty(_buffers.at(index), offset, size);
+                  found = true;
             }
-      } else if (const auto parent_framebuffer = world.try_get<GrapicsKernelInstance>(_parent); parent_framebuffer) {
-            // TODO
+      });
 
+      if (!is_kernel) {
+            const auto err = std::format("GrapicsKernelInstance::SetStructMember - Parent Entity is not a Graphics Kernel or a Compute Kernel\n");
+            MessageManager::Log(MessageType::Error, err);
             return false;
-      } else {
-            const auto err = std::format("GrapicsKernelInstance::SetStructMember - Parent Entity is not a Graphics Kernel or GrapicsKernelInstance\n");
+      }
+
+      if (!found) {
+            const auto err = std::format("GrapicsKernelInstance::SetStructMember - Struct Member \"{}\" Not Found", struct_member_name);
             MessageManager::Log(MessageType::Error, err);
             return false;
       }
 
-      if(!world.any_of<TagGrapicsKernelInstanceParameterChanged>(_id)) {
-            world.emplace<TagGrapicsKernelInstanceParameterChanged>(_id);
+      MarkParameterChanged();
+
+      return true;
+}
+
+bool GrapicsKernelInstance::SetParameter(const GraphicKernelParameterHandle& handle, const void* data) {
+      if (!handle.IsValid() || handle.StructIndex >= _buffers.size()) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameter - Invalid parameter handle\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      auto& buffer = _buffers[handle.StructIndex];
+      if (handle.Offset + handle.Size > buffer.CachedBufferData.size()) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameter - Parameter handle out of range, offset {}, size {}, struct size {}\n", handle.Offset, handle.Size, buffer.CachedBufferData.size());
+            MessageManager::Log(MessageType::Error, err);
+            return false;
       }
 
+      std::memcpy(buffer.CachedBufferData.data() + handle.Offset, data, handle.Size);
+      MarkDirty(buffer, handle.Offset, handle.Size);
+      MarkParameterChanged();
+
       return true;
 }
 
+void GrapicsKernelInstance::MarkParameterChanged() {
+      if (_parameterChangedTagged) return;
+
+      volkGetLoadedEcsWorld()->emplace_or_replace<TagGrapicsKernelInstanceParameterChanged>(_id);
+      _parameterChangedTagged = true;
+}
+
 bool GrapicsKernelInstance::SetParameterTexture(const std::string& texture_name, entt::entity texture) {
       auto& world = *volkGetLoadedEcsWorld();
 
@@ -197,21 +217,116 @@ bool GrapicsKernelInstance::SetParameterTexture(const std::string& texture_name,
             return false;
       }
 
-      if (const auto parent_kernel = world.try_get<GraphicKernel>(_parent); parent_kernel) {
-            const auto& map = parent_kernel->GetSampledTextureTable();
+      bool found = false;
+      const bool is_kernel = VisitKernel(_parent, [&](const auto& parent_kernel) {
+            const auto& map = parent_kernel.GetSampledTextureTable();
             if (const auto finder = map.find(texture_name); finder != map.end()) {
                   _pushConstantBindlessIndexInfoBuffer.at(finder->second) = bindless_index.value();
-            } else {
-                  const auto err = std::format("GrapicsKernelInstance::SetParameterSampledTexture - Texture \"{}\" Not Found\n", texture_name);
-                  MessageManager::Log(MessageType::Error, err);
-                  return false;
+                  _boundResources.at(finder->second) = texture;
+                  found = true;
             }
-      } else {
-            const auto err = std::format("GrapicsKernelInstance::SetParameterSampledTexture - Parent Entity is not a Graphics Kernel\n");
+      });
+
+      if (!is_kernel) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterSampledTexture - Parent Entity is not a Graphics Kernel or a Compute Kernel\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      if (!found) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterSampledTexture - Texture \"{}\" Not Found\n", texture_name);
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      return true;
+}
+
+bool GrapicsKernelInstance::SetParameterStorageTexture(const std::string& image_name, entt::entity texture) {
+      auto& world = *volkGetLoadedEcsWorld();
+
+      if(!world.valid(texture)) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterStorageTexture - Invalid Texture Entity\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      auto texture_comp = world.try_get<Texture>(texture);
+      if(!texture_comp) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterStorageTexture - This entity is not a texture \n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      auto bindless_index = texture_comp->GetBindlessIndexForComputeKernel();
+      if(!bindless_index.has_value()) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterStorageTexture - Texture has no storage bindless index, depth textures can't be written by compute kernels\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      auto parent_kernel = world.valid(_parent) ? world.try_get<ComputeKernel>(_parent) : nullptr;
+      if (!parent_kernel) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterStorageTexture - Parent Entity is not a Compute Kernel\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      const auto& map = parent_kernel->GetStorageImageTable();
+      const auto finder = map.find(image_name);
+      if (finder == map.end()) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterStorageTexture - Image \"{}\" Not Found\n", image_name);
             MessageManager::Log(MessageType::Error, err);
             return false;
       }
 
+      _pushConstantBindlessIndexInfoBuffer.at(finder->second) = bindless_index.value();
+      _boundResources.at(finder->second) = texture;
+
+      return true;
+}
+
+bool GrapicsKernelInstance::SetParameterBuffer(const std::string& buffer_name, entt::entity buffer) {
+      auto& world = *volkGetLoadedEcsWorld();
+
+      if(!world.valid(buffer)) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterBuffer - Invalid Buffer Entity\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      auto buffer_comp = world.try_get<Buffer>(buffer);
+      if(!buffer_comp) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterBuffer - This entity is not a buffer \n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      auto bindless_index = buffer_comp->GetBindlessIndex();
+      if(!bindless_index.has_value()) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterBuffer - Buffer has no bindless index, create it with bindless = true\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      auto parent_kernel = world.valid(_parent) ? world.try_get<ComputeKernel>(_parent) : nullptr;
+      if (!parent_kernel) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterBuffer - Parent Entity is not a Compute Kernel\n");
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      const auto& map = parent_kernel->GetStorageBufferTable();
+      const auto finder = map.find(buffer_name);
+      if (finder == map.end()) {
+            const auto err = std::format("GrapicsKernelInstance::SetParameterBuffer - Buffer \"{}\" Not Found\n", buffer_name);
+            MessageManager::Log(MessageType::Error, err);
+            return false;
+      }
+
+      _pushConstantBindlessIndexInfoBuffer.at(finder->second) = bindless_index.value();
+      _boundResources.at(finder->second) = buffer;
+
       return true;
 }
 
@@ -220,20 +335,66 @@ void GrapicsKernelInstance::PushResourceChanged() {
       auto& world = *volkGetLoadedEcsWorld();
       if(!world.any_of<TagGrapicsKernelInstanceParameterChanged>(_id))  return;
 
-      const auto current_frame = Context::Get()->GetCurrentFrameIndex();
+      auto& ctx = *Context::Get();
+      auto& pool = ctx._parameterPagePool;
+      const auto current_frame = ctx.GetCurrentFrameIndex();
+      const uint32_t frame_bit = 1u << current_frame;
+
+      bool completed = true;
       for (auto& buffer : _buffers) {
-            if (buffer.Modified > 0) {
-                  const auto buf = buffer.Buffers[current_frame];
-                  world.get<Buffer>(buf).SetData(buffer.CachedBufferData.data(), buffer.CachedBufferData.size());
-                  buffer.Modified--;
-                  if(buffer.Modified == 0) {
-                        world.emplace<TagGrapicsKernelInstanceParameterUpdateCompleted>(_id);
+            if (buffer.DirtyRegionMask & frame_bit) {
+                  auto& lines = buffer.DirtyLines[current_frame];
+                  const auto is_dirty = [&](uint32_t line) { return (lines[line / 64] >> (line % 64)) & 1; };
+
+                  const auto size = (uint32_t)buffer.CachedBufferData.size();
+                  const auto line_count = (size + DirtyLineSize - 1) / DirtyLineSize;
+                  uint8_t* dst = pool.GetSlotPtr(buffer.Slot, current_frame);
+
+                  // copy each run of adjacent dirty lines at once
+                  for (uint32_t line = 0; line < line_count;) {
+                        if (!is_dirty(line)) {
+                              line++;
+                              continue;
+                        }
+
+                        uint32_t end = line + 1;
+                        while (end < line_count && is_dirty(end)) end++;
+
+                        const uint32_t begin_byte = line * DirtyLineSize;
+                        const uint32_t end_byte = std::min(end * DirtyLineSize, size);
+                        std::memcpy(dst + begin_byte, buffer.CachedBufferData.data() + begin_byte, end_byte - begin_byte);
+                        pool.Flush(buffer.Slot, current_frame, begin_byte, end_byte - begin_byte);
+                        ctx._frameUploadedBytes += end_byte - begin_byte;
+
+                        line = end;
                   }
+
+                  std::ranges::fill(lines, 0);
+                  buffer.DirtyRegionMask &= ~frame_bit;
+            }
+            completed &= buffer.DirtyRegionMask == 0;
+      }
+
+      if (completed && !world.any_of<TagGrapicsKernelInstanceParameterUpdateCompleted>(_id)) {
+            world.emplace<TagGrapicsKernelInstanceParameterUpdateCompleted>(_id);
+            _parameterChangedTagged = false; // both tags are removed right after this pass
+      }
+}
+
+void GrapicsKernelInstance::MarkDirty(FrameResourceBuffer& buffer, uint32_t offset, uint32_t size) {
+      if (size == 0) return;
+
+      const uint32_t first = offset / DirtyLineSize;
+      const uint32_t last = (offset + size - 1) / DirtyLineSize;
+      for (auto& lines : buffer.DirtyLines) {
+            for (uint32_t line = first; line <= last; line++) {
+                  lines[line / 64] |= 1ull << (line % 64);
             }
       }
+      buffer.DirtyRegionMask = 0b111;
 }
 
-void GrapicsKernelInstance::PushBindlessInfo(VkCommandBuffer buf) const {
+void GrapicsKernelInstance::PushBindlessInfo(VkCommandBuffer buf) {
       auto& world = *volkGetLoadedEcsWorld();
       if (!world.valid(_parent)) {
             const auto err = std::format("GrapicsKernelInstance::SetStructMember - Invalid Parent Graphics Kernel Entity!\n");
@@ -241,11 +402,32 @@ void GrapicsKernelInstance::PushBindlessInfo(VkCommandBuffer buf) const {
             throw std::runtime_error(err);
       }
 
-      if (const auto parent_kernel = world.try_get<GraphicKernel>(_parent); parent_kernel) {
-            const auto& push_constant_range = parent_kernel->GetBindlessInfoPushConstantRange();
-            vkCmdPushConstants(buf, parent_kernel->GetPipelineLayout(), VK_SHADER_STAGE_ALL, push_constant_range.offset, push_constant_range.size, _pushConstantBindlessIndexInfoBuffer.data());
-      } else {
-            const auto err = std::format("GrapicsKernelInstance::SetStructMember - Parent Entity is not a Graphics Kernel\n");
+      const bool is_kernel = VisitKernel(_parent, [&](const auto& parent_kernel) {
+            const auto& pool = Context::Get()->_parameterPagePool;
+            const auto current_frame = Context::Get()->GetCurrentFrameIndex();
+            for (uint32_t idx = 0; idx < _buffers.size(); idx++) {
+                  const auto& slot = _buffers[idx].Slot;
+                  if (slot.IsValid()) {
+                        _pushConstantBindlessIndexInfoBuffer[idx] = (slot.Element << ParameterPagePool::ElementIndexBits) | pool.GetDescriptorIndex(slot, current_frame);
+                  }
+            }
+
+            // a streamed texture moves to a new sampler index whenever its resident levels change
+            for (uint32_t idx = 0; idx < _boundResources.size(); idx++) {
+                  const auto resource = _boundResources[idx];
+                  if (resource == entt::null || !world.valid(resource) || !world.all_of<StreamedTexture>(resource)) continue;
+                  if (const auto texture = world.try_get<Texture>(resource); texture && texture->GetBindlessIndexForSampler().has_value()) {
+                        _pushConstantBindlessIndexInfoBuffer[idx] = texture->GetBindlessIndexForSampler().value();
+                  }
+            }
+
+            const auto& push_constant_range = parent_kernel.GetBindlessInfoPushConstantRange();
+            if (push_constant_range.size == 0) return;
+            vkCmdPushConstants(buf, parent_kernel.GetPipelineLayout(), VK_SHADER_STAGE_ALL, push_constant_range.offset, push_constant_range.size, _pushConstantBindlessIndexInfoBuffer.data());
+      });
+
+      if (!is_kernel) {
+            const auto err = std::format("GrapicsKernelInstance::SetStructMember - Parent Entity is not a Graphics Kernel or a Compute Kernel\n");
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
@@ -6,6 +6,8 @@
 
 #include "../Helper.h"
 #include "GraphicKernel.h"
+#include "ComputeKernel.h"
+#include "../ParameterPagePool.h"
 
 namespace LoFi::Component {
 
@@ -13,19 +15,23 @@ namespace LoFi::Component {
       struct TagGrapicsKernelInstanceParameterUpdateCompleted {};
 
       struct FrameResourceBuffer {
-            uint32_t Modified = 0;
+            uint32_t DirtyRegionMask = 0; // bit per frame region that still has dirty lines
             std::vector<uint8_t> CachedBufferData{};
-            std::array<entt::entity, 3> Buffers{};
+            std::array<std::vector<uint64_t>, 3> DirtyLines{}; // per frame region, one bit per DirtyLineSize bytes of CachedBufferData
+            Internal::ParameterSlot Slot{}; // one element per frame region in a shared parameter page
       };
 
-      // notice: FrameResource will upload CachedBufferData to gpu buffer when CmdBindGraphicKernelWithFrameResourceToRenderPass() called if IsModified is true
+      // notice: dirty lines of CachedBufferData are written into the current frame's region of its parameter page in BeginFrame,
+      // the parent is a graphics kernel or a compute kernel, both expose the same parameter tables
       class GrapicsKernelInstance {
       public:
+            static constexpr uint32_t DirtyLineSize = 64;
+
             NO_COPY_MOVE_CONS(GrapicsKernelInstance);
 
             ~GrapicsKernelInstance();
 
-            explicit GrapicsKernelInstance(entt::entity id, entt::entity graphics_kernel, bool is_cpu_side = true);
+            explicit GrapicsKernelInstance(entt::entity id, entt::entity kernel, bool is_cpu_side = true);
 
             [[nodiscard]] entt::entity GetHandle() const { return _id; }
 
@@ -39,21 +45,37 @@ namespace LoFi::Component {
 
             bool SetParameterTexture(const std::string& texture_name, entt::entity texture);
 
+            bool SetParameterStorageTexture(const std::string& image_name, entt::entity texture); // IMAGE, compute kernels only
+
+            bool SetParameterBuffer(const std::string& buffer_name, entt::entity buffer); // BUFFER, compute kernels only
+
+            [[nodiscard]] const std::vector<entt::entity>& GetBoundResources() const { return _boundResources; } // textures and buffers by parameter slot, null when unset
+
+            bool SetParameter(const GraphicKernelParameterHandle& handle, const void* data); // handle from GraphicKernel::ResolveParameter
+
       private:
-            friend class Context;
+            friend class ::LoFi::Context;
+
+            void MarkParameterChanged();
 
             void PushResourceChanged();
 
-            void PushBindlessInfo(VkCommandBuffer buf) const;
+            static void MarkDirty(FrameResourceBuffer& buffer, uint32_t offset, uint32_t size);
+
+            void PushBindlessInfo(VkCommandBuffer buf);
 
             entt::entity _id;
 
-            entt::entity _parent; // Graphics kernel or FrameResource
+            entt::entity _parent; // Graphics kernel or compute kernel
 
-            bool _isCpuSide;
+            bool _isCpuSide; // unused, parameter pages are always host visible
+
+            bool _parameterChangedTagged = false; // mirrors TagGrapicsKernelInstanceParameterChanged, saves a lookup per set
 
             std::vector<FrameResourceBuffer> _buffers{};
 
             std::vector<uint32_t> _pushConstantBindlessIndexInfoBuffer{}; // BindlessInfo
+
+            std::vector<entt::entity> _boundResources{}; // the context tracks their access state when a compute kernel dispatches
       };
 }
@@ -4,8 +4,20 @@
 #include "../Context.h"
 #include "../Message.h"
 
+#include "../BinaryStream.h"
+
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
 #include "../Third/spirv-cross/spirv_cross.hpp"
+#include "../Third/spirv-cross/spirv_cross_c.h" // SPVC_C_API_VERSION_*
 #include "../Third/glslang/Public/resource_limits_c.h"
+#include "../Third/glslang/build_info.h"
+
+#include <spirv-tools/optimizer.hpp> // Vulkan SDK, SPIRV-Tools-opt
 
 using namespace LoFi::Component;
 using namespace LoFi::Internal;
@@ -30,6 +42,92 @@ static const char* ShaderTypeHelperGetName(glslang_stage_t type) {
       }
 }
 
+// canonical layout name of a reflected type, scalars as "float", vectors and matrices as "float{columns}x{rows}",
+// structs spell out members with their offsets, used as the parameter type hash
+static std::string GetReflectedTypeName(const spirv_cross::Compiler& comp, const spirv_cross::SPIRType& type) {
+      std::string name;
+      if (type.basetype == spirv_cross::SPIRType::Struct) {
+            name = "struct{";
+            for (uint32_t i = 0; i < type.member_types.size(); i++) {
+                  name += std::format("{}@{};", GetReflectedTypeName(comp, comp.get_type(type.member_types[i])), comp.type_struct_member_offset(type, i));
+            }
+            name += "}";
+      } else {
+            switch (type.basetype) {
+                  case spirv_cross::SPIRType::Boolean: name = "uint"; break; // glslang lowers a block bool to uint, keep both spellings equal
+                  case spirv_cross::SPIRType::Int: name = "int"; break;
+                  case spirv_cross::SPIRType::UInt: name = "uint"; break;
+                  case spirv_cross::SPIRType::Int64: name = "int64"; break;
+                  case spirv_cross::SPIRType::UInt64: name = "uint64"; break;
+                  case spirv_cross::SPIRType::Half: name = "half"; break;
+                  case spirv_cross::SPIRType::Float: name = "float"; break;
+                  case spirv_cross::SPIRType::Double: name = "double"; break;
+                  default: name = "unknown"; break;
+            }
+
+            if (type.vecsize > 1 || type.columns > 1) {
+                  name += std::format("{}x{}", type.columns, type.vecsize);
+            }
+      }
+
+      for (const auto dim : type.array) {
+            name += std::format("[{}]", dim);
+      }
+
+      return name;
+}
+
+static uint64_t GetReflectedTypeHash(const spirv_cross::Compiler& comp, const spirv_cross::SPIRType& type) {
+      const auto name = GetReflectedTypeName(comp, type);
+      return XXH64(name.data(), name.size(), 0);
+}
+
+static std::string_view TrimDirectiveSpace(std::string_view text) {
+      while (!text.empty() && std::isspace((unsigned char)text.front())) text.remove_prefix(1);
+      while (!text.empty() && std::isspace((unsigned char)text.back())) text.remove_suffix(1);
+      return text;
+}
+
+// leading identifier of text, which then starts after it
+static std::string_view TakeDirectiveIdentifier(std::string_view& text) {
+      text = TrimDirectiveSpace(text);
+      size_t size = 0;
+      while (size < text.size() && (std::isalnum((unsigned char)text[size]) || text[size] == '_')) size++;
+      if (size != 0 && std::isdigit((unsigned char)text[0])) size = 0;
+      const auto identifier = text.substr(0, size);
+      text.remove_prefix(size);
+      return identifier;
+}
+
+// "#ifdef NAME" -> ("ifdef", "NAME"), a trailing line comment is dropped
+static std::pair<std::string_view, std::string_view> SplitDirective(std::string_view directive) {
+      directive.remove_prefix(1);
+      if (const auto comment = directive.find("//"); comment != std::string_view::npos) directive = directive.substr(0, comment);
+      const auto word = TakeDirectiveIdentifier(directive);
+      return {word, TrimDirectiveSpace(directive)};
+}
+
+// c++ spelling of a reflected type name with the same std430 size, vectors, matrices and arrays become flat scalar arrays
+// (so a mat3 keeps its column padding), structs become raw bytes
+static std::string GetCppTypeName(std::string_view type_name, uint32_t size) {
+      static constexpr std::tuple<std::string_view, std::string_view, uint32_t> scalars[] = {
+            {"uint64", "uint64_t", 8},
+            {"int64", "int64_t", 8},
+            {"uint", "uint32_t", 4},
+            {"int", "int32_t", 4},
+            {"float", "float", 4},
+            {"double", "double", 8},
+            {"half", "uint16_t", 2},
+      };
+
+      for (const auto& [glsl, cpp, scalar_size] : scalars) {
+            if (type_name == glsl) return std::string{cpp};
+            if (type_name.starts_with(glsl)) return std::format("std::array<{}, {}>", cpp, size / scalar_size);
+      }
+
+      return std::format("std::array<uint8_t, {}>", size);
+}
+
 ProgramCompilerGroup::ProgramCompilerGroup() {
       glslang_initialize_process();
 }
@@ -58,7 +156,7 @@ Program::Program(entt::entity id) : _id(id) {
       ProgramCompilerGroup::TryInit();
 }
 
-bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std::string_view>& sources) {
+bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std::string_view>& sources, uint64_t variant_mask) {
       _programName = name;
 
       //Init Pipeline CIs, use default profile
@@ -150,19 +248,36 @@ bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std
       _vertexInputBindingDescription.clear();
       _colorBlendAttachmentState.clear();
       _renderTargetFormat.clear();
-
-      entt::dense_map<std::string, std::vector<std::string>> setters{}; // TODO: setter
-
+      _dynamicState = false;
+      _optimizeLevel = ShaderOptimizeLevel::None;
+      _keywords.clear();
+      _parsedKeywords.clear();
+      _parsedVariantMask = variant_mask;
+      _includedFiles.clear();
+      _stageCodeHashes.clear();
+
+      const auto preprocess_begin = std::chrono::steady_clock::now();
+      size_t preprocess_bytes = 0;
+
+      // one token pass per source finds the stage, expands marcos, renames the entry point and collects the setters
       std::vector<std::string> source_after_marco{};
+      std::vector<glslang_stage_t> stages{};
+      std::vector<ShaderIncludeContext> stage_includes{};
 
       for (auto source : sources) {
+            const auto tokens = ShaderLexer::Tokenize(source);
+            preprocess_bytes += source.size();
 
             std::optional<glslang_stage_t> find_shader_type = std::nullopt;
-            for (auto& i : ShaderTypeMap) {
-                  if (source.find(i.first) != std::string::npos) {
-                        find_shader_type = i.second;
-                        break;
+            for (const auto& token : tokens) {
+                  if (token.Type != ShaderTokenType::Identifier) continue;
+                  for (auto& i : ShaderTypeMap) {
+                        if (token.Text == i.first) {
+                              find_shader_type = i.second;
+                              break;
+                        }
                   }
+                  if (find_shader_type.has_value()) break;
             }
 
             glslang_stage_t shader_type;
@@ -183,40 +298,25 @@ bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std
 
             std::string marco_parse_source_output{};
             std::string marco_parse_err_msg{};
-            if(!ParseMarco(source, marco_parse_source_output, marco_parse_err_msg, shader_type)) {
+            ShaderIncludeContext include_context{};
+            if(!ParseMarco(tokens, shader_type, marco_parse_source_output, include_context, marco_parse_err_msg)) {
                   auto err = std::format("Program::ParseMarco - Failed to parse marco for shader program \"{}\" shader type :\"{}\".\nMarcoCompiler:\n{}",
                  _programName, shader_type_str, marco_parse_err_msg);
                   MessageManager::Log(MessageType::Warning, err);
                   return false;
             }
             source_after_marco.push_back(std::move(marco_parse_source_output));
+            stages.push_back(shader_type);
+            for (const auto& file : include_context.Files) {
+                  preprocess_bytes += file->Source.size();
+                  _includedFiles.push_back(file);
+            }
+            stage_includes.push_back(std::move(include_context));
       }
 
       //Head Gen
 
-      std::string header = "";
-      header += "#extension GL_EXT_nonuniform_qualifier : enable\n";
-      header += "#define BindlessStorageBinding 0\n";
-      header += "#define BindlessSamplerBinding 1\n";
-
-      header += "#define GetLayoutVariableName(Name) _bindless##Name\n";
-      header += "#define GetVar(Name) GetLayoutVariableName(Name)[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
-
-      header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler1D _bindlessSamper1D[];\n";
-      header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler2D _bindlessSamper2D[];\n";
-      header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler3D _bindlessSamper3D[];\n";
-      header += "layout(set = 0, binding = BindlessSamplerBinding) uniform samplerCube _bindlessSamperCube[];\n";
-      header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler1DArray _bindlessSampler1DArray[];\n";
-      header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler2DArray _bindlessSampler2DArray[];\n";
-      //header += "layout(set = 0, binding = BindlessSamplerBinding) uniform samplerCubeArray _bindlessSamplerCubeArray[];\n";
-
-      header += "#define GetTex1D(Name) _bindlessSamper1D[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
-      header += "#define GetTex2D(Name) _bindlessSamper2D[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
-      header += "#define GetTex3D(Name) _bindlessSamper3D[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
-      header += "#define GetTexCube(Name) _bindlessSamperCube[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
-      header += "#define GetTex1DArray(Name) _bindlessSampler1DArray[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
-      header += "#define GetTex2DArray(Name) _bindlessSampler2DArray[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
-     // header += "#define GetTexCubeArray(Name) _bindlessSamplerCubeArray[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+      std::string header = GetStaticHeader();
 
       std::string push_constantsCode = "layout(push_constant) uniform _BindlessPushConstant {\n";
       for(auto i : _marcoParserIdentifier) {
@@ -227,56 +327,110 @@ bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std
       header += push_constantsCode;
 
       for (auto& source : source_after_marco) {
+            source.insert(source.begin(), header.begin(), header.end());
+      }
 
-            std::optional<glslang_stage_t> find_shader_type = std::nullopt;
-            for (auto& i : ShaderTypeMap) {
-                  if (source.find(i.first) != std::string::npos) {
-                        find_shader_type = i.second;
-                        break;
-                  }
-            }
-
-            glslang_stage_t shader_type = find_shader_type.value();
-
-            //if(shader_type == ??) // 筛选器
+      const auto preprocess_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - preprocess_begin).count();
+      const auto preprocess_str = std::format("Program::CompileFromSourceCode - Preprocessed {} bytes of shader program \"{}\" in {:.3f} ms.", preprocess_bytes, _programName, preprocess_time);
+      MessageManager::Log(MessageType::Normal, preprocess_str);
 
-            source.insert(source.begin(), header.begin(), header.end());
+      // the expanded sources, outside the timed region, one write per stage so worker threads don't interleave lines
+      if (Context::Get()->IsDebug()) {
+            for (const auto& source : source_after_marco) {
+                  const auto dump = std::format("\n=============================\n{}\n=============================\n", source);
+                  std::fwrite(dump.data(), 1, dump.size(), stdout);
+            }
+      }
 
-            printf("\n=============================\n%s\n=============================\n", source.c_str());
+      // sources are final here, setters, spir-v and reflection only depend on them
+      std::string cache_path{};
+      uint64_t cache_key = 0;
+      if (!Context::Get()->GetProgramCacheDirectory().empty()) {
+            cache_key = ComputeCacheKey(sources, stage_includes, variant_mask);
+            cache_path = GetCachePath(cache_key);
+            _cacheKey = cache_key;
+
+            if (LoadFromCache(cache_path, cache_key)) {
+                  const auto success = std::format("Program::CompileFromSourceCode - Loaded shader program \"{}\" from cache \"{}\".", _programName, cache_path);
+                  MessageManager::Log(MessageType::Normal, success);
+                  if (!_keywords.empty() && variant_mask == 0) {
+                        _variantSources.assign(sources.begin(), sources.end());
+                  }
+                  _reusableStages.clear();
+                  _isCompiled = true;
+                  return true;
+            }
       }
 
 
+      // setters run in source order on this thread, they fill the pipeline state the reflection below checks against
+      for (uint32_t idx = 0; idx < stages.size(); idx++) {
+            std::string setter_parse_err_msg{};
+            if (!ParseSetters(stage_includes[idx].SetterLines, setter_parse_err_msg, stages[idx])) {
+                  auto err = std::format("Program::CompileFromSourceCode - Failed to parse setters for shader program \"{}\" shader type :\"{}\".\nSetterCompiler:\n{}",
+                  _programName, ShaderTypeHelperGetName(stages[idx]), setter_parse_err_msg);
+                  MessageManager::Log(MessageType::Warning, err);
+                  return false;
+            }
+      }
 
-      for (const auto& source : source_after_marco) {
-            setters.clear();
+      std::vector<std::string> stage_codes = std::move(source_after_marco);
 
-            std::string setter_parse_err_msg{};
-            std::string source_code_output{};
+      if (variant_mask != 0) {
+            if (_keywords.size() < MaxKeywords && (variant_mask >> _keywords.size()) != 0) {
+                  const auto err = std::format("Program::CompileFromSourceCode - Variant mask {:#x} of shader program \"{}\" sets bits past its {} keywords.",
+                  variant_mask, _programName, _keywords.size());
+                  MessageManager::Log(MessageType::Warning, err);
+                  return false;
+            }
 
-            std::optional<glslang_stage_t> find_shader_type = std::nullopt;
-            for (auto& i : ShaderTypeMap) {
-                  if (source.find(i.first) != std::string::npos) {
-                        find_shader_type = i.second;
-                        break;
+            // between the generated header and the user code, so "#ifdef" and "#if" both see them, ParseMarco already
+            // judged the blocks they guard the same way
+            std::string keyword_defines{};
+            for (uint32_t bit = 0; bit < _keywords.size(); bit++) {
+                  if (variant_mask & (1ull << bit)) {
+                        keyword_defines += std::format("#define {} 1\n", _keywords[bit]);
                   }
             }
+            for (auto& code : stage_codes) {
+                  code.insert(header.size(), keyword_defines);
+            }
+      }
+
+      // glslang only touches its own objects, stages compile concurrently, a stage whose code didn't change since
+      // the seeded program keeps its SPIR-V
+      std::vector<std::vector<uint32_t>> stage_spvs(stages.size());
+      std::vector<std::string> stage_err_msgs(stages.size());
+      std::vector<uint8_t> stage_results(stages.size());
+      std::vector<uint64_t> stage_hashes(stages.size());
+      std::atomic<uint32_t> reused_stages = 0;
+      Context::Get()->_threadPool.ParallelFor((uint32_t)stages.size(), [&](uint32_t i) {
+            stage_hashes[i] = XXH3_64bits_withSeed(stage_codes[i].data(), stage_codes[i].size(), (uint64_t)_optimizeLevel);
+            if (const auto finder = _reusableStages.find(stages[i]); finder != _reusableStages.end() && finder->second.first == stage_hashes[i]) {
+                  stage_spvs[i] = finder->second.second;
+                  stage_results[i] = true;
+                  reused_stages.fetch_add(1, std::memory_order_relaxed);
+                  return;
+            }
+            stage_results[i] = CompileFromCode(stage_codes[i].data(), stages[i], _optimizeLevel, stage_spvs[i], stage_err_msgs[i]);
+      });
+      _reusableStages.clear();
 
-            const glslang_stage_t shader_type = find_shader_type.value();
+      if (reused_stages != 0) {
+            auto str = std::format("Program::CompileFromSourceCode - Reused {} unchanged stages of shader program \"{}\".", reused_stages.load(), _programName);
+            MessageManager::Log(MessageType::Normal, str);
+      }
 
+      // reflection fills the shared tables, back in source order
+      for (uint32_t idx = 0; idx < stages.size(); idx++) {
+            const glslang_stage_t shader_type = stages[idx];
             std::string shader_type_str = ShaderTypeHelperGetName(shader_type);
-            std::vector<uint32_t> spv{};
+            std::vector<uint32_t>& spv = stage_spvs[idx];
             VkShaderModule shader_module{};
 
-            if (!ParseSetters(source, setters, source_code_output, setter_parse_err_msg, shader_type)) {
-                  auto err = std::format("Program::CompileFromSourceCode - Failed to parse setters for shader program \"{}\" shader type :\"{}\".\nSetterCompiler:\n{}",
-                  _programName, shader_type_str, setter_parse_err_msg);
-                  MessageManager::Log(MessageType::Warning, err);
-                  return false;
-            }
-
-            if (!CompileFromCode(source_code_output.data(), shader_type, spv, setter_parse_err_msg)) {
+            if (!stage_results[idx]) {
                   const auto err = std::format("Program::CompileFromSourceCode - Failed to compile shader program \"{}\", shader type :\"{}\".\nShaderCompiler:\n{}",
-                  _programName, shader_type_str, setter_parse_err_msg);
+                  _programName, shader_type_str, stage_err_msgs[idx]);
                   MessageManager::Log(MessageType::Warning, err);
                   return false;
             }
@@ -288,6 +442,8 @@ bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std
                         break;
                   case GLSLANG_STAGE_FRAGMENT: parse_result = ParseFS(spv);
                         break;
+                  case GLSLANG_STAGE_COMPUTE: parse_result = ParseCS(spv);
+                        break;
                   default: // TODO
                         break;
             }
@@ -302,7 +458,10 @@ bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std
             shader_ci.codeSize = spv.size() * sizeof(uint32_t);
             shader_ci.pCode = spv.data();
 
-            if (auto res = vkCreateShaderModule(volkGetLoadedDevice(), &shader_ci, nullptr, &shader_module); res != VK_SUCCESS) {
+            // an offline context only reflects, the program keeps its SPIR-V without a module
+            if (Context::Get()->IsOffline()) {
+                  shader_module = VK_NULL_HANDLE;
+            } else if (auto res = vkCreateShaderModule(volkGetLoadedDevice(), &shader_ci, nullptr, &shader_module); res != VK_SUCCESS) {
                   const auto err = std::format("Program::CompileFromSourceCode - Failed to create shader module for shader program \"{}\", shader type :\"{}\".",
                   _programName, shader_type_str);
                   MessageManager::Log(MessageType::Warning, err);
@@ -310,16 +469,25 @@ bool Program::CompileFromSourceCode(std::string_view name, const std::vector<std
             }
 
             _shaderModules[shader_type] = std::make_pair(std::move(spv), shader_module);
+            _stageCodeHashes[shader_type] = stage_hashes[idx];
             const auto success = std::format("Program::CompileFromSourceCode - Successfully compiled shader program \"{}\", shader type :\"{}\".",
             _programName, shader_type_str);
             MessageManager::Log(MessageType::Normal, success);
       }
 
+      if (!cache_path.empty()) {
+            SaveToCache(cache_path, cache_key);
+      }
+
+      if (!_keywords.empty() && variant_mask == 0) {
+            _variantSources.assign(sources.begin(), sources.end());
+      }
+
       _isCompiled = true;
       return true;
 }
 
-bool Program::CompileFromCode(const char* source, glslang_stage_t shader_type, std::vector<uint32_t>& spv, std::string& err_msg) {
+bool Program::CompileFromCode(const char* source, glslang_stage_t shader_type, ShaderOptimizeLevel optimize_level, std::vector<uint32_t>& spv, std::string& err_msg) {
       const glslang_input_t input = {
             .language = GLSLANG_SOURCE_GLSL,
             .stage = shader_type,
@@ -364,11 +532,13 @@ bool Program::CompileFromCode(const char* source, glslang_stage_t shader_type, s
             return false;
       }
 
+      // debug names are kept, reflection finds the bindless blocks and struct members by name, glslang's own optimizer
+      // only runs a fixed pass list, the recipes below replace it
       glslang_spv_options_t spv_options = {
             .generate_debug_info = false,
             .strip_debug_info = false,
-            .disable_optimizer = false,
-            .optimize_size = true,
+            .disable_optimizer = true,
+            .optimize_size = false,
             .disassemble = false,
             .validate = true,
             .emit_nonsemantic_shader_debug_info = false,
@@ -376,260 +546,508 @@ bool Program::CompileFromCode(const char* source, glslang_stage_t shader_type, s
             .compile_only = false,
       };
 
-      //glslang_program_SPIRV_generate_with_options(program, stage, &spv_options);
-      glslang_program_SPIRV_generate(program, shader_type);
+      glslang_program_SPIRV_generate_with_options(program, shader_type, &spv_options);
 
       spv.resize(glslang_program_SPIRV_get_size(program));
       memcpy(spv.data(), glslang_program_SPIRV_get_ptr(program), glslang_program_SPIRV_get_size(program) * sizeof(uint32_t));
       glslang_program_delete(program);
       glslang_shader_delete(shader);
 
+      if (optimize_level == ShaderOptimizeLevel::None) {
+            return true;
+      }
+
+      spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_3);
+      std::string opt_log{};
+      optimizer.SetMessageConsumer([&](spv_message_level_t level, const char*, const spv_position_t&, const char* message) {
+            if (level <= SPV_MSG_ERROR) opt_log += std::format("{}\n", message);
+      });
+
+      if (optimize_level == ShaderOptimizeLevel::Performance) {
+            optimizer.RegisterPerformancePasses();
+      } else {
+            optimizer.RegisterSizePasses();
+      }
+
+      // bindings and spec constant ids are what the pipeline layout and the spec data are built against
+      spvtools::OptimizerOptions opt_options{};
+      opt_options.set_preserve_bindings(true);
+      opt_options.set_preserve_spec_constants(true);
+
+      std::vector<uint32_t> optimized{};
+      if (!optimizer.Run(spv.data(), spv.size(), &optimized, opt_options)) {
+            err_msg = std::format("Failed to optimize shader: {}.", opt_log);
+            return false;
+      }
+      spv = std::move(optimized);
+
       return true;
 }
 
-bool Program::ParseMarco(std::string_view input_code, std::string& output_codes, std::string& error_message, glslang_stage_t shader_type) {
-      std::string_view::size_type start = 0;
-      std::string_view::size_type find;
-      std::string_view::size_type end;
+bool Program::PreprocessStage(const std::vector<ShaderToken>& tokens, glslang_stage_t shader_type, std::string& output_codes, std::string& error_message) {
+      ShaderIncludeContext include_context{};
+      return ParseMarco(tokens, shader_type, output_codes, include_context, error_message);
+}
 
-      std::string_view source_code = input_code;
+bool Program::ParseMarco(const std::vector<ShaderToken>& tokens, glslang_stage_t shader_type, std::string& output_codes,
+ShaderIncludeContext& include_context, std::string& error_message) {
+      // source text from the first to the last token, both included
+      auto TokenRange = [&](size_t first, size_t last) -> std::string_view {
+            const char* begin = tokens[first].Text.data();
+            const char* end = tokens[last].Text.data() + tokens[last].Text.size();
+            return std::string_view{begin, (size_t)(end - begin)};
+      };
 
-      //return <word, code after word>
-      auto EatWord = [](const std::string_view str) -> std::optional<std::pair<std::string_view, std::string_view>> {
-            std::string_view::size_type word_start = 0;
-            std::string_view::size_type index = 0;
+      // index of the '}' closing the '{' at open, tokens.size() when unbalanced
+      auto MatchBrace = [&](size_t open) -> size_t {
+            int64_t depth = 0;
+            for (size_t i = open; i < tokens.size(); i++) {
+                  if (tokens[i].Type != ShaderTokenType::Punctuator) continue;
+                  if (tokens[i].Text == "{") {
+                        depth++;
+                  } else if (tokens[i].Text == "}" && --depth == 0) {
+                        return i;
+                  }
+            }
+            return tokens.size();
+      };
 
-            // eat space
-            for (; word_start < str.size(); word_start++) {
-                  if (str[word_start] == ' ' || str[word_start] == '\t' || str[word_start] == '\r' || str[word_start] == '\n') { continue; } else { break; }
+      auto IsPunctuator = [&](size_t index, char c) {
+            return index < tokens.size() && tokens[index].Type == ShaderTokenType::Punctuator && tokens[index].Text[0] == c;
+      };
+
+      auto IsIdentifier = [&](size_t index) {
+            return index < tokens.size() && tokens[index].Type == ShaderTokenType::Identifier;
+      };
+
+      // the directive is kept as a comment and the file's expanded code follows it, an already included file expands to nothing
+      auto ExpandInclude = [&](const ShaderToken& token) -> bool {
+            const std::string_view directive = token.Text;
+            const auto open = directive.find_first_of("\"<", 8);
+            const auto close = open == std::string_view::npos ? open : directive.find(directive[open] == '"' ? '"' : '>', open + 1);
+            if (close == std::string_view::npos || close == open + 1) {
+                  error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need a path like #include \"lib/common.lofi\".", token.Line);
+                  return false;
             }
 
-            index = word_start;
-            for (; index < str.size(); index++) {
-                  if (std::isalnum(str[index]) || str[index] == '_') { continue; } else {break;}
+            if (include_context.Depth >= MaxIncludeDepth) {
+                  error_message = std::format("Program::ParseMarco - at line {} : #include nested deeper than {}, recursive include?", token.Line, MaxIncludeDepth);
+                  return false;
             }
 
-            if (index == word_start) {
-                  return std::nullopt;
-            } else {
-                  if (index >= str.size()) {
-                        return std::make_pair(str.substr(word_start, index - word_start), std::string_view{});
-                  } else {
-                        return std::make_pair(str.substr(word_start, index - word_start), str.substr(index, str.size() - index));
-                  }
+            const auto path = directive.substr(open + 1, close - open - 1);
+            auto file = Context::Get()->_shaderFileSystem.Load(path, include_context.CurrentFile);
+            if (!file) {
+                  error_message = std::format("Program::ParseMarco - at line {} : Can't find include file \"{}\".", token.Line, path);
+                  return false;
+            }
+
+            output_codes += "//";
+            output_codes += directive;
+            output_codes += "\n";
+
+            if (!include_context.IncludedFiles.emplace(file->Path).second) return true;
+            include_context.Files.push_back(file);
+
+            std::string included_code{};
+            std::string parent_file = std::move(include_context.CurrentFile);
+            include_context.CurrentFile = file->Path;
+            include_context.Depth++;
+            const bool result = ParseMarco(file->Tokens, shader_type, included_code, include_context, error_message);
+            include_context.Depth--;
+            include_context.CurrentFile = std::move(parent_file);
+
+            if (!result) {
+                  error_message = std::format("{}\n      in \"{}\"", error_message, file->Path);
+                  return false;
             }
+
+            output_codes += included_code;
+            return true;
       };
 
-      //return <code in front of marco, code after marco>
-      auto FindMarco = [](std::string_view codes, std::string_view marco) -> std::pair<std::string_view, std::string_view> {
-            if(const auto find_pos = codes.find(marco); find_pos != std::string_view::npos) {
-                  return std::make_pair(codes.substr(0, find_pos), codes.substr(find_pos + marco.size(), codes.size() - find_pos - marco.size()));
-            } else {
-                  return std::make_pair(codes, std::string_view{});
+      // "keywords = [FOG, SHADOWS]", malformed lists are left for ParseSetters to report
+      auto CollectKeywords = [&](std::string_view setter) {
+            if (TakeDirectiveIdentifier(setter) != "keywords") return;
+            const auto open = setter.find('[');
+            const auto close = setter.find(']');
+            if (open == std::string_view::npos || close == std::string_view::npos || close < open) return;
+
+            std::string_view rest = setter.substr(open + 1, close - open - 1);
+            while (!rest.empty()) {
+                  const auto comma = rest.find(',');
+                  auto item = rest.substr(0, comma);
+                  rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+                  const auto keyword = TakeDirectiveIdentifier(item);
+                  if (keyword.empty() || std::ranges::find(_parsedKeywords, keyword) != _parsedKeywords.end()) continue;
+                  if (_parsedKeywords.size() == MaxKeywords) return;
+                  _parsedKeywords.emplace_back(keyword);
             }
       };
 
-      auto FindFrontMarcos = [&](std::string_view codes, const std::vector<std::string_view>& marcos) -> std::tuple<std::string_view, std::string_view, std::string_view> {
-            size_t find_pos = std::string_view::npos;
-            std::string_view marco = {};
-            for(auto i: marcos) {
-                  if(const auto res = codes.find(i); res != std::string_view::npos) {
-                        if(res < find_pos) {
-                              find_pos = res;
-                              marco = i;
-                        }
-                  }
+      std::string_view entry_point_str{};
+      for (auto& i : ShaderTypeMap) {
+            if (i.second == shader_type) {
+                  entry_point_str = i.first;
+                  break;
             }
+      }
 
-            if(!marco.empty()) {
-                  const auto temp = FindMarco(codes, marco);
-                  return std::make_tuple(temp.first, temp.second, marco);
-            } else {
-                  return std::make_tuple(codes, std::string_view{}, std::string{});
+      output_codes.clear();
+      if (!tokens.empty()) {
+            output_codes.reserve(TokenRange(0, tokens.size() - 1).size());
+      }
+
+      // a name is known defined by a "#define" or an enabled keyword and known undefined as a disabled keyword, anything
+      // else is left to glslang, which keeps both sides of its conditional live here like before
+      auto IsDefined = [&](std::string_view name) -> std::optional<bool> {
+            if (include_context.Defines.contains(std::string{name})) return true;
+            if (const auto finder = std::ranges::find(_parsedKeywords, name); finder != _parsedKeywords.end()) {
+                  return (_parsedVariantMask >> std::distance(_parsedKeywords.begin(), finder) & 1) != 0;
             }
+            return std::nullopt;
       };
 
-     // return <code after bracket, optional<bracket type>>
-      auto EatBracket = [](std::string_view str) -> std::pair<std::string_view, std::optional<char>> {
-            std::string_view::size_type word = 0;
-            for(; word < str.size(); word++) {
-                  if (str[word] == ' ' || str[word] == '\t'|| str[word] == '\n'|| str[word] == '\r') { continue; } else { break; }
-            }
-
-            char bracket_type = 0;
-            if (str[word] == '(') { bracket_type = '('; }
-            else if (str[word] == '{') { bracket_type = '{'; }
-            else if (str[word] == '[') { bracket_type = '['; }
-            else if (str[word] == ')') { bracket_type = ')'; }
-            else if (str[word] == '}') { bracket_type = '}'; }
-            else if (str[word] == ']') { bracket_type = ']'; }
-
-            if(bracket_type == 0) {
-                  return {str, std::nullopt};
-            }else {
-                  if(word + 1 >= str.size()) {
-                        return std::make_pair(std::string_view{}, bracket_type);
-                  } else {
-                        return std::make_pair(str.substr(word + 1, str.size() - word - 1), bracket_type);
-                  }
+      // "NAME", "defined(NAME)", "defined NAME", with an optional leading '!', a keyword is defined as 1
+      auto EvaluateCondition = [&](std::string_view word, std::string_view condition) -> std::optional<bool> {
+            if (word == "ifdef" || word == "ifndef") {
+                  const auto name = TakeDirectiveIdentifier(condition);
+                  if (name.empty() || !TrimDirectiveSpace(condition).empty()) return std::nullopt;
+                  const auto defined = IsDefined(name);
+                  return defined.has_value() && word == "ifndef" ? !*defined : defined;
             }
-      };
 
-      // return <code block, after code block>
-      auto EatCodeBlock = [](std::string_view str) -> std::optional<std::pair<std::string_view, std::string_view>> {
-            int64_t index = 0;
+            condition = TrimDirectiveSpace(condition);
+            const bool negated = condition.starts_with('!');
+            if (negated) condition.remove_prefix(1);
+
+            auto name = TakeDirectiveIdentifier(condition);
+            const bool use_defined = name == "defined";
+            if (use_defined) {
+                  condition = TrimDirectiveSpace(condition);
+                  const bool parenthesized = condition.starts_with('(');
+                  if (parenthesized) condition.remove_prefix(1);
+                  name = TakeDirectiveIdentifier(condition);
+                  condition = TrimDirectiveSpace(condition);
+                  if (parenthesized && !condition.starts_with(')')) return std::nullopt;
+                  if (parenthesized) condition.remove_prefix(1);
+            }
+            if (name.empty() || !TrimDirectiveSpace(condition).empty()) return std::nullopt;
 
-            int64_t start = 0;
-            int64_t end = 0;
-            int64_t bracket_match_index = 0;
+            // "#if NAME" of a #define'd name depends on its value
+            if (!use_defined && include_context.Defines.contains(std::string{name})) return std::nullopt;
+            const auto defined = IsDefined(name);
+            return defined.has_value() && negated ? !*defined : defined;
+      };
 
-            bool finded = false;
-            while(index < str.size()) {
-                  if(str[index] == '{') {
-                        if(finded) {
-                              bracket_match_index++;
+      struct ConditionalFrame {
+            bool ParentActive;
+            bool Active;
+            bool Known; // every branch so far had a condition IsDefined could answer
+            bool Taken; // a known branch was active
+      };
+      std::vector<ConditionalFrame> conditionals{};
+      auto IsActive = [&] { return conditionals.empty() || conditionals.back().Active; };
+
+      for (size_t i = 0; i < tokens.size(); i++) {
+            const auto& token = tokens[i];
+
+            if (token.Type == ShaderTokenType::Directive) {
+                  const auto [word, argument] = SplitDirective(token.Text);
+
+                  if (word == "if" || word == "ifdef" || word == "ifndef") {
+                        const auto condition = EvaluateCondition(word, argument);
+                        const bool parent_active = IsActive();
+                        conditionals.push_back({parent_active, parent_active && condition.value_or(true), condition.has_value(), condition.value_or(false)});
+                  } else if ((word == "elif" || word == "else") && !conditionals.empty()) {
+                        auto& frame = conditionals.back();
+                        if (frame.Known && frame.Taken) {
+                              frame.Active = false;
+                        } else if (!frame.Known) {
+                              frame.Active = frame.ParentActive;
+                        } else if (word == "else") {
+                              frame.Active = frame.ParentActive;
+                              frame.Taken = true;
                         } else {
-                              finded = true;
-                              start = index;
-                              bracket_match_index++;
+                              const auto condition = EvaluateCondition(word, argument);
+                              frame.Known = condition.has_value();
+                              frame.Taken = condition.value_or(false);
+                              frame.Active = frame.ParentActive && condition.value_or(true);
                         }
-                  }else if(str[index] == '}') {
-                        if(finded) {
-                              bracket_match_index--;
-                              if(bracket_match_index == 0) {
-                                    end = index;
-
-                                    if(end + 1 >= str.size())
-                                          return std::make_pair(std::string_view{str.begin() + start, str.begin() + end + 1}, std::string_view{});
-                                    else
-                                          return std::make_pair(
-                                                      std::string_view{str.begin() + start, str.begin() + end + 1},
-                                                      std::string_view{str.begin() + end + 1, str.begin() + (int64_t)str.size()}
-                                                );
-                              }
+                  } else if (word == "endif" && !conditionals.empty()) {
+                        conditionals.pop_back();
+                  } else if (!IsActive()) {
+                        // glslang skips the directive too, a "#set" or "#include" here must not be applied
+                        if (word == "set" || word == "include") output_codes += "//";
+                  } else if (word == "define" || word == "undef") {
+                        auto rest = argument;
+                        const std::string name{TakeDirectiveIdentifier(rest)};
+                        if (word == "define") {
+                              include_context.Defines.emplace(name);
+                        } else {
+                              include_context.Defines.erase(name);
                         }
+                  } else if (word == "set") {
+                        // setters are applied later, glslang only sees them as comments, keywords are needed right away
+                        // so the blocks they guard are judged while they are parsed
+                        include_context.SetterLines.emplace_back(token.Line, token.Text);
+                        CollectKeywords(argument);
+                        output_codes += "//";
+                  } else if (word == "include") {
+                        if (!ExpandInclude(token)) return false;
+                        continue;
                   }
-                  index++;
+                  output_codes += token.Text;
+                  continue;
             }
 
-            return std::nullopt;
-      };
+            // glslang drops the inactive branches, their marcos don't become parameters
+            if (!IsActive()) {
+                  output_codes += token.Text;
+                  continue;
+            }
 
-      output_codes = "";
-      std::vector<std::string_view> marcos_to_find{"STRUCTEXT", "TEXTURE", "STRUCT"};
-      while(true) {
-            auto [front, after, marco] = FindFrontMarcos(source_code, marcos_to_find);
+            if (token.Type != ShaderTokenType::Identifier) {
+                  output_codes += token.Text;
+                  continue;
+            }
 
-            if(after.empty()) {
-                  output_codes += front;
-                  break;
-            } else {
-                  output_codes += front;
-                  source_code = after;
-                  if(marco == "STRUCTEXT") {
+            if (token.Text == entry_point_str) {
+                  output_codes += "main";
+                  continue;
+            }
 
-                        auto struct_type_eat_word = EatWord(source_code);
-                        if(!struct_type_eat_word.has_value()) {
-                              error_message = std::format("Program::ParseMarco - Invalid statement, need a struct name after \"{}\" key word.", marco);
+            const std::string_view marco = token.Text;
+            if (marco == "STRUCTEXT" || marco == "STRUCT") {
+                  const size_t name_idx = ShaderLexer::SkipTrivia(tokens, i + 1);
+                  if (!IsIdentifier(name_idx)) {
+                        error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need a struct name after \"{}\" key word.", token.Line, marco);
+                        return false;
+                  }
+
+                  const auto struct_typename = tokens[name_idx].Text;
+
+                  const size_t open_idx = ShaderLexer::SkipTrivia(tokens, name_idx + 1);
+                  const size_t close_idx = IsPunctuator(open_idx, '{') ? MatchBrace(open_idx) : tokens.size();
+                  if (close_idx == tokens.size()) {
+                        error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need a code block after struct type name \"{}\".", token.Line, struct_typename);
+                        return false;
+                  }
+
+                  output_codes += std::format("struct _{}Data {}; layout(set = 0, binding = BindlessStorageBinding) readonly buffer {} {{ _{}Data _data[]; }} _bindless{}[];",
+                  struct_typename, TokenRange(open_idx, close_idx), struct_typename, struct_typename, struct_typename);
+                  i = close_idx;
+
+                  std::string str_struct_name = std::string{struct_typename.begin(), struct_typename.end()};
+                  if(_marcoParserIdentifierTable.contains(str_struct_name)) {
+                        if(_marcoParserIdentifierTable[str_struct_name] != marco)  {
+                              error_message = std::format("Program::ParseMarco - In {}: struct name \"{}\" is already used as a {}.", ShaderTypeHelperGetName(shader_type), str_struct_name, _marcoParserIdentifierTable[str_struct_name]);
                               return false;
                         }
+                  } else {
+                        _marcoParserIdentifier.emplace_back(str_struct_name, std::string{marco});
+                        _marcoParserIdentifierTable.emplace(str_struct_name, std::string{marco});
+                  }
 
-                        auto [struct_typename, code_after_struct_typename] = struct_type_eat_word.value(); // typename
-                        source_code = code_after_struct_typename;
+            } else if (marco == "TEXTURE") {
+                  const size_t name_idx = ShaderLexer::SkipTrivia(tokens, i + 1);
+                  if (!IsIdentifier(name_idx)) {
+                        error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need a texture name after \"{}\" key word.", token.Line, marco);
+                        return false;
+                  }
 
-                        const auto eat_code_block = EatCodeBlock(source_code);
-                        if(!eat_code_block.has_value()) {
-                              error_message = std::format("Program::ParseMarco - Invalid statement, need a code block after struct type name \"{}\".", struct_typename);
+                  const auto texture_var_name = tokens[name_idx].Text;
+                  i = name_idx;
+
+                  std::string str_texture_var_name = std::string{texture_var_name.begin(), texture_var_name.end()};
+                  if(_marcoParserIdentifierTable.contains(str_texture_var_name)) {
+                        if(_marcoParserIdentifierTable[str_texture_var_name] != "TEXTURE")  {
+                              error_message = std::format("Program::ParseMarco - In {}: texture name \"{}\" is already used as a {}.",ShaderTypeHelperGetName(shader_type), texture_var_name, _marcoParserIdentifierTable[str_texture_var_name]);
                               return false;
                         }
+                  } else {
+                        _marcoParserIdentifier.emplace_back(str_texture_var_name, "TEXTURE");
+                        _marcoParserIdentifierTable.emplace(str_texture_var_name, "TEXTURE");
+                  }
 
-                        const auto [code_block, code_after_block] = eat_code_block.value();
-
-                        output_codes += std::format("layout(set = 0, binding = BindlessStorageBinding) readonly buffer {} {} _bindless{}[];", struct_typename, code_block, struct_typename);
-                        source_code = code_after_block;
+            } else if (marco == "IMAGE" || marco == "BUFFER") {
+                  // IMAGE [(format)] Name;  BUFFER Name { members };  storage resources written by compute kernels,
+                  // each declares its own array over the shared bindless binding and reads its slot from the push constants
+                  if (shader_type != GLSLANG_STAGE_COMPUTE) {
+                        error_message = std::format("Program::ParseMarco - at line {} : \"{}\" is only available in compute shader.", token.Line, marco);
+                        return false;
+                  }
 
-                        std::string str_struct_name = std::string{struct_typename.begin(), struct_typename.end()};
-                        if(_marcoParserIdentifierTable.contains(str_struct_name)) {
-                              if(_marcoParserIdentifierTable[str_struct_name] != "STRUCTEXT")  {
-                                    error_message = std::format("Program::ParseMarco - In {}: struct name \"{}\" is already used as a {}.", ShaderTypeHelperGetName(shader_type), str_struct_name, _marcoParserIdentifierTable[str_struct_name]);
-                                    return false;
-                              }
-                        } else {
-                              _marcoParserIdentifier.emplace_back(str_struct_name, "STRUCTEXT");
-                              _marcoParserIdentifierTable.emplace(str_struct_name, "STRUCTEXT");
+                  size_t name_idx = ShaderLexer::SkipTrivia(tokens, i + 1);
+                  std::string_view image_format{};
+                  if (marco == "IMAGE" && IsPunctuator(name_idx, '(')) {
+                        const size_t format_idx = ShaderLexer::SkipTrivia(tokens, name_idx + 1);
+                        const size_t close_idx = ShaderLexer::SkipTrivia(tokens, format_idx + 1);
+                        if (!IsIdentifier(format_idx) || !IsPunctuator(close_idx, ')')) {
+                              error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need an image format like \"IMAGE(rgba8) Name;\".", token.Line);
+                              return false;
                         }
+                        image_format = tokens[format_idx].Text;
+                        name_idx = ShaderLexer::SkipTrivia(tokens, close_idx + 1);
+                  }
+
+                  if (!IsIdentifier(name_idx)) {
+                        error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need a resource name after \"{}\" key word.", token.Line, marco);
+                        return false;
+                  }
 
-                  } else if(marco == "STRUCT") {
+                  const auto resource_name = tokens[name_idx].Text;
 
-                        auto struct_type_eat_word = EatWord(source_code);
-                        if(!struct_type_eat_word.has_value()) {
-                              error_message = std::format("Program::ParseMarco - Invalid statement, need a struct name after \"{}\" key word.", marco);
+                  if (marco == "IMAGE") {
+                        // without a format the device needs shaderStorageImageReadWithoutFormat / WriteWithoutFormat
+                        output_codes += std::format("layout(set = 0, binding = BindlessStorageImageBinding{}{}) uniform image2D _bindless{}[]",
+                        image_format.empty() ? "" : ", ", image_format, resource_name);
+                        i = name_idx;
+                  } else {
+                        const size_t open_idx = ShaderLexer::SkipTrivia(tokens, name_idx + 1);
+                        const size_t close_idx = IsPunctuator(open_idx, '{') ? MatchBrace(open_idx) : tokens.size();
+                        if (close_idx == tokens.size()) {
+                              error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need a code block after buffer name \"{}\".", token.Line, resource_name);
                               return false;
                         }
 
-                        auto [struct_typename, code_after_struct_typename] = struct_type_eat_word.value(); // typename
-                        source_code = code_after_struct_typename;
+                        output_codes += std::format("layout(set = 0, binding = BindlessStorageBinding) buffer {} {} _bindless{}[];", resource_name, TokenRange(open_idx, close_idx), resource_name);
+                        i = close_idx;
+                  }
 
-                        const auto eat_code_block = EatCodeBlock(source_code);
-                        if(!eat_code_block.has_value()) {
-                              error_message = std::format("Program::ParseMarco - Invalid statement, need a code block after struct type name \"{}\".", struct_typename);
+                  std::string str_resource_name = std::string{resource_name.begin(), resource_name.end()};
+                  if(_marcoParserIdentifierTable.contains(str_resource_name)) {
+                        if(_marcoParserIdentifierTable[str_resource_name] != marco)  {
+                              error_message = std::format("Program::ParseMarco - In {}: resource name \"{}\" is already used as a {}.", ShaderTypeHelperGetName(shader_type), str_resource_name, _marcoParserIdentifierTable[str_resource_name]);
                               return false;
                         }
+                  } else {
+                        _marcoParserIdentifier.emplace_back(str_resource_name, std::string{marco});
+                        _marcoParserIdentifierTable.emplace(str_resource_name, std::string{marco});
+                  }
 
-                        const auto [code_block, code_after_block] = eat_code_block.value();
+            } else if (marco == "SPECCONST") {
+                  // SPECCONST [bool|int|uint|float] name = default; the type is inferred from the default when omitted
+                  size_t name_idx = ShaderLexer::SkipTrivia(tokens, i + 1);
+                  if (!IsIdentifier(name_idx)) {
+                        error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, need a constant name after \"{}\" key word.", token.Line, marco);
+                        return false;
+                  }
 
-                        output_codes += std::format("layout(set = 0, binding = BindlessStorageBinding) readonly buffer {} {} _bindless{}[];", struct_typename, code_block, struct_typename);
-                        source_code = code_after_block;
+                  std::string_view const_type_name{};
+                  std::string_view const_name = tokens[name_idx].Text;
+                  if (const size_t next_idx = ShaderLexer::SkipTrivia(tokens, name_idx + 1); IsIdentifier(next_idx)) {
+                        const_type_name = const_name;
+                        const_name = tokens[next_idx].Text;
+                        name_idx = next_idx;
+                  }
 
-                        std::string str_struct_name = std::string{struct_typename.begin(), struct_typename.end()};
-                        if(_marcoParserIdentifierTable.contains(str_struct_name)) {
-                              if(_marcoParserIdentifierTable[str_struct_name] != "STRUCT")  {
-                                    error_message = std::format("Program::ParseMarco - In {}: struct name \"{}\" is already used as a {}.", ShaderTypeHelperGetName(shader_type), str_struct_name, _marcoParserIdentifierTable[str_struct_name]);
-                                    return false;
-                              }
-                        } else {
-                              _marcoParserIdentifier.emplace_back(str_struct_name, "STRUCT");
-                              _marcoParserIdentifierTable.emplace(str_struct_name, "STRUCT");
-                        }
+                  const size_t assign_idx = ShaderLexer::SkipTrivia(tokens, name_idx + 1);
+                  size_t end_idx = assign_idx;
+                  while (end_idx < tokens.size() && !IsPunctuator(end_idx, ';')) end_idx++;
 
-                  } else if(marco == "TEXTURE") {
-                        auto struct_type_eat_word = EatWord(source_code);
-                        if(!struct_type_eat_word.has_value()) {
-                              error_message = std::format("Program::ParseMarco - Invalid statement, need a texture name after \"{}\" key word.", marco);
-                              return false;
-                        }
+                  const size_t value_idx = IsPunctuator(assign_idx, '=') ? ShaderLexer::SkipTrivia(tokens, assign_idx + 1) : tokens.size();
+                  if (end_idx == tokens.size() || value_idx >= end_idx) {
+                        error_message = std::format("Program::ParseMarco - at line {} : Invalid statement, specialization constant \"{}\" needs a default value, like \"SPECCONST {} = 1;\".", token.Line, const_name, const_name);
+                        return false;
+                  }
 
-                        auto [texture_var_name, code_after_struct_typename] = struct_type_eat_word.value(); // typename
-                        source_code = code_after_struct_typename;
+                  size_t value_last = end_idx - 1;
+                  while (ShaderLexer::IsTrivia(tokens[value_last])) value_last--;
+                  const std::string_view default_text = TokenRange(value_idx, value_last);
+                  i = end_idx;
+
+                  SpecConstantType const_type;
+                  if(const_type_name.empty()) {
+                        if(default_text == "true" || default_text == "false") { const_type = SpecConstantType::Bool; }
+                        else if(default_text.ends_with('u') || default_text.ends_with('U')) { const_type = SpecConstantType::Uint; }
+                        else if(!default_text.starts_with("0x") && (default_text.contains('.') || default_text.contains('e') || default_text.ends_with('f'))) { const_type = SpecConstantType::Float; }
+                        else { const_type = SpecConstantType::Int; }
+                  } else if(const_type_name == "bool") { const_type = SpecConstantType::Bool; }
+                  else if(const_type_name == "int") { const_type = SpecConstantType::Int; }
+                  else if(const_type_name == "uint") { const_type = SpecConstantType::Uint; }
+                  else if(const_type_name == "float") { const_type = SpecConstantType::Float; }
+                  else {
+                        error_message = std::format("Program::ParseMarco - Invalid type \"{}\" for specialization constant \"{}\", expected [bool, int, uint, float].", const_type_name, const_name);
+                        return false;
+                  }
 
-                        std::string str_texture_var_name = std::string{texture_var_name.begin(), texture_var_name.end()};
-                        if(_marcoParserIdentifierTable.contains(str_texture_var_name)) {
-                              if(_marcoParserIdentifierTable[str_texture_var_name] != "TEXTURE")  {
-                                    error_message = std::format("Program::ParseMarco - In {}: texture name \"{}\" is already used as a {}.",ShaderTypeHelperGetName(shader_type), texture_var_name, _marcoParserIdentifierTable[str_texture_var_name]);
-                                    return false;
+                  // the whole default has to convert to the declared type, glsl then gets the converted value, "int X = 1.5"
+                  // is rejected instead of being truncated here and compiled as 1.5
+                  uint32_t default_value = 0;
+                  std::string default_code{};
+                  try {
+                        std::string text{default_text};
+                        size_t used = 0;
+                        switch(const_type) {
+                              case SpecConstantType::Bool:
+                                    if(text != "true" && text != "false") throw std::invalid_argument(text);
+                                    default_value = text == "true";
+                                    default_code = text;
+                                    used = text.size();
+                                    break;
+                              case SpecConstantType::Int: {
+                                    const auto value = std::stoll(text, &used, 0);
+                                    if(value < INT32_MIN || value > INT32_MAX) throw std::out_of_range(text);
+                                    default_value = std::bit_cast<uint32_t>((int32_t)value);
+                                    default_code = std::format("{}", (int32_t)value);
+                                    break;
+                              }
+                              case SpecConstantType::Uint: {
+                                    if(text.ends_with('u') || text.ends_with('U')) text.pop_back();
+                                    if(text.starts_with('-')) throw std::out_of_range(text);
+                                    const auto value = std::stoull(text, &used, 0);
+                                    if(value > UINT32_MAX) throw std::out_of_range(text);
+                                    default_value = (uint32_t)value;
+                                    default_code = std::format("{}u", (uint32_t)value);
+                                    break;
+                              }
+                              case SpecConstantType::Float: {
+                                    if(text.ends_with('f') || text.ends_with('F')) text.pop_back();
+                                    const auto value = std::stof(text, &used);
+                                    if(!std::isfinite(value)) throw std::out_of_range(text);
+                                    default_value = std::bit_cast<uint32_t>(value);
+                                    default_code = std::format("{}", value); // shortest text that reads back as the same float
+                                    if(default_code.find_first_of(".e") == std::string::npos) default_code += ".0";
+                                    break;
                               }
-                        } else {
-                              _marcoParserIdentifier.emplace_back(str_texture_var_name, "TEXTURE");
-                              _marcoParserIdentifierTable.emplace(str_texture_var_name, "TEXTURE");
                         }
+                        if(used != text.size()) throw std::invalid_argument(text);
+                  } catch(const std::exception&) {
+                        constexpr std::string_view type_names[] = {"bool", "int", "uint", "float"};
+                        error_message = std::format("Program::ParseMarco - at line {} : Invalid default value \"{}\" for {} specialization constant \"{}\".", token.Line, default_text, type_names[(uint32_t)const_type], const_name);
+                        return false;
+                  }
+
+                  std::string str_const_name = std::string{const_name.begin(), const_name.end()};
+                  if(_marcoParserIdentifierTable.contains(str_const_name) && _marcoParserIdentifierTable[str_const_name] != "SPECCONST") {
+                        error_message = std::format("Program::ParseMarco - In {}: constant name \"{}\" is already used as a {}.", ShaderTypeHelperGetName(shader_type), str_const_name, _marcoParserIdentifierTable[str_const_name]);
+                        return false;
                   }
+
+                  // stages share the constant id of a name, the declarations have to agree
+                  auto finder = _specConstantTable.find(str_const_name);
+                  if(finder == _specConstantTable.end()) {
+                        finder = _specConstantTable.emplace(str_const_name, SpecConstantInfo{(uint32_t)_specConstantTable.size(), const_type, default_value}).first;
+                        _marcoParserIdentifierTable.emplace(str_const_name, "SPECCONST");
+                  } else if(finder->second.Type != const_type || finder->second.DefaultValue != default_value) {
+                        error_message = std::format("Program::ParseMarco - In {}: specialization constant \"{}\" is declared differently in another stage.", ShaderTypeHelperGetName(shader_type), str_const_name);
+                        return false;
+                  }
+
+                  constexpr std::string_view type_names[] = {"bool", "int", "uint", "float"};
+                  output_codes += std::format("layout(constant_id = {}) const {} {} = {};", finder->second.ConstantId, type_names[(uint32_t)const_type], str_const_name, default_code);
+
+            } else {
+                  output_codes += token.Text;
             }
       }
 
       return true;
 }
 
-bool Program::ParseSetters(std::string_view codes, entt::dense_map<std::string, std::vector<std::string>>& _setters,
-std::string& output_codes, std::string& error_message, glslang_stage_t shader_type) {
-      std::vector<std::string_view> lines;
-      std::string_view::size_type start = 0;
-      std::string_view::size_type end;
-
-      while ((end = codes.find('\n', start)) != std::string_view::npos) {
-            lines.emplace_back(codes.substr(start, end - start));
-            start = end + 1;
-      }
-
+bool Program::ParseSetters(const std::vector<std::pair<uint32_t, std::string_view>>& setter_lines, std::string& error_message, glslang_stage_t shader_type) {
       auto EatSpace = [](const std::string_view str) -> std::pair<std::string_view, std::string_view> {
             std::string_view::size_type index = 0;
             for (; index < str.size(); index++) {
@@ -662,42 +1080,10 @@ std::string& output_codes, std::string& error_message, glslang_stage_t shader_ty
             }
       };
 
-      std::string entry_point_str;
-      for (auto& i : ShaderTypeMap) {
-            if (i.second == shader_type) {
-                  entry_point_str = i.first;
-                  break;
-            }
-      }
-
-
-      for (int line = 0; line < lines.size(); ++line) {
-            auto piece = lines[line];
-
-            auto pos = piece.find("#set");
-            if (pos == std::string_view::npos) {
-                  if (auto epos = piece.find(entry_point_str); epos != std::string_view::npos) {
-                        //replace entry_point_str to main
-                        auto endpos = epos + entry_point_str.size();
-                        std::string newLine = std::format("{}{}{}", piece.substr(0, epos), "main", piece.substr(endpos, piece.size() - endpos));
-                        output_codes += newLine;
-                        output_codes += "\n";
-                  } else {
-                        output_codes += piece;
-                        output_codes += "\n";
-                  }
-                  continue;
-            } else {
-                  auto posCommit = piece.find("//#set");
-                  if (posCommit != std::string_view::npos) {
-                        output_codes += piece;
-                        output_codes += "\n";
-                        continue;
-                  } else {
-                        output_codes += "//";
-                        output_codes += piece;
-                        output_codes += "\n";
-                  }
+      for (const auto& [line, directive] : setter_lines) {
+            auto piece = directive;
+            while (!piece.empty() && (piece.back() == '\r' || piece.back() == ' ' || piece.back() == '\t')) {
+                  piece.remove_suffix(1);
             }
 
             piece = EatSpace(piece).second;
@@ -786,12 +1172,6 @@ std::string& output_codes, std::string& error_message, glslang_stage_t shader_ty
                   error_message = analyze_error_msg;
                   return false;
             }
-
-            auto outputS_str = std::format("set {} = ", setter.first);
-            for (const auto& v : setter.second) {
-                  outputS_str += v;
-                  outputS_str += " ";
-            }
       }
       return true;
 }
@@ -894,79 +1274,12 @@ bool Program::ParseVS(const std::vector<uint32_t>& spv) {
       }
 
 
-      for(uint32_t idx = 0; idx< resources.storage_buffers.size(); idx++) {
-            auto& resource = resources.storage_buffers[idx];
-            auto& struct_type = comp.get_type(resource.base_type_id);
-
-            uint32_t set = comp.get_decoration(resource.id, spv::DecorationDescriptorSet);
-            uint32_t binding = comp.get_decoration(resource.id, spv::Decoration::DecorationBinding);
-
-            std::string struct_buffer_resourece_name = comp.get_name(resource.id); // struct buffer resource name
-            std::string struct_type_name = comp.get_name(resource.base_type_id); // struct type name
-
-            uint32_t member_count = struct_type.member_types.size();
-            uint32_t struct_size = comp.get_declared_struct_size(struct_type); //struct size
-
-            auto str1 = std::format("StorageBuffer : Set: {}, Binding {}, resourece name {}, struct type name: {}, struct member: {}, struct_size: {}.",
-            set, binding, struct_buffer_resourece_name, struct_type_name, member_count, struct_size);
-            std::printf("%s\n", str1.c_str());
-
-            _structTable.emplace(struct_type_name, GraphicKernelStructInfo{idx, (uint32_t)struct_size}); // push to table
-            if(!_marcoParserIdentifierTable.contains(struct_type_name) || _marcoParserIdentifierTable[struct_type_name] != "STRUCTEXT") { // STRUCTEXT 才会反射成员变量.  only STRUCTEXT reflects member
-                  continue;
-            }
-
-            for (uint32_t i = 0; i < member_count; i++) {
-                  auto& member_type = comp.get_type(struct_type.member_types[i]);
-                  const std::string& member_type_name = comp.get_name(member_type.self); // struct member name
-
-                  size_t member_size = comp.get_declared_struct_member_size(struct_type, i); //struct member size
-                  size_t offset = comp.type_struct_member_offset(struct_type, i); //struct member offset
-
-                  const std::string& member_name = comp.get_member_name(struct_type.self, i);
-
-                  std::string full_member_name = std::format("{}.{}", struct_type_name, member_name);
-                  _structMemberTable.emplace(full_member_name, GraphicKernelStructMemberInfo{idx, (uint32_t)member_size, (uint32_t)offset});
-
-                  auto str = std::format("\t\tMember: {}, offset {}, size {}", member_name, offset, member_size);
-                  std::printf("%s\n", str.c_str());
-            }
-      }
-
-      // for (auto& resource : resources.sampled_images) {
-      //       auto& type = comp.get_type(resource.base_type_id);
-      //       uint32_t member_count = type.member_types.size();
-      //
-      //       uint32_t set = comp.get_decoration(resource.id, spv::DecorationDescriptorSet);
-      //       uint32_t binding = comp.get_decoration(resource.id, spv::Decoration::DecorationBinding);
-      //
-      //       const std::string& res_name = comp.get_name(resource.id);
-      //       auto str1 = std::format("SampledTexture: Set: {}, Binding {}, name {}.", set, binding, res_name);
-      //       std::printf("%s\n", str1.c_str());
-      // }
-
-      for (auto& resource : resources.push_constant_buffers) {
-            auto& type = comp.get_type(resource.base_type_id);
-            uint32_t member_count = type.member_types.size();
-            const std::string& res_name = comp.get_name(resource.id);
-
-            for (int i = 0; i < member_count; i++) {
-                  auto& member_type = comp.get_type(type.member_types[i]);
-                  const std::string& member_type_name = comp.get_name(member_type.self);
+      if (!ReflectStructBuffers(comp, resources, "Program::ParseVS")) return false;
 
-                  size_t member_size = comp.get_declared_struct_member_size(type, i);
-                  size_t offset = comp.type_struct_member_offset(type, i);
+      _pushConstantRange.offset = 0;
+      _pushConstantRange.size = ReflectPushConstantSize(comp, resources);
 
-                  const std::string& member_name = comp.get_member_name(type.self, i);
-                  auto str = std::format("PushConstants: {}, offset {}, size {}", member_name, offset, member_size);
-                  std::printf("%s\n", str.c_str());
-
-                  if (i == member_count - 1) {
-                        _pushConstantRange.offset = 0;
-                        _pushConstantRange.size = offset + member_size;
-                  }
-            }
-      }
+      FillResourceTables();
 
       return true;
 }
@@ -995,110 +1308,126 @@ bool Program::ParseFS(const std::vector<uint32_t>& spv) {
             return false;
       }
 
-      for (auto& resource : resources.push_constant_buffers) {
-            auto& type = comp.get_type(resource.base_type_id);
-            uint32_t member_count = type.member_types.size();
-            const std::string& res_name = comp.get_name(resource.id);
+      if (!resources.push_constant_buffers.empty()) {
+            const uint32_t ps_size = ReflectPushConstantSize(comp, resources);
+            if(ps_size != _pushConstantRange.size) {
+                  const auto err = std::format("Program::ParseFS - fs's struct not match with vs, please copy it from vs to fs, expected {}, got {}.", _pushConstantRange.size, ps_size);
+                  MessageManager::Log(MessageType::Warning, err);
+                  return false;
+            }
+      }
 
-            for (int i = 0; i < member_count; i++) {
-                  auto& member_type = comp.get_type(type.member_types[i]);
-                  const std::string& member_type_name = comp.get_name(member_type.self);
+      if (!ReflectStructBuffers(comp, resources, "Program::ParseFS")) return false;
 
-                  size_t member_size = comp.get_declared_struct_member_size(type, i);
-                  size_t offset = comp.type_struct_member_offset(type, i);
+      FillResourceTables();
 
-                  const std::string& member_name = comp.get_member_name(type.self, i);
-                  auto str = std::format("PushConstants: {}, offset {}, size {}", member_name, offset, member_size);
-                  std::printf("%s\n", str.c_str());
+      return true;
+}
 
-                  if (i == member_count - 1) {
-                        uint32_t ps_size = offset + member_size;
-                        if(ps_size != _pushConstantRange.size) {
-                              const auto err = std::format("Program::ParseFS - fs's struct not match with vs, please copy it from vs to fs, expected {}, got {}.", _pushConstantRange.size, ps_size);
-                              MessageManager::Log(MessageType::Warning, err);
-                              return false;
-                        }
-                  }
-            }
-      }
+bool Program::ParseCS(const std::vector<uint32_t>& spv) {
+      MessageManager::Log(MessageType::Normal, "Program::ParseCS - Parsing Compute Shader");
+      spirv_cross::Compiler comp(spv);
+      spirv_cross::ShaderResources resources = comp.get_shader_resources();
 
-      for(uint32_t idx = 0; idx< resources.storage_buffers.size(); idx++) {
-            auto& resource = resources.storage_buffers[idx];
-            auto& struct_type = comp.get_type(resource.base_type_id);
+      if (!ReflectStructBuffers(comp, resources, "Program::ParseCS")) return false;
 
-            uint32_t set = comp.get_decoration(resource.id, spv::DecorationDescriptorSet);
-            uint32_t binding = comp.get_decoration(resource.id, spv::Decoration::DecorationBinding);
+      _pushConstantRange.offset = 0;
+      _pushConstantRange.size = ReflectPushConstantSize(comp, resources);
 
-            std::string struct_buffer_resourece_name = comp.get_name(resource.id); // struct buffer resource name
-            std::string struct_type_name = comp.get_name(resource.base_type_id); // struct type name
+      FillResourceTables();
 
-            uint32_t member_count = struct_type.member_types.size();
-            uint32_t struct_size = comp.get_declared_struct_size(struct_type); //struct size
+      return true;
+}
+
+bool Program::ReflectStructBuffers(const spirv_cross::Compiler& comp, const spirv_cross::ShaderResources& resources, std::string_view parser_name) {
+      for (const auto& resource : resources.storage_buffers) {
+            const std::string struct_type_name = comp.get_name(resource.base_type_id);
 
-             auto str1 = std::format("StorageBuffer : Set: {}, Binding {}, resourece name {}, struct type name: {}, struct member: {}, struct_size: {}.",
-             set, binding, struct_buffer_resourece_name, struct_type_name, member_count, struct_size);
-             std::printf("%s\n", str1.c_str());
+            const auto identifier = std::ranges::find_if(_marcoParserIdentifier, [&](const auto& i) { return i.first == struct_type_name; });
+            if(identifier == _marcoParserIdentifier.end() || (identifier->second != "STRUCT" && identifier->second != "STRUCTEXT")) {
+                  continue; // BUFFER blocks are user memory, nothing to reflect
+            }
+            const auto struct_index = (uint32_t)std::distance(_marcoParserIdentifier.begin(), identifier); // slot in the push constant block
 
-            bool contained = false;
-            if(_structTable.contains(struct_type_name)) {
+            // block is { _NameData _data[]; }, the user struct is the runtime array element
+            const auto& block_type = comp.get_type(resource.base_type_id);
+            const auto& struct_type = comp.get_type(comp.get_type(block_type.member_types[0]).parent_type);
+            const uint32_t struct_stride = comp.type_struct_member_array_stride(block_type, 0);
+            const uint32_t member_count = struct_type.member_types.size();
+            const uint32_t struct_size = comp.get_declared_struct_size(struct_type);
+
+            const auto str = std::format("{} - Struct \"{}\", {} members, {} bytes.", parser_name, struct_type_name, member_count, struct_size);
+            MessageManager::Log(MessageType::Normal, str);
+
+            // a stage reflected earlier already added the struct, this one has to agree with it
+            const bool contained = _structTable.contains(struct_type_name);
+            if(contained) {
                   if(_structTable[struct_type_name].Size != struct_size) {
-                        const auto err = std::format("Program::ParseFS - struct \"{}\"'s size is not matching with exist, please check it.", struct_type_name);
+                        const auto err = std::format("{} - struct \"{}\"'s size is not matching with exist, please check it.", parser_name, struct_type_name);
                         MessageManager::Log(MessageType::Warning, err);
                         return false;
                   }
-                  contained = true;
             } else {
-                  _structTable.emplace(struct_type_name, GraphicKernelStructInfo{idx, (uint32_t)struct_size}); // push to table
+                  _structTable.emplace(struct_type_name, GraphicKernelStructInfo{struct_index, struct_size, struct_stride, GetReflectedTypeHash(comp, struct_type)});
             }
 
-            if(!_marcoParserIdentifierTable.contains(struct_type_name) || _marcoParserIdentifierTable[struct_type_name] != "STRUCTEXT") {
+            if(identifier->second != "STRUCTEXT") { // STRUCTEXT 才会反射成员变量.  only STRUCTEXT reflects member
                   continue;
             }
 
             for (uint32_t i = 0; i < member_count; i++) {
-                  auto& member_type = comp.get_type(struct_type.member_types[i]);
-                  const std::string& member_type_name = comp.get_name(member_type.self); // struct member name
-
-                  size_t member_size = comp.get_declared_struct_member_size(struct_type, i); //struct member size
-                  size_t member_offset = comp.type_struct_member_offset(struct_type, i); //struct member offset
-
+                  const auto& member_type = comp.get_type(struct_type.member_types[i]);
+                  const auto member_size = (uint32_t)comp.get_declared_struct_member_size(struct_type, i);
+                  const auto member_offset = (uint32_t)comp.type_struct_member_offset(struct_type, i);
                   const std::string& member_name = comp.get_member_name(struct_type.self, i);
+                  const std::string full_member_name = std::format("{}.{}", struct_type_name, member_name);
 
-                  std::string full_member_name = std::format("{}.{}", struct_type_name, member_name);
-                  if(contained) {
-                        if(_structMemberTable.contains(full_member_name)) {
-                              if(_structMemberTable[full_member_name].Size != member_size) {
-                                    const auto err = std::format("Program::ParseFS - struct \"{}\"'s member \"{}\"'s size is not matching with exist, please check it.", struct_type_name, member_name);
-                                    MessageManager::Log(MessageType::Warning, err);
-                                    return false;
-                              }
-                              if(_structMemberTable[full_member_name].Offset != member_offset) {
-                                    const auto err = std::format("Program::ParseFS - struct \"{}\"'s member \"{}\"'s offset is not matching with exist, please check it.", struct_type_name, member_name);
-                                    MessageManager::Log(MessageType::Warning, err);
-                                    return false;
-                              }
-                        } else {
-                              const auto err = std::format("Program::ParseFS - struct \"{}\"'s member \"{}\" is not exist in exist one, please check it.", struct_type_name, member_name);
-                              MessageManager::Log(MessageType::Warning, err);
-                              return false;
-                        }
-                  } else {
-                        _structMemberTable.emplace(full_member_name, GraphicKernelStructMemberInfo{idx, (uint32_t)member_size, (uint32_t)member_offset});
+                  if(!contained) {
+                        _structMemberTable.emplace(full_member_name, GraphicKernelStructMemberInfo{struct_index, member_size, member_offset, GetReflectedTypeHash(comp, member_type)});
+                        _structLayoutTable[struct_type_name].push_back(ShaderVariableRecord{member_name, member_offset, member_size, GetReflectedTypeName(comp, member_type)});
+                        continue;
                   }
 
-                  auto str = std::format("\t\tMember: {}, offset {}, size {}", member_name, member_offset, member_size);
-                  std::printf("%s\n", str.c_str());
+                  const auto finder = _structMemberTable.find(full_member_name);
+                  if(finder == _structMemberTable.end()) {
+                        const auto err = std::format("{} - struct \"{}\"'s member \"{}\" is not exist in exist one, please check it.", parser_name, struct_type_name, member_name);
+                        MessageManager::Log(MessageType::Warning, err);
+                        return false;
+                  }
+                  if(finder->second.Size != member_size || finder->second.Offset != member_offset) {
+                        const auto err = std::format("{} - struct \"{}\"'s member \"{}\"'s size or offset is not matching with exist, please check it.", parser_name, struct_type_name, member_name);
+                        MessageManager::Log(MessageType::Warning, err);
+                        return false;
+                  }
             }
+      }
 
+      return true;
+}
+
+uint32_t Program::ReflectPushConstantSize(const spirv_cross::Compiler& comp, const spirv_cross::ShaderResources& resources) {
+      uint32_t size = 0;
+      for (const auto& resource : resources.push_constant_buffers) {
+            const auto& type = comp.get_type(resource.base_type_id);
+            const uint32_t member_count = type.member_types.size();
+            if (member_count == 0) continue;
+
+            size = comp.type_struct_member_offset(type, member_count - 1) + (uint32_t)comp.get_declared_struct_member_size(type, member_count - 1);
       }
+      return size;
+}
 
-      for(int i = 0; i <  _marcoParserIdentifier.size(); i++) {
-            if(_marcoParserIdentifier[i].second == "TEXTURE") {
-                  _sampledTextureTable[_marcoParserIdentifier[i].first] = i;
+void Program::FillResourceTables() {
+      for(uint32_t i = 0; i < _marcoParserIdentifier.size(); i++) {
+            const auto& [name, marco] = _marcoParserIdentifier[i];
+            if(marco == "TEXTURE") {
+                  _sampledTextureTable[name] = i;
+            } else if(marco == "IMAGE") {
+                  _storageImageTable[name] = i;
+            } else if(marco == "BUFFER") {
+                  _storageBufferTable[name] = i;
             }
       }
-
-      return true;
 }
 
 bool Program::AnalyzeSetter(const std::pair<std::string, std::vector<std::string>>& setter, std::string& error_msg, glslang_stage_t shader_type) {
@@ -1157,6 +1486,19 @@ bool Program::AnalyzeSetter(const std::pair<std::string, std::vector<std::string
                         {"greater_or_equal", VK_COMPARE_OP_GREATER_OR_EQUAL},
                         {"always", VK_COMPARE_OP_ALWAYS},
                   }
+            },
+            {
+                  "dynamic_state", {
+                        {"true", VK_TRUE},
+                        {"false", VK_FALSE},
+                  }
+            },
+            {
+                  "optimize", {
+                        {"none", (uint64_t)ShaderOptimizeLevel::None},
+                        {"performance", (uint64_t)ShaderOptimizeLevel::Performance},
+                        {"size", (uint64_t)ShaderOptimizeLevel::Size},
+                  }
             }
       };
 
@@ -1174,7 +1516,10 @@ bool Program::AnalyzeSetter(const std::pair<std::string, std::vector<std::string
                         "depth_test",
                         "depth_bias",
                         "depth_bounds_test",
-                        "line_width"
+                        "line_width",
+                        "dynamic_state",
+                        "optimize",
+                        "keywords"
                   }
             },
 
@@ -1183,6 +1528,9 @@ bool Program::AnalyzeSetter(const std::pair<std::string, std::vector<std::string
                         "rt",
                         "ds",
                         "color_blend",
+                        "dynamic_state",
+                        "optimize",
+                        "keywords",
 
                         "depth_write",
                         "depth_test",
@@ -1190,6 +1538,13 @@ bool Program::AnalyzeSetter(const std::pair<std::string, std::vector<std::string
                         "depth_bounds_test",
                         "line_width"
                   }
+            },
+
+            {
+                  glslang_stage_t::GLSLANG_STAGE_COMPUTE, {
+                        "optimize",
+                        "keywords"
+                  }
             }
 
       };
@@ -1268,6 +1623,46 @@ bool Program::AnalyzeSetter(const std::pair<std::string, std::vector<std::string
       } else if (key == "depth_test") {
             _depthStencilStateCreateInfo.depthTestEnable = true;
             if (!Analyze(_depthStencilStateCreateInfo.depthCompareOp, key, values[0], error_msg)) return false;
+      } else if (key == "dynamic_state") {
+            VkBool32 enable = VK_FALSE;
+            if (!Analyze(enable, key, values[0], error_msg)) return false;
+            _dynamicState = enable;
+      } else if (key == "optimize") {
+            if (!Analyze(_optimizeLevel, key, values[0], error_msg)) return false;
+      } else if (key == "keywords") {
+            // "[FOG, SHADOWS]" arrives split at the spaces, joined again it only has to be split at the commas
+            std::string list{};
+            for (const auto& value : values) {
+                  list += value;
+            }
+
+            if (list.size() < 2 || list.front() != '[' || list.back() != ']') {
+                  error_msg = std::format("Invalid value \"{}\" for key \"{}\", expected a list like [FOG, SHADOWS].", list, key);
+                  return false;
+            }
+
+            std::string_view rest = std::string_view{list}.substr(1, list.size() - 2);
+            while (!rest.empty()) {
+                  const auto comma = rest.find(',');
+                  const auto keyword = rest.substr(0, comma);
+                  rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+                  const bool is_identifier = !keyword.empty() && !std::isdigit((unsigned char)keyword[0]) &&
+                  std::ranges::all_of(keyword, [](char c) { return std::isalnum((unsigned char)c) || c == '_'; });
+                  if (!is_identifier) {
+                        error_msg = std::format("Invalid keyword \"{}\" for key \"{}\", expected an identifier.", keyword, key);
+                        return false;
+                  }
+
+                  // every stage may list the same keyword, the first declaration keeps its bit
+                  if (std::ranges::find(_keywords, keyword) != _keywords.end()) continue;
+
+                  if (_keywords.size() == MaxKeywords) {
+                        error_msg = std::format("Too many keywords for key \"{}\", at most {}.", key, MaxKeywords);
+                        return false;
+                  }
+                  _keywords.emplace_back(keyword);
+            }
       } else if (key == "vs_location") {
             _autoVSInputStageBind = false;
             if (values.size() == 4) {
@@ -1592,3 +1987,516 @@ bool Program::AnalyzeSetter(const std::pair<std::string, std::vector<std::string
 
       return true;
 }
+
+uint64_t Program::ResolveVariantMask(const std::vector<std::string_view>& keywords) const {
+      uint64_t mask = 0;
+      for (const auto keyword : keywords) {
+            const auto finder = std::ranges::find(_keywords, keyword);
+            if (finder == _keywords.end()) {
+                  const auto err = std::format("Program::ResolveVariantMask - Program \"{}\" has no keyword \"{}\"", _programName, keyword);
+                  MessageManager::Log(MessageType::Error, err);
+                  throw std::runtime_error(err);
+            }
+            mask |= 1ull << std::distance(_keywords.begin(), finder);
+      }
+      return mask;
+}
+
+std::vector<uint32_t> Program::ResolveSpecConstants(const std::vector<std::pair<std::string, SpecConstantValue>>& constants) const {
+      std::vector<uint32_t> data(_specConstantTable.size());
+      for (const auto& [name, info] : _specConstantTable) {
+            data[info.ConstantId] = info.DefaultValue;
+      }
+
+      for (const auto& [name, value] : constants) {
+            const auto finder = _specConstantTable.find(name);
+            if (finder == _specConstantTable.end()) {
+                  const auto err = std::format("Program::ResolveSpecConstants - Program \"{}\" has no specialization constant \"{}\".", _programName, name);
+                  MessageManager::Log(MessageType::Error, err);
+                  throw std::runtime_error(err);
+            }
+
+            const auto type = finder->second.Type;
+            data[finder->second.ConstantId] = std::visit([type](auto v) -> uint32_t {
+                  switch (type) {
+                        case SpecConstantType::Bool: return v ? 1u : 0u;
+                        case SpecConstantType::Int: return std::bit_cast<uint32_t>((int32_t)v);
+                        case SpecConstantType::Uint: return (uint32_t)v;
+                        case SpecConstantType::Float: return std::bit_cast<uint32_t>((float)v);
+                  }
+                  return 0u;
+            }, value);
+      }
+
+      return data;
+}
+
+std::string Program::GenerateCppHeader(std::string_view name_space) const {
+      std::string out;
+      out += std::format("// Generated from program \"{}\" by LoFiShaderCodegen, do not edit.\n", _programName);
+      out += "#pragma once\n\n";
+      out += "#include <array>\n#include <cstddef>\n#include <cstdint>\n\n";
+      out += "#include \"GraphicKernelParameter.h\"\n\n"; // public, LoFiGfx/Include
+      out += std::format("namespace {} {{\n", name_space);
+
+      for (const auto& [struct_name, marco] : _marcoParserIdentifier) {
+            if (marco != "STRUCTEXT") continue;
+
+            const auto layout = _structLayoutTable.find(struct_name);
+            const auto info = _structTable.find(struct_name);
+            if (layout == _structLayoutTable.end() || info == _structTable.end()) continue; // declared but not used by any stage
+
+            // "Self" shares the handle struct with the members, "_pad" the layout struct
+            for (const auto& member : layout->second) {
+                  if (member.Name == "Self" || member.Name.starts_with("_pad")) {
+                        const auto err = std::format("Program::GenerateCppHeader - Member \"{}\" of STRUCTEXT \"{}\" collides with a generated name, \"Self\" and \"_pad*\" are reserved.",
+                        member.Name, struct_name);
+                        MessageManager::Log(MessageType::Error, err);
+                        throw std::runtime_error(err);
+                  }
+            }
+
+            const auto type_name = std::format("{}Struct", struct_name);
+
+            out += std::format("\n      struct {} {{\n", type_name);
+            uint32_t cursor = 0;
+            uint32_t pad_count = 0;
+            for (const auto& member : layout->second) {
+                  if (member.Offset > cursor) {
+                        out += std::format("            uint8_t _pad{}[{}];\n", pad_count++, member.Offset - cursor);
+                  }
+                  out += std::format("            {} {};\n", GetCppTypeName(member.TypeName, member.Size), member.Name);
+                  cursor = member.Offset + member.Size;
+            }
+            if (info->second.Size > cursor) {
+                  out += std::format("            uint8_t _pad{}[{}];\n", pad_count, info->second.Size - cursor);
+            }
+            out += "      };\n\n";
+
+            out += std::format("      static_assert(sizeof({}) == {});\n", type_name, info->second.Size);
+            for (const auto& member : layout->second) {
+                  out += std::format("      static_assert(offsetof({}, {}) == {});\n", type_name, member.Name, member.Offset);
+            }
+
+            out += std::format("\n      struct {}Param {{\n", struct_name);
+            out += std::format("            static constexpr ::LoFi::Component::GraphicKernelParameterHandle Self{{.StructIndex = {}, .Offset = 0, .Size = {}, .TypeHash = {:#x}ull}};\n",
+                  info->second.Index, info->second.Size, info->second.TypeHash);
+            for (const auto& member : layout->second) {
+                  const auto& member_info = _structMemberTable.at(std::format("{}.{}", struct_name, member.Name));
+                  out += std::format("            static constexpr ::LoFi::Component::GraphicKernelParameterHandle {}{{.StructIndex = {}, .Offset = {}, .Size = {}, .TypeHash = {:#x}ull}};\n",
+                        member.Name, member_info.StructIndex, member_info.Offset, member_info.Size, member_info.TypeHash);
+            }
+            out += "      };\n";
+      }
+
+      out += "}\n";
+      return out;
+}
+
+uint64_t Program::ComputeCacheKey(const std::vector<std::string_view>& sources, const std::vector<ShaderIncludeContext>& stage_includes, uint64_t variant_mask) {
+      XXH3_state_t state{};
+      XXH3_64bits_reset(&state);
+
+      // another glslang or spirv-cross can compile or reflect the same source differently, their versions are part of the key
+      const uint32_t options[] = {CacheFormatVersion, GLSLANG_TARGET_VULKAN_1_3, GLSLANG_TARGET_SPV_1_6, 460,
+            GLSLANG_VERSION_MAJOR, GLSLANG_VERSION_MINOR, GLSLANG_VERSION_PATCH,
+            SPVC_C_API_VERSION_MAJOR, SPVC_C_API_VERSION_MINOR, SPVC_C_API_VERSION_PATCH};
+      XXH3_64bits_update(&state, options, sizeof(options));
+      XXH3_64bits_update(&state, GLSLANG_VERSION_FLAVOR, sizeof(GLSLANG_VERSION_FLAVOR) - 1);
+      XXH3_64bits_update(&state, &variant_mask, sizeof(variant_mask));
+
+      for (const auto& source : sources) {
+            const uint64_t size = source.size();
+            XXH3_64bits_update(&state, &size, sizeof(size));
+            XXH3_64bits_update(&state, source.data(), source.size());
+      }
+
+      // the path is part of the key too, the same file found through another search path may expand differently
+      for (const auto& includes : stage_includes) {
+            const uint64_t count = includes.Files.size();
+            XXH3_64bits_update(&state, &count, sizeof(count));
+            for (const auto& file : includes.Files) {
+                  XXH3_64bits_update(&state, file->Path.data(), file->Path.size() + 1);
+                  XXH3_64bits_update(&state, &file->Hash, sizeof(file->Hash));
+            }
+      }
+
+      return XXH3_64bits_digest(&state);
+}
+
+const std::string& Program::GetStaticHeader() {
+      static const std::string header = [] {
+            std::string header = "";
+            header += "#extension GL_EXT_nonuniform_qualifier : enable\n";
+            header += "#define BindlessStorageBinding 0\n";
+            header += "#define BindlessSamplerBinding 1\n";
+            header += "#define BindlessStorageImageBinding 2\n";
+
+            header += "#define GetLayoutVariableName(Name) _bindless##Name\n";
+            // struct parameters are packed as (element << 16) | bindless index of the parameter page region
+            header += "#define GetVar(Name) GetLayoutVariableName(Name)[nonuniformEXT(_pushConstantBindlessIndexInfo.Name & 0xFFFFu)]._data[_pushConstantBindlessIndexInfo.Name >> 16]\n";
+
+            header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler1D _bindlessSamper1D[];\n";
+            header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler2D _bindlessSamper2D[];\n";
+            header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler3D _bindlessSamper3D[];\n";
+            header += "layout(set = 0, binding = BindlessSamplerBinding) uniform samplerCube _bindlessSamperCube[];\n";
+            header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler1DArray _bindlessSampler1DArray[];\n";
+            header += "layout(set = 0, binding = BindlessSamplerBinding) uniform sampler2DArray _bindlessSampler2DArray[];\n";
+            //header += "layout(set = 0, binding = BindlessSamplerBinding) uniform samplerCubeArray _bindlessSamplerCubeArray[];\n";
+
+            header += "#define GetTex1D(Name) _bindlessSamper1D[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            header += "#define GetTex2D(Name) _bindlessSamper2D[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            header += "#define GetTex3D(Name) _bindlessSamper3D[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            header += "#define GetTexCube(Name) _bindlessSamperCube[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            header += "#define GetTex1DArray(Name) _bindlessSampler1DArray[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            header += "#define GetTex2DArray(Name) _bindlessSampler2DArray[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            // header += "#define GetTexCubeArray(Name) _bindlessSamplerCubeArray[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+
+            // IMAGE and BUFFER parameters hold the plain bindless index of the bound texture or buffer
+            header += "#define GetImage(Name) GetLayoutVariableName(Name)[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            header += "#define GetBuffer(Name) GetLayoutVariableName(Name)[nonuniformEXT(uint(_pushConstantBindlessIndexInfo.Name))]\n";
+            return header;
+      }();
+      return header;
+}
+
+void Program::SaveToCache(const std::string& path, uint64_t key) const {
+      BinaryWriter writer{};
+      writer.Write(CacheMagic);
+      writer.Write(CacheFormatVersion);
+      writer.Write(key);
+
+      writer.Write((uint32_t)_shaderModules.size());
+      for (const auto& [stage, module] : _shaderModules) {
+            writer.Write((uint32_t)stage);
+            const auto hash = _stageCodeHashes.find(stage);
+            writer.Write(hash != _stageCodeHashes.end() ? hash->second : uint64_t{0}); // a hot reload of the loaded program reuses the stage
+            writer.WriteVector(module.first);
+      }
+
+      writer.Write((uint32_t)_structTable.size());
+      for (const auto& [name, info] : _structTable) {
+            writer.WriteString(name);
+            writer.Write(info);
+      }
+
+      writer.Write((uint32_t)_structMemberTable.size());
+      for (const auto& [name, info] : _structMemberTable) {
+            writer.WriteString(name);
+            writer.Write(info);
+      }
+
+      writer.Write((uint32_t)_structLayoutTable.size());
+      for (const auto& [name, members] : _structLayoutTable) {
+            writer.WriteString(name);
+            writer.Write((uint32_t)members.size());
+            for (const auto& member : members) {
+                  writer.WriteString(member.Name);
+                  writer.Write(member.Offset);
+                  writer.Write(member.Size);
+                  writer.WriteString(member.TypeName);
+            }
+      }
+
+      for (const auto* table : {&_sampledTextureTable, &_storageImageTable, &_storageBufferTable}) {
+            writer.Write((uint32_t)table->size());
+            for (const auto& [name, index] : *table) {
+                  writer.WriteString(name);
+                  writer.Write(index);
+            }
+      }
+
+      writer.Write(_inputAssemblyStateCreateInfo);
+      writer.Write(_rasterizationStateCreateInfo);
+      writer.Write(_depthStencilStateCreateInfo);
+      writer.Write(_colorBlendStateCreateInfo);
+      writer.Write(_renderingCreateInfo);
+      writer.Write(_pushConstantRange);
+      writer.WriteVector(_vertexInputAttributeDescription);
+      writer.WriteVector(_vertexInputBindingDescription);
+      writer.WriteVector(_colorBlendAttachmentState);
+      writer.WriteVector(_renderTargetFormat);
+      writer.Write(_dynamicState);
+      writer.Write((uint32_t)_optimizeLevel);
+
+      writer.Write((uint32_t)_specConstantTable.size());
+      for (const auto& [name, info] : _specConstantTable) {
+            writer.WriteString(name);
+            writer.Write(info);
+      }
+
+      writer.Write((uint32_t)_keywords.size());
+      for (const auto& keyword : _keywords) {
+            writer.WriteString(keyword);
+      }
+
+      // write next to the target and rename, a crashed write never leaves a half file under the real name
+      std::error_code ec{};
+      std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+      const auto temp_path = path + ".tmp";
+      {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                  const auto err = std::format("Program::SaveToCache - Failed to open \"{}\" for writing.", temp_path);
+                  MessageManager::Log(MessageType::Warning, err);
+                  return;
+            }
+            file.write((const char*)writer.GetData().data(), (std::streamsize)writer.GetData().size());
+      }
+
+      std::filesystem::rename(temp_path, path, ec);
+      if (ec) {
+            const auto err = std::format("Program::SaveToCache - Failed to write \"{}\", {}.", path, ec.message());
+            MessageManager::Log(MessageType::Warning, err);
+      }
+}
+
+bool Program::CompileFromCache(uint64_t key) {
+      if (Context::Get()->GetProgramCacheDirectory().empty()) return false;
+
+      _programName = std::format("{:016x}", key);
+      if (!LoadFromCache(GetCachePath(key), key)) return false;
+
+      _cacheKey = key;
+      _isCompiled = true;
+      return true;
+}
+
+std::string Program::GetCachePath(uint64_t key) {
+      return std::format("{}/{:016x}.lfpc", Context::Get()->GetProgramCacheDirectory(), key);
+}
+
+bool Program::LoadFromCache(const std::string& path, uint64_t key) {
+      std::ifstream file(path, std::ios::binary | std::ios::ate);
+      if (!file) return false;
+
+      std::vector<uint8_t> data((size_t)file.tellg());
+      file.seekg(0);
+      file.read((char*)data.data(), (std::streamsize)data.size());
+      if (!file) return false;
+
+      BinaryReader reader{data};
+
+      uint32_t magic = 0, version = 0;
+      uint64_t file_key = 0;
+      if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(file_key)) return false;
+      if (magic != CacheMagic || version != CacheFormatVersion || file_key != key) return false;
+
+      // read everything into locals first, a broken file leaves the program untouched and falls back to compiling
+      std::vector<std::pair<glslang_stage_t, std::vector<uint32_t>>> stages{};
+      entt::dense_map<glslang_stage_t, uint64_t> stage_code_hashes{};
+      entt::dense_map<std::string, GraphicKernelStructInfo> struct_table{};
+      entt::dense_map<std::string, GraphicKernelStructMemberInfo> struct_member_table{};
+      entt::dense_map<std::string, std::vector<ShaderVariableRecord>> struct_layout_table{};
+      entt::dense_map<std::string, uint32_t> sampled_texture_table{};
+      entt::dense_map<std::string, uint32_t> storage_image_table{};
+      entt::dense_map<std::string, uint32_t> storage_buffer_table{};
+
+      uint32_t count = 0;
+      if (!reader.Read(count)) return false;
+      for (uint32_t i = 0; i < count; i++) {
+            uint32_t stage = 0;
+            uint64_t code_hash = 0;
+            std::vector<uint32_t> spv{};
+            if (!reader.Read(stage) || !reader.Read(code_hash) || !reader.ReadVector(spv) || spv.empty()) return false;
+            if (code_hash != 0) stage_code_hashes[(glslang_stage_t)stage] = code_hash;
+            stages.emplace_back((glslang_stage_t)stage, std::move(spv));
+      }
+
+      if (!reader.Read(count)) return false;
+      for (uint32_t i = 0; i < count; i++) {
+            std::string name{};
+            GraphicKernelStructInfo info{};
+            if (!reader.ReadString(name) || !reader.Read(info)) return false;
+            struct_table.emplace(std::move(name), info);
+      }
+
+      if (!reader.Read(count)) return false;
+      for (uint32_t i = 0; i < count; i++) {
+            std::string name{};
+            GraphicKernelStructMemberInfo info{};
+            if (!reader.ReadString(name) || !reader.Read(info)) return false;
+            struct_member_table.emplace(std::move(name), info);
+      }
+
+      if (!reader.Read(count)) return false;
+      for (uint32_t i = 0; i < count; i++) {
+            std::string name{};
+            uint32_t member_count = 0;
+            if (!reader.ReadString(name) || !reader.Read(member_count)) return false;
+
+            std::vector<ShaderVariableRecord> members(member_count);
+            for (auto& member : members) {
+                  if (!reader.ReadString(member.Name) || !reader.Read(member.Offset) || !reader.Read(member.Size) || !reader.ReadString(member.TypeName)) return false;
+            }
+            struct_layout_table.emplace(std::move(name), std::move(members));
+      }
+
+      for (auto* table : {&sampled_texture_table, &storage_image_table, &storage_buffer_table}) {
+            if (!reader.Read(count)) return false;
+            for (uint32_t i = 0; i < count; i++) {
+                  std::string name{};
+                  uint32_t index = 0;
+                  if (!reader.ReadString(name) || !reader.Read(index)) return false;
+                  table->emplace(std::move(name), index);
+            }
+      }
+
+      VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+      VkPipelineRasterizationStateCreateInfo rasterization{};
+      VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+      VkPipelineColorBlendStateCreateInfo color_blend{};
+      VkPipelineRenderingCreateInfoKHR rendering{};
+      VkPushConstantRange push_constant_range{};
+      std::vector<VkVertexInputAttributeDescription> vertex_attributes{};
+      std::vector<VkVertexInputBindingDescription> vertex_bindings{};
+      std::vector<VkPipelineColorBlendAttachmentState> color_blend_attachments{};
+      std::vector<VkFormat> render_target_formats{};
+      bool dynamic_state = false;
+      uint32_t optimize_level = 0;
+
+      if (!reader.Read(input_assembly) || !reader.Read(rasterization) || !reader.Read(depth_stencil) || !reader.Read(color_blend) ||
+          !reader.Read(rendering) || !reader.Read(push_constant_range) || !reader.ReadVector(vertex_attributes) ||
+          !reader.ReadVector(vertex_bindings) || !reader.ReadVector(color_blend_attachments) || !reader.ReadVector(render_target_formats) ||
+          !reader.Read(dynamic_state) || !reader.Read(optimize_level) || optimize_level > (uint32_t)ShaderOptimizeLevel::Size) {
+            return false;
+      }
+
+      entt::dense_map<std::string, SpecConstantInfo> spec_constant_table{};
+      if (!reader.Read(count)) return false;
+      for (uint32_t i = 0; i < count; i++) {
+            std::string name{};
+            SpecConstantInfo info{};
+            if (!reader.ReadString(name) || !reader.Read(info)) return false;
+            spec_constant_table.emplace(std::move(name), info);
+      }
+
+      if (!reader.Read(count) || count > MaxKeywords) return false;
+
+      std::vector<std::string> keywords(count);
+      for (auto& keyword : keywords) {
+            if (!reader.ReadString(keyword)) return false;
+      }
+      if (!reader.IsEnd()) return false;
+
+      std::vector<std::pair<glslang_stage_t, VkShaderModule>> modules{};
+      for (const auto& [stage, spv] : stages) {
+            const VkShaderModuleCreateInfo shader_ci{
+                  .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                  .pNext = nullptr,
+                  .flags = 0,
+                  .codeSize = spv.size() * sizeof(uint32_t),
+                  .pCode = spv.data()
+            };
+
+            VkShaderModule shader_module{};
+            if (vkCreateShaderModule(volkGetLoadedDevice(), &shader_ci, nullptr, &shader_module) != VK_SUCCESS) {
+                  for (const auto& created : modules) {
+                        vkDestroyShaderModule(volkGetLoadedDevice(), created.second, nullptr);
+                  }
+                  return false;
+            }
+            modules.emplace_back(stage, shader_module);
+      }
+
+      for (uint32_t i = 0; i < stages.size(); i++) {
+            _shaderModules[stages[i].first] = std::make_pair(std::move(stages[i].second), modules[i].second);
+      }
+
+      _stageCodeHashes = std::move(stage_code_hashes);
+      _structTable = std::move(struct_table);
+      _structMemberTable = std::move(struct_member_table);
+      _structLayoutTable = std::move(struct_layout_table);
+      _sampledTextureTable = std::move(sampled_texture_table);
+      _storageImageTable = std::move(storage_image_table);
+      _storageBufferTable = std::move(storage_buffer_table);
+
+      _inputAssemblyStateCreateInfo = input_assembly;
+      _rasterizationStateCreateInfo = rasterization;
+      _depthStencilStateCreateInfo = depth_stencil;
+      _colorBlendStateCreateInfo = color_blend;
+      _renderingCreateInfo = rendering;
+      _pushConstantRange = push_constant_range;
+      _vertexInputAttributeDescription = std::move(vertex_attributes);
+      _vertexInputBindingDescription = std::move(vertex_bindings);
+      _colorBlendAttachmentState = std::move(color_blend_attachments);
+      _renderTargetFormat = std::move(render_target_formats);
+      _dynamicState = dynamic_state;
+      _optimizeLevel = (ShaderOptimizeLevel)optimize_level;
+      _specConstantTable = std::move(spec_constant_table);
+      _keywords = std::move(keywords);
+
+      RelinkPipelineState();
+      return true;
+}
+
+void Program::SeedReusableStages(const Program& previous) {
+      _reusableStages.clear();
+      for (const auto& [stage, hash] : previous._stageCodeHashes) {
+            if (const auto finder = previous._shaderModules.find(stage); finder != previous._shaderModules.end()) {
+                  _reusableStages[stage] = std::make_pair(hash, finder->second.first);
+            }
+      }
+}
+
+void Program::SwapCompiledState(Program& other) {
+      std::swap(_isCompiled, other._isCompiled);
+      std::swap(_cacheKey, other._cacheKey);
+      std::swap(_sampleTexture, other._sampleTexture);
+      std::swap(_shaderModules, other._shaderModules);
+      std::swap(_structTable, other._structTable);
+      std::swap(_sampledTextureTable, other._sampledTextureTable);
+      std::swap(_structMemberTable, other._structMemberTable);
+      std::swap(_storageImageTable, other._storageImageTable);
+      std::swap(_storageBufferTable, other._storageBufferTable);
+      std::swap(_structLayoutTable, other._structLayoutTable);
+      std::swap(_programName, other._programName);
+      std::swap(_marcoParserIdentifier, other._marcoParserIdentifier);
+      std::swap(_marcoParserIdentifierTable, other._marcoParserIdentifierTable);
+      std::swap(_specConstantTable, other._specConstantTable);
+      std::swap(_keywords, other._keywords);
+      std::swap(_variantSources, other._variantSources);
+      std::swap(_includedFiles, other._includedFiles);
+      std::swap(_stageCodeHashes, other._stageCodeHashes);
+      std::swap(_reusableStages, other._reusableStages);
+
+      std::swap(_inputAssemblyStateCreateInfo, other._inputAssemblyStateCreateInfo);
+      std::swap(_rasterizationStateCreateInfo, other._rasterizationStateCreateInfo);
+      std::swap(_vertexInputStateCreateInfo, other._vertexInputStateCreateInfo);
+      std::swap(_depthStencilStateCreateInfo, other._depthStencilStateCreateInfo);
+      std::swap(_vertexInputAttributeDescription, other._vertexInputAttributeDescription);
+      std::swap(_vertexInputBindingDescription, other._vertexInputBindingDescription);
+      std::swap(_colorBlendStateCreateInfo, other._colorBlendStateCreateInfo);
+      std::swap(_colorBlendAttachmentState, other._colorBlendAttachmentState);
+      std::swap(_renderingCreateInfo, other._renderingCreateInfo);
+      std::swap(_renderTargetFormat, other._renderTargetFormat);
+      std::swap(_pushConstantRange, other._pushConstantRange);
+      std::swap(_dynamicState, other._dynamicState);
+      std::swap(_optimizeLevel, other._optimizeLevel);
+      std::swap(_autoVSInputStageBind, other._autoVSInputStageBind);
+      std::swap(_autoVSInputBindRateTable, other._autoVSInputBindRateTable);
+
+      RelinkPipelineState();
+      other.RelinkPipelineState();
+}
+
+void Program::RelinkPipelineState() {
+      _inputAssemblyStateCreateInfo.pNext = nullptr;
+      _rasterizationStateCreateInfo.pNext = nullptr;
+      _depthStencilStateCreateInfo.pNext = nullptr;
+
+      _vertexInputStateCreateInfo.pNext = nullptr;
+      _vertexInputStateCreateInfo.vertexAttributeDescriptionCount = _vertexInputAttributeDescription.size();
+      _vertexInputStateCreateInfo.pVertexAttributeDescriptions = _vertexInputAttributeDescription.data();
+      _vertexInputStateCreateInfo.vertexBindingDescriptionCount = _vertexInputBindingDescription.size();
+      _vertexInputStateCreateInfo.pVertexBindingDescriptions = _vertexInputBindingDescription.data();
+
+      _colorBlendStateCreateInfo.pNext = nullptr;
+      _colorBlendStateCreateInfo.attachmentCount = _colorBlendAttachmentState.size();
+      _colorBlendStateCreateInfo.pAttachments = _colorBlendAttachmentState.data();
+
+      _renderingCreateInfo.pNext = nullptr;
+      _renderingCreateInfo.colorAttachmentCount = _renderTargetFormat.size();
+      _renderingCreateInfo.pColorAttachmentFormats = _renderTargetFormat.data();
+}
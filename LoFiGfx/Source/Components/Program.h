@@ -1,18 +1,60 @@
 ﻿#pragma once
 
 #include "../Helper.h"
+#include "../ThreadPool.h"
+#include "../ShaderLexer.h"
+#include "../ShaderFileSystem.h"
 #include "GraphicKernel.h"
 #include "ComputeKernel.h"
 
 #include "glslang/Include/glslang_c_interface.h"
 
+namespace spirv_cross {
+      class Compiler;
+      struct ShaderResources;
+}
+
 namespace LoFi::Component {
       class GraphicKernel;
 
+      // present while the program compiles on the thread pool
+      struct PendingProgram {
+            std::shared_ptr<Internal::AsyncJob> Job{};
+            bool Failed = false;
+      };
+
       struct ShaderVariableRecord {
             std::string Name;
             uint32_t Offset;
             uint32_t Size;
+            std::string TypeName; // reflected layout name, e.g. "float", "float1x3", "float4x4[2]"
+      };
+
+      using SpecConstantValue = std::variant<int32_t, uint32_t, float, bool>;
+
+      // #set optimize = none | performance | size, spirv-opt recipe (RegisterPerformancePasses / RegisterSizePasses) run on
+      // the SPIR-V glslang generated with its own optimizer disabled
+      enum class ShaderOptimizeLevel : uint32_t {
+            None,
+            Performance,
+            Size
+      };
+
+      // ParseMarco's state for one stage while it walks the #include graph
+      struct ShaderIncludeContext {
+            std::vector<std::pair<uint32_t, std::string_view>> SetterLines{};
+            entt::dense_set<std::string> IncludedFiles{}; // a file expands once per stage, like "#pragma once"
+            std::vector<std::shared_ptr<const Internal::ShaderFile>> Files{}; // expansion order, also keeps the setter views alive
+            entt::dense_set<std::string> Defines{}; // "#define"d names, conditionals on them are judged by ParseMarco
+            std::string CurrentFile{}; // empty in the root source
+            uint32_t Depth = 0;
+      };
+
+      // one combination of "#set keywords", created the first time a kernel asks for it
+      struct ProgramVariant {
+            entt::entity VariantProgram = entt::null; // compiled with the keyword defines, null for mask 0 which is the program itself
+            entt::entity Kernel = entt::null;
+            uint32_t Requests = 0;
       };
 
       struct ProgramCompilerGroup {
@@ -42,25 +84,78 @@ namespace LoFi::Component {
 
             explicit Program(entt::entity id);
 
-            [[nodiscard]] bool CompileFromSourceCode(std::string_view name, const std::vector<std::string_view>& sources);
+            // bit i of variant_mask defines the i-th "#set keywords" entry as 1 before the user code
+            [[nodiscard]] bool CompileFromSourceCode(std::string_view name, const std::vector<std::string_view>& sources, uint64_t variant_mask = 0);
+
+            // loads a program that an earlier session left in the disk cache, used to replay the pipeline manifest
+            [[nodiscard]] bool CompileFromCache(uint64_t key);
 
             [[nodiscard]] bool IsCompiled() const { return _isCompiled; }
 
+            [[nodiscard]] uint64_t GetCacheKey() const { return _cacheKey; } // 0 when the disk cache is disabled
+
+            [[nodiscard]] static std::string GetCachePath(uint64_t key);
+
             [[nodiscard]] const auto& GetStructTable() const {return _structTable;}
 
             [[nodiscard]] const auto& GetSampledTextureTable() const {return _sampledTextureTable;}
 
             [[nodiscard]] const auto& GetStructMemberTable() const {return _structMemberTable;}
 
-            // TODO: LoadFromCache
+            [[nodiscard]] const auto& GetStorageImageTable() const {return _storageImageTable;}
+
+            [[nodiscard]] const auto& GetStorageBufferTable() const {return _storageBufferTable;}
+
+            [[nodiscard]] const auto& GetSpecConstantTable() const {return _specConstantTable;}
+
+            [[nodiscard]] const auto& GetKeywords() const {return _keywords;}
+
+            [[nodiscard]] const auto& GetVariants() const {return _variants;}
+
+            // throws on a name that isn't one of the program's keywords
+            [[nodiscard]] uint64_t ResolveVariantMask(const std::vector<std::string_view>& keywords) const;
+
+            // 4 bytes per constant id, defaults overridden by the given values converted to the declared types
+            [[nodiscard]] std::vector<uint32_t> ResolveSpecConstants(const std::vector<std::pair<std::string, SpecConstantValue>>& constants) const;
+
+            // std430 c++ mirrors of every STRUCTEXT with static_assert'ed offsets and constexpr parameter handles, throws for a
+            // member named like a generated one ("Self", "_pad*")
+            [[nodiscard]] std::string GenerateCppHeader(std::string_view name_space) const;
+
+            // the marco pass CompileFromSourceCode runs on each stage before glslang, on its own for tools and benchmarks,
+            // marcos it meets are added to this program's tables
+            [[nodiscard]] bool PreprocessStage(const std::vector<Internal::ShaderToken>& tokens, glslang_stage_t shader_type, std::string& output_codes, std::string& error_message);
 
       private:
-            static bool CompileFromCode(const char* source, glslang_stage_t shader_type, std::vector<uint32_t>& spv, std::string& err_msg);
+            static constexpr uint32_t CacheMagic = 0x4350464C; // "LFPC"
+
+            static constexpr uint32_t CacheFormatVersion = 8; // bump when the file layout, the generated header or compile options change
+
+            static constexpr uint32_t MaxIncludeDepth = 32;
+
+            static constexpr uint32_t MaxKeywords = 64; // bits of a variant mask
+
+            // the root sources and the content hash of every included file, the expanded code never has to be rehashed
+            static uint64_t ComputeCacheKey(const std::vector<std::string_view>& sources, const std::vector<ShaderIncludeContext>& stage_includes, uint64_t variant_mask);
+
+            // bindless layouts and accessor marcos shared by every program, only the push constant block is generated per program
+            static const std::string& GetStaticHeader();
+
+            bool LoadFromCache(const std::string& path, uint64_t key);
 
-            bool ParseMarco(std::string_view input_code, std::string& output_codes, std::string& error_message, glslang_stage_t shader_type);
+            void SaveToCache(const std::string& path, uint64_t key) const;
 
-            bool ParseSetters(std::string_view codes, entt::dense_map<std::string, std::vector<std::string>>& _setters, std::string& output_codes, std::string& error_message,
-            glslang_stage_t shader_type);
+            void RelinkPipelineState();
+
+            static bool CompileFromCode(const char* source, glslang_stage_t shader_type, ShaderOptimizeLevel optimize_level, std::vector<uint32_t>& spv, std::string& err_msg);
+
+            // expands the marcos and "#include" files, renames the stage's entry point to main and comments out "#set" lines,
+            // which are collected as (line, text) for ParseSetters, the views point into the tokenized sources, marcos and
+            // setters inside a conditional block a keyword or "#define" disables are skipped
+            bool ParseMarco(const std::vector<Internal::ShaderToken>& tokens, glslang_stage_t shader_type, std::string& output_codes,
+            ShaderIncludeContext& include_context, std::string& error_message);
+
+            bool ParseSetters(const std::vector<std::pair<uint32_t, std::string_view>>& setter_lines, std::string& error_message, glslang_stage_t shader_type);
 
             bool VaildateSetter(std::string_view key, std::string_view value);
 
@@ -68,10 +163,30 @@ namespace LoFi::Component {
 
             bool ParseFS(const std::vector<uint32_t>& spv);
 
+            bool ParseCS(const std::vector<uint32_t>& spv);
+
+            // STRUCT and STRUCTEXT storage buffers of one stage into the struct tables, a struct an earlier stage already
+            // reflected has to match it, parser_name prefixes the messages
+            bool ReflectStructBuffers(const spirv_cross::Compiler& comp, const spirv_cross::ShaderResources& resources, std::string_view parser_name);
+
+            // bytes of the stage's push constant block, 0 without one
+            static uint32_t ReflectPushConstantSize(const spirv_cross::Compiler& comp, const spirv_cross::ShaderResources& resources);
+
+            // parameter slots of the TEXTURE, IMAGE and BUFFER marcos
+            void FillResourceTables();
+
+            // a rebuild reuses the SPIR-V of every stage whose final code hashes the same as in the given program
+            void SeedReusableStages(const Program& previous);
+
+            // exchanges everything compiled, the entity and its variants stay, both sides are relinked
+            void SwapCompiledState(Program& other);
+
             friend class GraphicKernel;
 
             friend class ComputeKernel;
 
+            friend class ::LoFi::Context;
+
       private:
             bool AnalyzeSetter(const std::pair<std::string, std::vector<std::string>>& setter, std::string& error_msg, glslang_stage_t shader_type);
 
@@ -81,6 +196,8 @@ namespace LoFi::Component {
 
             bool _isCompiled{};
 
+            uint64_t _cacheKey{};
+
             std::vector<std::string> _sampleTexture{};
 
             entt::dense_map<glslang_stage_t, std::pair<std::vector<uint32_t>, VkShaderModule>> _shaderModules{};
@@ -91,6 +208,12 @@ namespace LoFi::Component {
 
             entt::dense_map<std::string, GraphicKernelStructMemberInfo> _structMemberTable{};
 
+            entt::dense_map<std::string, uint32_t> _storageImageTable{}; // IMAGE, compute only
+
+            entt::dense_map<std::string, uint32_t> _storageBufferTable{}; // BUFFER, compute only
+
+            entt::dense_map<std::string, std::vector<ShaderVariableRecord>> _structLayoutTable{}; // STRUCTEXT members in declaration order
+
             entt::entity _id{};
 
             std::string _programName{};
@@ -99,6 +222,24 @@ namespace LoFi::Component {
 
             entt::dense_map<std::string, std::string> _marcoParserIdentifierTable{};
 
+            entt::dense_map<std::string, SpecConstantInfo> _specConstantTable{}; // SPECCONST, constant ids in declaration order
+
+            std::vector<std::string> _keywords{}; // "#set keywords", bit order of the variant masks
+
+            std::vector<std::string> _parsedKeywords{}; // the same list as ParseMarco meets it, before the setters run
+
+            uint64_t _parsedVariantMask = 0; // keywords ParseMarco treats as defined
+
+            std::vector<std::string> _variantSources{}; // kept by a base program with keywords, its variants compile from them
+
+            entt::dense_map<uint64_t, ProgramVariant> _variants{}; // by mask, touched on the main thread only
+
+            std::vector<std::shared_ptr<const Internal::ShaderFile>> _includedFiles{}; // every stage's includes of the last compile
+
+            entt::dense_map<glslang_stage_t, uint64_t> _stageCodeHashes{}; // final code and optimize level of each compiled stage
+
+            entt::dense_map<glslang_stage_t, std::pair<uint64_t, std::vector<uint32_t>>> _reusableStages{}; // SeedReusableStages, consumed by the next compile
+
       private:
             VkPipelineInputAssemblyStateCreateInfo _inputAssemblyStateCreateInfo{};
 
@@ -122,7 +263,19 @@ namespace LoFi::Component {
 
             VkPushConstantRange _pushConstantRange{};
 
+            bool _dynamicState = false; // #set dynamic_state = true, the values above only seed the kernel's defaults
+
+            ShaderOptimizeLevel _optimizeLevel = ShaderOptimizeLevel::None; // program wide, the last stage setting it wins
+
             bool _autoVSInputStageBind = true;
             entt::dense_map<uint32_t, VkVertexInputRate> _autoVSInputBindRateTable{};
       };
+
+      // on programs made by CreateProgramFromFiles, polled by the context while hot reload is enabled
+      struct ProgramHotReload {
+            std::vector<std::string> Paths{};
+            std::vector<std::shared_ptr<const Internal::ShaderFile>> Files{}; // the roots, then every include, as last seen
+            std::shared_ptr<Internal::AsyncJob> Job{}; // a rebuild in flight
+            std::vector<std::pair<entt::entity, std::unique_ptr<Program>>> Rebuilt{}; // the program and its variants, written by Job only
+      };
 }
@@ -1,6 +1,7 @@
 #include "Swapchain.h"
 #include "Window.h"
 #include "../Message.h"
+#include "../Context.h"
 #include "SDL3/SDL_vulkan.h"
 
 using namespace LoFi::Component;
@@ -66,7 +67,8 @@ void Swapchain::BeginFrame(VkCommandBuffer cmd) {
       auto current_layout = render_traget->GetCurrentLayout();
       if (_mappedRenderTarget == entt::null) {
             if (current_layout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
-                  render_traget->BarrierLayout(cmd, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+                  // a fresh image comes from undefined, the source stage still has to chain onto the acquire semaphore wait
+                  render_traget->BarrierLayout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, std::nullopt, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
             }
       }
 }
@@ -105,21 +107,23 @@ void Swapchain::MapRenderTarget(VkCommandBuffer cmd) {
                         .dstOffsets = {zero, dst}
                   };
 
-                  tex->BarrierLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, std::nullopt, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_2_BLIT_BIT);
-                  current_rt->BarrierLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, std::nullopt, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT);
+                  // the mapped target is tracked, it stays in the transfer layout until its next use moves it
+                  auto ctx = Context::Get();
+                  ctx->TrackTextureAccess(*tex, tex->GetSubresourceRange(0, 1, 0, 1), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+                  current_rt->BarrierLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, std::nullopt, std::nullopt, VK_PIPELINE_STAGE_2_BLIT_BIT);
+                  ctx->FlushBarriers(cmd);
 
                   vkCmdBlitImage(cmd, tex->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, current_rt->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
 
-                  tex->BarrierLayout(cmd, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, std::nullopt, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
-                  current_rt->BarrierLayout(cmd, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, std::nullopt, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT);
+                  current_rt->BarrierLayout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
             } else {
                   if (current_rt->GetCurrentLayout() != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
-                        current_rt->BarrierLayout(cmd, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, std::nullopt, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+                        current_rt->BarrierLayout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
                   }
             }
       } else {
             if (current_rt->GetCurrentLayout() != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
-                  current_rt->BarrierLayout(cmd, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, std::nullopt, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+                  current_rt->BarrierLayout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
             }
       }
 }
@@ -18,7 +18,7 @@ Texture::Texture(const VkImageCreateInfo& image_ci, VkImage Image, bool isBorrow
       _image = Image;
       _imageCI = std::make_unique<VkImageCreateInfo>(image_ci);
 
-      _currentLayout = _imageCI->initialLayout;
+      _subresourceStates.Init(image_ci.mipLevels, image_ci.arrayLayers, image_ci.initialLayout);
 }
 
 Texture::Texture(entt::entity id, const VkImageCreateInfo& image_ci, const VmaAllocationCreateInfo& alloc_ci) {
@@ -38,7 +38,7 @@ Texture::Texture(entt::entity id, const VkImageCreateInfo& image_ci, const VmaAl
             throw std::runtime_error(msg);
       }
       _id = id;
-      _currentLayout = _imageCI->initialLayout;
+      _subresourceStates.Init(image_ci.mipLevels, image_ci.arrayLayers, image_ci.initialLayout);
 }
 
 VkImageView Texture::CreateView(VkImageViewCreateInfo view_ci) {
@@ -65,171 +65,119 @@ void Texture::ClearViews() {
 }
 
 void Texture::SetData(const void* data, size_t size) {
-      VmaAllocationInfo info{};
-      vmaGetAllocationInfo(volkGetLoadedVmaAllocator(), _memory, &info);
+      if (!SetLevelData(0, data, size)) return;
 
-      if (info.size < size) {
-            auto str = std::format(R"(Texture::SetData - Size Mismatch, Expected: {} {}, Actual: {})", info.size, size);
+      // compressed formats can't be blitted, their levels come with the data
+      if (!IsBlockCompressedFormat(_imageCI->format)) {
+            LoFi::Context::Get()->EnqueueCommand([this](VkCommandBuffer cmd) {
+                  LoFi::Context::Get()->RecordGenerateMipmaps(cmd, *this);
+            });
+      }
+}
+
+bool Texture::SetLevelData(uint32_t mip, const void* data, size_t size) {
+      if (mip >= _imageCI->mipLevels) {
+            auto str = std::format(R"(Texture::SetLevelData - Invalid mip level {}, the texture has {} levels)", mip, _imageCI->mipLevels);
             MessageManager::Log(MessageType::Error, str);
-            return;
+            return false;
       }
 
-      if (_intermediateBuffer == nullptr) {
-            // create a upload buffer
-
-            auto str = std::format(R"(Texture::SetData - Try UpLoad To device texture, using Intermediate Buffer)");
-            MessageManager::Log(MessageType::Normal, str);
-
-            _intermediateBuffer = std::make_unique<Buffer>(VkBufferCreateInfo{
-                  .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                  .pNext = nullptr,
-                  .flags = 0,
-                  .size = info.size,
-                  .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                  .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                  .queueFamilyIndexCount = 0,
-                  .pQueueFamilyIndices = nullptr
-            }, VmaAllocationCreateInfo{
-                  .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
-                  .requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            });
+      const uint32_t w = std::max(_imageCI->extent.width >> mip, 1u);
+      const uint32_t h = std::max(_imageCI->extent.height >> mip, 1u);
+      const VkDeviceSize level_size = GetFormatLevelSize(_imageCI->format, w, h);
+
+      if (level_size == 0) {
+            auto str = std::format(R"(Texture::SetLevelData - Format {} has no known texel or block size)", GetVkFormatString(_imageCI->format));
+            MessageManager::Log(MessageType::Error, str);
+            return false;
       }
 
-      _intermediateBuffer->SetData(data, size);
+      if (size < level_size) {
+            auto str = std::format(R"(Texture::SetLevelData - Size Mismatch, Expected: {}, Actual: {})", level_size, size);
+            MessageManager::Log(MessageType::Error, str);
+            return false;
+      }
 
-      auto imm_buffer = _intermediateBuffer->GetBuffer();
-      auto trans_size = size;
+      // bufferOffset must be a multiple of the texel or block size and of 4
+      const VkDeviceSize alignment = std::lcm<VkDeviceSize>(std::max(GetFormatBlockSize(_imageCI->format), 1u), 4);
+      const auto staging = Context::Get()->UploadToStaging(data, level_size, alignment);
 
+      auto imm_buffer = staging.Buffer;
+
+      // a level that isn't a whole number of blocks is still copied with its own extent
       VkBufferImageCopy buffer_copyto_image{
-            .bufferOffset = 0,
+            .bufferOffset = staging.Offset,
             .bufferRowLength = 0,
             .bufferImageHeight = 0,
             .imageSubresource = {
                   .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                  .mipLevel = 0,
+                  .mipLevel = mip,
                   .baseArrayLayer = 0,
                   .layerCount = 1
             },
             .imageOffset = {},
             .imageExtent = {
-                  .width = _imageCI->extent.width,
-                  .height = _imageCI->extent.height,
+                  .width = w,
+                  .height = h,
                   .depth = 1
             }
       };
 
+      // the level belongs to the image of this call, a texture reallocated before the copy runs no longer has it
+      const VkImage image = _image;
+
       LoFi::Context::Get()->EnqueueCommand([=, this](VkCommandBuffer cmd) {
-            this->BarrierLayout(cmd, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-            vkCmdCopyBufferToImage(cmd, imm_buffer, _image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_copyto_image);
+            if (_image != image) return;
+
+            auto ctx = LoFi::Context::Get();
+            ctx->TrackTextureAccess(*this, GetSubresourceRange(mip, 1, 0, 1), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, true);
+            ctx->FlushBarriers(cmd);
+            vkCmdCopyBufferToImage(cmd, imm_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &buffer_copyto_image);
       });
+
+      return true;
 }
 
-void Texture::BarrierLayout(VkCommandBuffer cmd, VkImageLayout new_layout, std::optional<VkImageLayout> src_layout,
+void Texture::BarrierLayout(VkImageLayout new_layout, std::optional<VkImageSubresourceRange> range,
 std::optional<VkPipelineStageFlags2> src_stage, std::optional<VkPipelineStageFlags2> dst_stage) {
-      auto& old_layout = _currentLayout;
-
-      if (old_layout == new_layout) return;
-
-      VkImageMemoryBarrier2 barrier{};
-      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
-      barrier.image = _image;
-      barrier.subresourceRange = {
-            .aspectMask = _viewCIs.at(0).subresourceRange.aspectMask,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1
-      };
-
-      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-      barrier.oldLayout = _currentLayout;
-      barrier.newLayout = new_layout;
-
-      barrier.srcStageMask = src_stage.value_or(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
-      barrier.dstStageMask = dst_stage.value_or(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
-
-      barrier.srcAccessMask = 0;
-      barrier.dstAccessMask = 0;
-
-      if (src_layout.has_value()) {
-            old_layout = src_layout.value();
-      }
-
-      switch (old_layout) {
-            case VK_IMAGE_LAYOUT_UNDEFINED:
-            case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-                  barrier.srcAccessMask = 0;
-                  break;
-
-            case VK_IMAGE_LAYOUT_PREINITIALIZED:
-                  barrier.srcAccessMask = VK_ACCESS_2_HOST_WRITE_BIT;
-                  break;
+      auto& batcher = Context::Get()->_barrierBatcher;
+      const auto dst = GetImageLayoutAccess(new_layout);
+      const auto dst_stages = dst_stage.value_or(dst.Stage);
 
-            case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-                  barrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-                  break;
+      _subresourceStates.Update(range.value_or(GetSubresourceRange()), [&](const VkImageSubresourceRange& part, SubresourceState& state) {
+            if (state.Layout == new_layout) return;
 
-            case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            case VK_IMAGE_LAYOUT_STENCIL_ATTACHMENT_OPTIMAL:
-            case VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL:
-                  barrier.srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-                  break;
+            // both sides come from the layout pair, the source also waits for whatever the tracked state saw last
+            const auto src = GetImageLayoutAccess(state.Layout);
+            const auto src_stages = src_stage.value_or(src.Stage | state.Access.WriteStage | state.Access.ReadStages);
+            batcher.Transition(_image, part, state.Layout, new_layout, src_stages, src.WriteAccess | state.Access.WriteAccess, dst_stages, dst.Access);
 
-            case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-                  barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-                  break;
-
-            case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-                  barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-                  break;
-
-            case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-                  barrier.srcAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
-                  break;
-
-            default: break;
-      }
-
-      switch (new_layout) {
-            case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-                  barrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-                  break;
-            case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            case VK_IMAGE_LAYOUT_STENCIL_ATTACHMENT_OPTIMAL:
-            case VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL:
-                  barrier.dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-                  break;
-            case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-                  barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
-                  break;
-            case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-                  barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-                  break;
-            case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-                  if (barrier.srcAccessMask == 0) {
-                        barrier.srcAccessMask = VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
-                  }
-                  barrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
-                  break;
-            case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
-                  barrier.dstAccessMask = 0;
-                  break;
-            default: break;
-      }
-
-      old_layout = barrier.newLayout;
+            // later tracked accesses chain onto dst_stage
+            state.Layout = new_layout;
+            state.Access = {.WriteStage = dst_stages, .ReadStages = dst_stages, .VisibleStages = dst_stages, .VisibleAccess = dst.Access};
+      });
+}
 
-      const VkDependencyInfo info{
-            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-            .imageMemoryBarrierCount = 1,
-            .pImageMemoryBarriers = &barrier
-      };
+VkImageAspectFlags Texture::GetAspect() const {
+      if (IsDepthStencilOnlyFormat(_imageCI->format)) return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+      if (IsDepthOnlyFormat(_imageCI->format)) return VK_IMAGE_ASPECT_DEPTH_BIT;
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+}
 
-      vkCmdPipelineBarrier2(cmd, &info);
+VkImageSubresourceRange Texture::GetSubresourceRange(uint32_t base_mip, uint32_t mip_count, uint32_t base_layer, uint32_t layer_count) const {
+      return _subresourceStates.Resolve(VkImageSubresourceRange{
+            .aspectMask = GetAspect(),
+            .baseMipLevel = base_mip,
+            .levelCount = mip_count,
+            .baseArrayLayer = base_layer,
+            .layerCount = layer_count
+      });
 }
 
+VkImageSubresourceRange Texture::GetViewSubresourceRange(uint32_t idx) const {
+      const auto& range = _viewCIs.at(idx).subresourceRange;
+      return GetSubresourceRange(range.baseMipLevel, range.levelCount, range.baseArrayLayer, range.layerCount);
+}
 
 void Texture::ReleaseAllViews() const {
       for (const auto view : _views) {
@@ -244,28 +192,46 @@ void Texture::ReleaseAllViews() const {
 void Texture::Clean() {
       ClearViews();
 
-      _currentLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      _subresourceStates.Init(_imageCI->mipLevels, _imageCI->arrayLayers, VK_IMAGE_LAYOUT_UNDEFINED);
 
       if (!_isBorrow) {
             DestroyTexture();
       }
 }
 
-void Texture::SetBindlessIndexForSampler(std::optional<uint32_t> index) {
+void Texture::SetBindlessIndexForSampler(std::optional<uint32_t> index, uint32_t view_index) {
       _bindlessIndexForSampler = index;
+      _viewIndexForSampler = view_index;
 }
 
-void Texture::SetBindlessIndexForComputeKernel(std::optional<uint32_t> index) {
+void Texture::SetBindlessIndexForComputeKernel(std::optional<uint32_t> index, uint32_t view_index) {
       _bindlessIndexForComputeKernel = index;
+      _viewIndexForComputeKernel = view_index;
+}
+
+void Texture::Reallocate(const VkImageCreateInfo& image_ci, const VmaAllocationCreateInfo& alloc_ci) {
+      ClearViews();
+      DestroyTexture();
+      _bindlessIndexForSampler = std::nullopt;
+      _bindlessIndexForComputeKernel = std::nullopt;
+
+      _imageCI = std::make_unique<VkImageCreateInfo>(image_ci);
+      if (vmaCreateImage(volkGetLoadedVmaAllocator(), &image_ci, &alloc_ci, &_image, &_memory, nullptr) != VK_SUCCESS) {
+            const std::string msg = "Texture::Reallocate - Failed to create image";
+            MessageManager::Log(MessageType::Error, msg);
+            throw std::runtime_error(msg);
+      }
+      _subresourceStates.Init(image_ci.mipLevels, image_ci.arrayLayers, image_ci.initialLayout);
 }
 
 void Texture::DestroyTexture() {
+      // the context frees Resource3 to the sampler index list and Resource4 to the compute kernel one
       ContextResourceRecoveryInfo info{
             .Type = ContextResourceType::IMAGE,
             .Resource1 = (size_t)_image,
             .Resource2 = (size_t)_memory,
-            .Resource3 = _bindlessIndexForComputeKernel,
-            .Resource4 = _bindlessIndexForSampler
+            .Resource3 = _bindlessIndexForSampler,
+            .Resource4 = _bindlessIndexForComputeKernel
       };
       Context::Get()->RecoveryContextResource(info);
 }
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "../Helper.h"
+#include "../ResourceAccess.h"
+#include "../MappedFile.h"
+#include "../Ktx2.h"
 #include "Buffer.h"
 
 
@@ -45,7 +48,20 @@ namespace LoFi::Component {
 
             [[nodiscard]] bool IsTextureFormatDepthStencil() const { return !Internal::IsDepthStencilFormat(_imageCI->format); }
 
-            [[nodiscard]] VkImageLayout GetCurrentLayout() const { return _currentLayout; }
+            [[nodiscard]] VkImageLayout GetCurrentLayout() const { return _subresourceStates.Get(0, 0).Layout; } // of mip 0, layer 0
+
+            [[nodiscard]] VkImageLayout GetLayout(uint32_t mip, uint32_t layer) const { return _subresourceStates.Get(mip, layer).Layout; }
+
+            [[nodiscard]] uint32_t GetMipLevels() const { return _imageCI->mipLevels; }
+
+            [[nodiscard]] uint32_t GetArrayLayers() const { return _imageCI->arrayLayers; }
+
+            [[nodiscard]] VkImageAspectFlags GetAspect() const; // every aspect of the format, barriers always cover all of them
+
+            [[nodiscard]] VkImageSubresourceRange GetSubresourceRange(uint32_t base_mip = 0, uint32_t mip_count = VK_REMAINING_MIP_LEVELS,
+                  uint32_t base_layer = 0, uint32_t layer_count = VK_REMAINING_ARRAY_LAYERS) const;
+
+            [[nodiscard]] VkImageSubresourceRange GetViewSubresourceRange(uint32_t idx) const; // subresources a view covers
 
             [[nodiscard]] VkSampler GetSampler() const { return _sampler; }
 
@@ -53,6 +69,12 @@ namespace LoFi::Component {
 
             [[nodiscard]] std::optional<uint32_t> GetBindlessIndexForComputeKernel() const { return _bindlessIndexForComputeKernel; }
 
+            [[nodiscard]] uint32_t GetViewIndexForSampler() const { return _viewIndexForSampler; } // view behind the sampler index
+
+            [[nodiscard]] uint32_t GetViewIndexForComputeKernel() const { return _viewIndexForComputeKernel; }
+
+            [[nodiscard]] uint32_t GetViewIndexForAttachment() const { return _viewIndexForAttachment; } // single level view render passes use
+
             [[nodiscard]] const VkImageViewCreateInfo& GetViewCI() const { return _viewCIs.at(0); }
 
             [[nodiscard]] const VkImageViewCreateInfo& GetViewCI(uint32_t idx) const { return _viewCIs.at(idx); }
@@ -61,9 +83,17 @@ namespace LoFi::Component {
 
             void ClearViews();
 
+            // Fills mip 0, the levels below it are generated from it in the same command buffer. A compressed format
+            // can't be blitted, its other levels are filled by SetLevelData.
             void SetData(const void* data, size_t size);
 
-            void BarrierLayout(VkCommandBuffer cmd, VkImageLayout new_layout, std::optional<VkImageLayout> src_layout = std::nullopt,
+            // data is copied to the staging ring before returning, tightly packed rows of texels or compressed blocks.
+            bool SetLevelData(uint32_t mip, const void* data, size_t size);
+
+            // Queued on the context's barrier batcher and recorded by its next flush, the stages default to the ones the
+            // old and new layouts are used by. Only subresources of the range (all of them by default) not yet in
+            // new_layout are transitioned.
+            void BarrierLayout(VkImageLayout new_layout, std::optional<VkImageSubresourceRange> range = std::nullopt,
                   std::optional<VkPipelineStageFlags2> src_stage = std::nullopt,
                   std::optional<VkPipelineStageFlags2> dst_stage = std::nullopt);
 
@@ -74,9 +104,15 @@ namespace LoFi::Component {
 
             void Clean();
 
-            void SetBindlessIndexForSampler(std::optional<uint32_t> index);
+            void SetBindlessIndexForSampler(std::optional<uint32_t> index, uint32_t view_index = 0);
+
+            void SetBindlessIndexForComputeKernel(std::optional<uint32_t> index, uint32_t view_index = 0);
+
+            void SetViewIndexForAttachment(uint32_t view_index) { _viewIndexForAttachment = view_index; }
 
-            void SetBindlessIndexForComputeKernel(std::optional<uint32_t> index);
+            // Moves the texture onto a new image, the id and sampler stay. The old image, its views and bindless indices
+            // are released once the frames using them have finished, the caller creates the new views and indices.
+            void Reallocate(const VkImageCreateInfo& image_ci, const VmaAllocationCreateInfo& alloc_ci);
 
             void DestroyTexture();
 
@@ -93,6 +129,12 @@ namespace LoFi::Component {
 
             std::optional<uint32_t> _bindlessIndexForComputeKernel{};
 
+            uint32_t _viewIndexForSampler = 0;
+
+            uint32_t _viewIndexForComputeKernel = 0;
+
+            uint32_t _viewIndexForAttachment = 0;
+
             VkImage _image{};
 
             VmaAllocation _memory{};
@@ -105,8 +147,18 @@ namespace LoFi::Component {
 
             VkSampler _sampler{};
 
-            VkImageLayout _currentLayout;
+            Internal::ImageSubresourceStates _subresourceStates{}; // per (mip, layer), tracked by the context's barrier batcher
+      };
 
-            std::unique_ptr<Buffer> _intermediateBuffer{};
+      // Mip streaming state of a texture made by Context::CreateStreamedTexture2DFromKtx2. Its image holds the source
+      // levels from ResidentMip down, the file stays mapped so evicted levels can be streamed in again.
+      struct StreamedTexture {
+            Internal::MappedFile File{};
+            Internal::Ktx2Image Source{};
+            uint32_t ResidentMip = 0; // finest source level on the gpu, level 0 of the image
+            uint32_t TailMip = 0; // loaded at creation and never evicted
+            uint32_t RequestedMip = UINT32_MAX; // finest level asked for since the last update
+            uint64_t UploadEpoch = 0; // the context's upload epoch whose BeginFrame records the last queued level uploads
+            uint64_t LastRequestedFrame = 0;
       };
 }
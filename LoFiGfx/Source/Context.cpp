@@ -1,6 +1,11 @@
 #include "Context.h"
 #include "Message.h"
 #include "PhysicalDevice.h"
+#include "MappedFile.h"
+#include "Ktx2.h"
+
+#include <bit>
+#include <filesystem>
 
 #include "SDL3/SDL.h"
 
@@ -22,16 +27,31 @@ Context::~Context() {
       GlobalContext = nullptr;
 }
 
-void Context::Init() {
+void Context::Init(const ContextSetupParam& param) {
+      _bDebugMode = param.Debug;
+      _bHeadless = param.Headless;
+      _bOffline = param.Offline;
+      _programCacheDirectory = param.ProgramCacheDirectory;
+
+      if (_bOffline) {
+            // the disk cache holds shader modules and pipelines, neither exists without a device
+            _bHeadless = true;
+            _programCacheDirectory.clear();
+            volkLoadEcsWorld(&_world);
+            _threadPool.Init();
+            return;
+      }
+
       volkInitialize();
 
       std::vector<const char*> instance_layers{};
       if (_bDebugMode) instance_layers.push_back("VK_LAYER_KHRONOS_validation");
 
-      std::vector needed_instance_extension{
-            "VK_KHR_surface",
-            "VK_KHR_win32_surface"
-      };
+      std::vector<const char*> needed_instance_extension{};
+      if (!_bHeadless) {
+            needed_instance_extension.push_back("VK_KHR_surface");
+            needed_instance_extension.push_back("VK_KHR_win32_surface");
+      }
 
       {
             uint32_t count = 0;
@@ -95,9 +115,12 @@ void Context::Init() {
                   PhysicalDevice ability(physical_device);
 
                   if (!ability.isQueueFamily0SupportAllQueue()) continue;
-                  if (!ability._accelerationStructureFeatures.accelerationStructure) continue;
-                  if (!ability._rayTracingFeatures.rayTracingPipeline) continue;
-                  if (!ability._meshShaderFeatures.meshShader) continue;
+                  if (!_bHeadless) {
+                        // headless render nodes (lavapipe / llvmpipe) have none of these
+                        if (!ability._accelerationStructureFeatures.accelerationStructure) continue;
+                        if (!ability._rayTracingFeatures.rayTracingPipeline) continue;
+                        if (!ability._meshShaderFeatures.meshShader) continue;
+                  }
 
                   auto finalCard = std::format("Physical device selected: {}", ability._properties2.properties.deviceName);
                   MessageManager::Log(MessageType::Normal, finalCard);
@@ -115,14 +138,13 @@ void Context::Init() {
       }
 
       {
-            std::vector needed_device_extensions{
+            std::vector<const char*> needed_device_extensions{
 
                   "VK_KHR_dynamic_rendering", // 必要
                   "VK_EXT_descriptor_indexing", // bindless
 
                   "VK_KHR_maintenance2",
 
-                  "VK_KHR_swapchain", // 必要
                   "VK_KHR_get_memory_requirements2",
                   "VK_KHR_dedicated_allocation",
                   "VK_KHR_bind_memory2",
@@ -140,6 +162,10 @@ void Context::Init() {
                   //"VK_EXT_mesh_shader",
             };
 
+            if (!_bHeadless) {
+                  needed_device_extensions.push_back("VK_KHR_swapchain"); // 必要
+            }
+
             uint32_t count = 0;
             vkEnumerateDeviceExtensionProperties(_physicalDevice, nullptr, &count, nullptr);
             std::vector<VkExtensionProperties> extensions(count);
@@ -267,9 +293,9 @@ void Context::Init() {
                         .alphaToOne = false,
                         .multiViewport = false,
                         .samplerAnisotropy = true,
-                        .textureCompressionETC2 = false,
+                        .textureCompressionETC2 = _physicalDeviceAbility._features2.features.textureCompressionETC2, // compressed formats, whichever the device has
                         .textureCompressionASTC_LDR = false,
-                        .textureCompressionBC = false,
+                        .textureCompressionBC = _physicalDeviceAbility._features2.features.textureCompressionBC,
                         .occlusionQueryPrecise = false,
                         .pipelineStatisticsQuery = false,
                         .vertexPipelineStoresAndAtomics = false,
@@ -278,8 +304,8 @@ void Context::Init() {
                         .shaderImageGatherExtended = false,
                         .shaderStorageImageExtendedFormats = false,
                         .shaderStorageImageMultisample = false,
-                        .shaderStorageImageReadWithoutFormat = false,
-                        .shaderStorageImageWriteWithoutFormat = false,
+                        .shaderStorageImageReadWithoutFormat = _physicalDeviceAbility._features2.features.shaderStorageImageReadWithoutFormat, // "IMAGE Name;" without a format
+                        .shaderStorageImageWriteWithoutFormat = _physicalDeviceAbility._features2.features.shaderStorageImageWriteWithoutFormat,
                         .shaderUniformBufferArrayDynamicIndexing = false,
                         .shaderSampledImageArrayDynamicIndexing = false,
                         .shaderStorageBufferArrayDynamicIndexing = false,
@@ -542,12 +568,37 @@ void Context::Init() {
       }
 
 
-      MessageManager::Log(MessageType::Normal, "Successfully initialized LoFi context");
+      _readbackRing.Init(4 * 1024 * 1024, 3, VK_BUFFER_USAGE_TRANSFER_DST_BIT, true);
+      _uploadRing.Init(8 * 1024 * 1024, 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false);
+      _parameterPagePool.Init(3, _physicalDeviceAbility._properties2.properties.limits.minStorageBufferOffsetAlignment);
+      _threadPool.Init();
+      _pipelineCache.Init(_programCacheDirectory, _physicalDeviceAbility._properties2.properties);
+
+      _lastFrameTimePoint = std::chrono::steady_clock::now();
+      _statisticsWindowBegin = _lastFrameTimePoint;
+
+      MessageManager::Log(MessageType::Normal, _bHeadless ? "Successfully initialized LoFi context (headless)" : "Successfully initialized LoFi context");
 }
 
 void Context::Shutdown() {
+      _threadPool.Release();
+
+      if (_bOffline) {
+            auto view = _world.view<Component::Program>();
+            _world.destroy(view.begin(), view.end());
+            return;
+      }
+
       vkDeviceWaitIdle(_device);
 
+      // EndFrame already moved on, the current slot holds the oldest submitted frame, callbacks see readbacks in submission order
+      for (uint32_t i = 0; i < 3; i++) {
+            ResolveReadback((GetCurrentFrameIndex() + i) % 3);
+      }
+      SubmitCommandQueueImmediately();
+      _readbackRing.Release();
+      _uploadRing.Release();
+
       vkDestroyCommandPool(_device, _commandPool, nullptr);
       {
             auto view = _world.view<Component::Window, Component::Swapchain>();
@@ -581,6 +632,8 @@ void Context::Shutdown() {
             _world.destroy(view.begin(), view.end());
       }
 
+      _parameterPagePool.Release();
+
       for (int i = 0; i < 3; i++) {
             vkDestroyFence(_device, _mainCommandFence[i], nullptr);
             vkDestroySemaphore(_device, _mainCommandQueueSemaphore[i], nullptr);
@@ -595,12 +648,20 @@ void Context::Shutdown() {
             vkDestroySampler(_device, val, nullptr);
       }
 
+      _pipelineCache.Release();
+
       vmaDestroyAllocator(_allocator);
       vkDestroyDevice(_device, nullptr);
       vkDestroyInstance(_instance, nullptr);
 }
 
 entt::entity Context::CreateWindow(const char* title, int w, int h) {
+      if (_bHeadless) {
+            const auto err = "Context::CreateWindow - Context is headless, render to a texture instead";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
       if (w < 1 || h < 1) {
             const auto err = "Context::CreateWindow - Invalid window size";
             MessageManager::Log(MessageType::Error, err);
@@ -673,6 +734,15 @@ void Context::CmdBindKernel(entt::entity kernel) {
             throw std::runtime_error(err);
       }
 
+      if (!IsReady(kernel) && _world.any_of<Component::PendingGraphicKernel, Component::GrapicsKernelInstance>(kernel)) {
+            if (kernel != _fallbackGraphicsKernel && IsReady(_fallbackGraphicsKernel)) {
+                  CmdBindKernel(_fallbackGraphicsKernel);
+            } else {
+                  _skipDraws = true;
+            }
+            return;
+      }
+
       auto k = _world.try_get<Component::GraphicKernel>(kernel);
       auto ki = _world.try_get<Component::GrapicsKernelInstance>(kernel);
       if (!k && !ki) {
@@ -698,6 +768,13 @@ void Context::CmdBindKernel(entt::entity kernel) {
       }
 
       vkCmdBindPipeline(GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, k->GetPipeline());
+      _isDynamicStateKernelBound = k->IsDynamicState();
+      if (_isDynamicStateKernelBound) {
+            _dynamicState = k->GetDefaultDynamicState();
+      } else {
+            // states a pipeline bakes in are undefined for the next pipeline that takes them dynamically
+            _isAppliedDynamicStateValid = false;
+      }
       vkCmdBindDescriptorSets(GetCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, k->GetPipelineLayout(), 0, 1, &_bindlessDescriptorSet, 0, nullptr);
       const VkViewport viewport = VkViewport{0, (float)_frameRenderingRenderArea.extent.height, (float)_frameRenderingRenderArea.extent.width, -(float)_frameRenderingRenderArea.extent.height, 0, 1};
       vkCmdSetViewport(GetCurrentCommandBuffer(), 0, 1, &viewport);
@@ -705,6 +782,7 @@ void Context::CmdBindKernel(entt::entity kernel) {
       vkCmdSetScissor(GetCurrentCommandBuffer(), 0, 1, &scissor);
 
       _currentGraphicsKernel = kernel;
+      _skipDraws = false;
 
       if (ki) {
             ki->PushBindlessInfo(GetCurrentCommandBuffer());
@@ -795,6 +873,83 @@ void Context::SetKernelTexture(entt::entity frame_resource, const std::string& t
       fr->SetParameterTexture(texture_name, texture);
 }
 
+void Context::SetKernelStorageTexture(entt::entity kernel_instance, const std::string& image_name, entt::entity texture) {
+      auto ki = _world.valid(kernel_instance) ? _world.try_get<Component::GrapicsKernelInstance>(kernel_instance) : nullptr;
+      if (!ki) {
+            const auto err = "Context::SetKernelStorageTexture - Invalid kernel instance entity.";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      ki->SetParameterStorageTexture(image_name, texture);
+}
+
+void Context::SetKernelBuffer(entt::entity kernel_instance, const std::string& buffer_name, entt::entity buffer) {
+      auto ki = _world.valid(kernel_instance) ? _world.try_get<Component::GrapicsKernelInstance>(kernel_instance) : nullptr;
+      if (!ki) {
+            const auto err = "Context::SetKernelBuffer - Invalid kernel instance entity.";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      ki->SetParameterBuffer(buffer_name, buffer);
+}
+
+Component::GraphicKernelParameterHandle Context::ResolveKernelParameter(entt::entity kernel, const std::string& name) const {
+      if (!_world.valid(kernel)) {
+            const auto err = "Context::ResolveKernelParameter - Invalid kernel entity.";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (const auto ki = _world.try_get<Component::GrapicsKernelInstance>(kernel); ki) {
+            kernel = ki->GetParentGraphicsKernel();
+      }
+
+      Component::GraphicKernelParameterHandle handle{};
+      if (const auto k = _world.try_get<Component::GraphicKernel>(kernel); k) {
+            handle = k->ResolveParameter(name);
+      } else if (const auto ck = _world.try_get<Component::ComputeKernel>(kernel); ck) {
+            handle = ck->ResolveParameter(name);
+      } else {
+            const auto err = "Context::ResolveKernelParameter - this entity is not a kernel or a kernel instance.";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (!handle.IsValid()) {
+            const auto err = std::format("Context::ResolveKernelParameter - Parameter \"{}\" Not Found.", name);
+            MessageManager::Log(MessageType::Warning, err);
+      }
+
+      return handle;
+}
+
+void Context::SetKernelParameter(entt::entity kernel_instance, const Component::GraphicKernelParameterHandle& handle, const void* data) {
+      auto ki = _world.try_get<Component::GrapicsKernelInstance>(kernel_instance);
+      if (!ki || !data) {
+            const auto err = "Context::SetKernelParameter - Invalid graphics kernel instance entity or data is nullptr.";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      ki->SetParameter(handle, data);
+}
+
+void Context::ValidateKernelParameter(const Component::GraphicKernelParameterHandle& handle, size_t size, std::string_view type_name) const {
+      if (handle.Size != size) {
+            const auto err = std::format("Context::ValidateKernelParameter - Size mismatch, parameter is {} bytes, value is {} bytes.", handle.Size, size);
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (!type_name.empty() && XXH64(type_name.data(), type_name.size(), 0) != handle.TypeHash) {
+            const auto err = std::format("Context::ValidateKernelParameter - Type mismatch, value type is \"{}\".", type_name);
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+}
+
 // void Context::CmdBindLayoutVariable(const std::vector<LayoutVariableBindInfo>& layout_variable_info) {
 //
 //       if(layout_variable_info.empty()) return;
@@ -863,10 +1018,56 @@ void Context::CmdBindVertexBuffer(entt::entity buffer, size_t offset) {
             throw std::runtime_error(err);
       }
 
+      // bound before the pass, the barrier goes out with CmdBeginRenderPass, inside a pass TrackGraphicsReadsOfWrittenResources covered it
+      if (!_isRenderPassOpen) {
+            TrackBufferAccess(*buf, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+      }
+
       vkCmdBindVertexBuffers(GetCurrentCommandBuffer(), 0, 1, buf->GetBufferPtr(), &offset);
 }
 
-void Context::CmdDraw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance) const {
+void Context::CmdSetCullMode(VkCullModeFlags cull_mode) {
+      _dynamicState.CullMode = cull_mode;
+}
+
+void Context::CmdSetFrontFace(VkFrontFace front_face) {
+      _dynamicState.FrontFace = front_face;
+}
+
+void Context::CmdSetPrimitiveTopology(VkPrimitiveTopology topology) {
+      _dynamicState.Topology = topology;
+}
+
+void Context::CmdSetDepthTest(bool enable, VkCompareOp compare_op) {
+      _dynamicState.DepthTestEnable = enable;
+      _dynamicState.DepthCompareOp = compare_op;
+}
+
+void Context::CmdSetDepthWrite(bool enable) {
+      _dynamicState.DepthWriteEnable = enable;
+}
+
+void Context::FlushDynamicState() {
+      if (!_isDynamicStateKernelBound) return;
+
+      const auto cmd = GetCurrentCommandBuffer();
+      const bool all = !_isAppliedDynamicStateValid;
+      auto& applied = _appliedDynamicState;
+
+      if (all || applied.CullMode != _dynamicState.CullMode) vkCmdSetCullMode(cmd, _dynamicState.CullMode);
+      if (all || applied.FrontFace != _dynamicState.FrontFace) vkCmdSetFrontFace(cmd, _dynamicState.FrontFace);
+      if (all || applied.Topology != _dynamicState.Topology) vkCmdSetPrimitiveTopology(cmd, _dynamicState.Topology);
+      if (all || applied.DepthTestEnable != _dynamicState.DepthTestEnable) vkCmdSetDepthTestEnable(cmd, _dynamicState.DepthTestEnable);
+      if (all || applied.DepthWriteEnable != _dynamicState.DepthWriteEnable) vkCmdSetDepthWriteEnable(cmd, _dynamicState.DepthWriteEnable);
+      if (all || applied.DepthCompareOp != _dynamicState.DepthCompareOp) vkCmdSetDepthCompareOp(cmd, _dynamicState.DepthCompareOp);
+
+      applied = _dynamicState;
+      _isAppliedDynamicStateValid = true;
+}
+
+void Context::CmdDraw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance) {
+      if (_skipDraws) return;
+      FlushDynamicState();
       vkCmdDraw(GetCurrentCommandBuffer(), vertex_count, instance_count, first_vertex, first_instance);
 }
 
@@ -884,6 +1085,9 @@ void Context::CmdDrawIndex(entt::entity index_buffer, size_t offset, std::option
             throw std::runtime_error(err);
       }
 
+      if (_skipDraws) return;
+      FlushDynamicState();
+
       vkCmdBindIndexBuffer(GetCurrentCommandBuffer(), ib->GetBuffer(), offset, VK_INDEX_TYPE_UINT32);
 
       uint32_t max_vaild_idx_count = ib->GetSize() / sizeof(uint32_t);
@@ -895,6 +1099,249 @@ void Context::CmdDrawIndex(entt::entity index_buffer, size_t offset, std::option
       vkCmdDrawIndexed(GetCurrentCommandBuffer(), idx_count, 1, 0, 0, 0);
 }
 
+void Context::CmdBindComputeKernel(entt::entity kernel) {
+      if (_isRenderPassOpen) {
+            const auto err = "Context::CmdBindComputeKernel - Compute kernels can't be bound inside a render pass, call CmdEndRenderPass first.";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (!_world.valid(kernel)) {
+            const auto err = "Context::CmdBindComputeKernel - Invalid compute kernel entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto k = _world.try_get<Component::ComputeKernel>(kernel);
+      auto ki = _world.try_get<Component::GrapicsKernelInstance>(kernel);
+      if (ki) {
+            k = _world.valid(ki->GetParentGraphicsKernel()) ? _world.try_get<Component::ComputeKernel>(ki->GetParentGraphicsKernel()) : nullptr;
+      }
+
+      if (!k) {
+            const auto err = "Context::CmdBindComputeKernel - this entity is not a compute kernel or a compute kernel instance";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      const auto cmd = GetCurrentCommandBuffer();
+
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, k->GetPipeline());
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, k->GetPipelineLayout(), 0, 1, &_bindlessDescriptorSet, 0, nullptr);
+
+      if (ki) {
+            ki->PushBindlessInfo(cmd);
+      }
+
+      _currentComputeKernel = kernel;
+}
+
+void Context::ValidateComputeCommand(const char* command) const {
+      if (_isRenderPassOpen) {
+            const auto err = std::format("Context::{} - Dispatches can't be recorded inside a render pass, call CmdEndRenderPass first.", command);
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (_currentComputeKernel == entt::null) {
+            const auto err = std::format("Context::{} - No compute kernel bound, call CmdBindComputeKernel first.", command);
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+}
+
+void Context::TrackBufferAccess(Component::Buffer& buffer, VkPipelineStageFlags2 stage, VkAccessFlags2 access) {
+      _barrierBatcher.Buffer(buffer._buffer, buffer._accessState, stage, access);
+      if (IsWriteAccess(access) && buffer.GetID() != entt::null) {
+            _writtenResources.emplace(buffer.GetID());
+      }
+}
+
+void Context::TrackTextureAccess(Component::Texture& texture, const VkImageSubresourceRange& range, VkImageLayout layout, VkPipelineStageFlags2 stage, VkAccessFlags2 access, bool discard) {
+      _barrierBatcher.Image(texture._image, texture._subresourceStates, range, layout, stage, access, discard);
+      if (IsWriteAccess(access) && texture.GetID() != entt::null) {
+            _writtenResources.emplace(texture.GetID());
+      }
+}
+
+void Context::TrackComputeKernelAccess(entt::entity kernel) {
+      const auto ki = _world.try_get<Component::GrapicsKernelInstance>(kernel);
+      if (!ki) return; // a bare kernel binds no resources
+
+      const auto k = _world.valid(ki->GetParentGraphicsKernel()) ? _world.try_get<Component::ComputeKernel>(ki->GetParentGraphicsKernel()) : nullptr;
+      if (!k) return;
+
+      const auto& resources = ki->GetBoundResources();
+      const auto bound = [&](uint32_t slot) {
+            const auto resource = resources.at(slot);
+            return resource != entt::null && _world.valid(resource) ? resource : entt::null;
+      };
+
+      for (const auto& [name, slot] : k->GetSampledTextureTable()) {
+            const auto resource = bound(slot);
+            if (auto tex = resource != entt::null ? _world.try_get<Component::Texture>(resource) : nullptr) {
+                  TrackTextureAccess(*tex, tex->GetViewSubresourceRange(tex->GetViewIndexForSampler()), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+            }
+      }
+
+      // the shader doesn't tell whether it reads or writes a storage binding, both are assumed
+      for (const auto& [name, slot] : k->GetStorageImageTable()) {
+            const auto resource = bound(slot);
+            if (auto tex = resource != entt::null ? _world.try_get<Component::Texture>(resource) : nullptr) {
+                  TrackTextureAccess(*tex, tex->GetViewSubresourceRange(tex->GetViewIndexForComputeKernel()), VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+            }
+      }
+
+      for (const auto& [name, slot] : k->GetStorageBufferTable()) {
+            const auto resource = bound(slot);
+            if (auto buf = resource != entt::null ? _world.try_get<Component::Buffer>(resource) : nullptr) {
+                  TrackBufferAccess(*buf, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+            }
+      }
+}
+
+void Context::TrackGraphicsReadsOfWrittenResources(const std::vector<RenderPassBeginArgument>& attachments) {
+      // barriers can't be recorded between the draws of a pass, so the written resources a graphics kernel instance
+      // references are made visible to its reads up front, sampled textures go back to the layout their descriptors expect
+      if (_writtenResources.empty()) return;
+
+      entt::dense_set<entt::entity> referenced{};
+      for (auto&& [id, instance] : _world.view<Component::GrapicsKernelInstance>().each()) {
+            if (!_world.valid(instance.GetParentGraphicsKernel()) || !_world.all_of<Component::GraphicKernel>(instance.GetParentGraphicsKernel())) continue;
+            for (const auto resource : instance.GetBoundResources()) {
+                  if (resource != entt::null && _writtenResources.contains(resource)) referenced.insert(resource);
+            }
+      }
+
+      constexpr VkPipelineStageFlags2 buffer_stages = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT |
+            VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+      constexpr VkAccessFlags2 buffer_access = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+      std::vector<entt::entity> pending{};
+      for (const auto resource : _writtenResources) {
+            if (!_world.valid(resource)) continue;
+            if (std::ranges::any_of(attachments, [&](const auto& i) { return i.TextureHandle == resource; })) continue;
+
+            if (auto buf = _world.try_get<Component::Buffer>(resource)) {
+                  // any buffer may still be bound with CmdBindVertexBuffer or handed to CmdDrawIndex inside the pass, so the
+                  // vertex and index input wait for it
+                  if (referenced.contains(resource)) {
+                        TrackBufferAccess(*buf, buffer_stages, buffer_access);
+                  } else {
+                        TrackBufferAccess(*buf, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT);
+                  }
+            } else if (auto tex = _world.try_get<Component::Texture>(resource)) {
+                  // textures nothing graphic samples keep their layout, the pass that first references them resolves it
+                  if (!referenced.contains(resource)) {
+                        pending.push_back(resource);
+                  } else if (tex->GetBindlessIndexForSampler().has_value()) {
+                        TrackTextureAccess(*tex, tex->GetViewSubresourceRange(tex->GetViewIndexForSampler()), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+                  }
+            }
+      }
+
+      _writtenResources.clear();
+      _writtenResources.insert(pending.begin(), pending.end());
+}
+
+void Context::FlushBarriers(VkCommandBuffer cmd) {
+      _barrierBatcher.Flush(cmd);
+}
+
+void Context::RecordGenerateMipmaps(VkCommandBuffer cmd, Component::Texture& texture) {
+      const uint32_t mip_levels = texture.GetMipLevels();
+      if (mip_levels <= 1) return;
+
+      if (!texture.IsTextureFormatColor()) {
+            const auto err = std::format("Context::RecordGenerateMipmaps - Texture id: {} has a depth stencil format, its levels can't be blitted.", (uint32_t)texture.GetID());
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      VkFormatProperties properties{};
+      vkGetPhysicalDeviceFormatProperties(_physicalDevice, texture.GetFormat(), &properties);
+      const auto features = properties.optimalTilingFeatures;
+
+      if (!(features & VK_FORMAT_FEATURE_BLIT_SRC_BIT) || !(features & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+            const auto err = std::format("Context::RecordGenerateMipmaps - Format {} of texture id: {} doesn't support blits.", GetVkFormatString(texture.GetFormat()), (uint32_t)texture.GetID());
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      // formats without linear filtering still get a level, just point sampled
+      const VkFilter filter = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+      const auto extent = texture.GetExtent();
+      const auto level_extent = [&](uint32_t mip) {
+            return VkOffset3D{(int32_t)std::max(extent.width >> mip, 1u), (int32_t)std::max(extent.height >> mip, 1u), 1};
+      };
+
+      // each level reads the one above it, so the chain is one barrier and one blit per level
+      for (uint32_t mip = 1; mip < mip_levels; mip++) {
+            TrackTextureAccess(texture, texture.GetSubresourceRange(mip - 1, 1), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+            TrackTextureAccess(texture, texture.GetSubresourceRange(mip, 1), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, true);
+            FlushBarriers(cmd);
+
+            const VkImageBlit region{
+                  .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, 0, texture.GetArrayLayers()},
+                  .srcOffsets = {{0, 0, 0}, level_extent(mip - 1)},
+                  .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, texture.GetArrayLayers()},
+                  .dstOffsets = {{0, 0, 0}, level_extent(mip)}
+            };
+
+            vkCmdBlitImage(cmd, texture.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, filter);
+      }
+}
+
+void Context::CmdDispatch(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) {
+      ValidateComputeCommand("CmdDispatch");
+
+      if (group_count_x == 0 || group_count_y == 0 || group_count_z == 0) return;
+
+      TrackComputeKernelAccess(_currentComputeKernel);
+      FlushBarriers(GetCurrentCommandBuffer());
+      vkCmdDispatch(GetCurrentCommandBuffer(), group_count_x, group_count_y, group_count_z);
+}
+
+void Context::CmdDispatchIndirect(entt::entity buffer, uint64_t offset) {
+      ValidateComputeCommand("CmdDispatchIndirect");
+
+      auto buf = _world.valid(buffer) ? _world.try_get<Component::Buffer>(buffer) : nullptr;
+      if (!buf) {
+            const auto err = "Context::CmdDispatchIndirect - this entity is not a buffer";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (offset % 4 != 0 || offset + sizeof(VkDispatchIndirectCommand) > buf->GetCapacity()) {
+            const auto err = std::format("Context::CmdDispatchIndirect - Invalid offset {}, it has to be 4 byte aligned and leave room for a VkDispatchIndirectCommand in a {} byte buffer.", offset, buf->GetCapacity());
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      TrackBufferAccess(*buf, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+      TrackComputeKernelAccess(_currentComputeKernel);
+      FlushBarriers(GetCurrentCommandBuffer());
+      vkCmdDispatchIndirect(GetCurrentCommandBuffer(), buf->GetBuffer(), offset);
+}
+
+void Context::CmdGenerateMipmaps(entt::entity texture) {
+      if (_isRenderPassOpen) {
+            const auto err = "Context::CmdGenerateMipmaps - Blits can't be recorded inside a render pass, call CmdEndRenderPass first.";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto tex = _world.valid(texture) ? _world.try_get<Component::Texture>(texture) : nullptr;
+      if (!tex) {
+            const auto err = "Context::CmdGenerateMipmaps - this entity is not a texture";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      RecordGenerateMipmaps(GetCurrentCommandBuffer(), *tex);
+}
+
 entt::entity Context::CreateTexture2D(VkFormat format, uint32_t w, uint32_t h, uint32_t mipMapCounts) {
       if (w == 0 || h == 0) {
             const auto err = std::format("Context::CreateTexture2D - Invalid texture size, w = {}, h = {}, create texture failed, return null.", w, h);
@@ -902,8 +1349,36 @@ entt::entity Context::CreateTexture2D(VkFormat format, uint32_t w, uint32_t h, u
             return entt::null;
       }
 
-      auto id = _world.create();
+      // BC needs desktop hardware and ETC2 mobile, whichever is missing has no sampled support at all
+      const auto is_compressed = IsBlockCompressedFormat(format);
+      if (is_compressed) {
+            if (!IsFormatSampleable(format)) {
+                  const auto err = std::format("Context::CreateTexture2D - Compressed format {} is not supported by this device, create texture failed, return null.", GetVkFormatString(format));
+                  MessageManager::Log(MessageType::Error, err);
+                  return entt::null;
+            }
+      }
+
+      const uint32_t full_chain = std::bit_width(std::max(w, h));
+      if (mipMapCounts == 0 || mipMapCounts > full_chain) {
+            mipMapCounts = full_chain;
+      }
+
       auto is_depth_stencil = IsDepthStencilFormat(format);
+
+      // SetData fills the lower levels with blits, a format that can't be blitted would only fail once the upload runs
+      if (mipMapCounts != 1 && !is_compressed) {
+            VkFormatProperties properties{};
+            vkGetPhysicalDeviceFormatProperties(_physicalDevice, format, &properties);
+            const auto features = properties.optimalTilingFeatures;
+            if (is_depth_stencil || !(features & VK_FORMAT_FEATURE_BLIT_SRC_BIT) || !(features & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+                  const auto err = std::format("Context::CreateTexture2D - Format {} doesn't support blits, its mipmaps can't be generated, create texture failed, return null.", GetVkFormatString(format));
+                  MessageManager::Log(MessageType::Error, err);
+                  return entt::null;
+            }
+      }
+
+      auto id = _world.create();
       VkImageCreateInfo image_ci{};
       image_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
       image_ci.imageType = VK_IMAGE_TYPE_2D;
@@ -919,6 +1394,8 @@ entt::entity Context::CreateTexture2D(VkFormat format, uint32_t w, uint32_t h, u
 
       if (is_depth_stencil) {
             image_ci.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      } else if (is_compressed) {
+            image_ci.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
       } else {
             image_ci.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
       }
@@ -941,22 +1418,31 @@ entt::entity Context::CreateTexture2D(VkFormat format, uint32_t w, uint32_t h, u
       view_ci.components.a = VK_COMPONENT_SWIZZLE_A;
       view_ci.subresourceRange.aspectMask = as_flag;
       view_ci.subresourceRange.baseMipLevel = 0;
-      view_ci.subresourceRange.levelCount = 1;
+      view_ci.subresourceRange.levelCount = mipMapCounts;
       view_ci.subresourceRange.baseArrayLayer = 0;
       view_ci.subresourceRange.layerCount = 1;
 
       VmaAllocationCreateInfo alloc_ci{};
       alloc_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 
-      _world.emplace<Component::Texture>(id, id, image_ci, alloc_ci).CreateView(view_ci);
+      auto& texture = _world.emplace<Component::Texture>(id, id, image_ci, alloc_ci);
+      texture.CreateView(view_ci);
 
-      if (mipMapCounts != 1) {
-            //TODO
+      // storage image descriptors and attachments take a single level
+      uint32_t single_level_view = 0;
+      if (mipMapCounts != 1 && !is_compressed) {
+            view_ci.subresourceRange.levelCount = 1;
+            texture.CreateView(view_ci);
+            single_level_view = 1;
       }
+      texture.SetViewIndexForAttachment(single_level_view);
 
       if (!is_depth_stencil) {
             MakeBindlessIndexTextureForSampler(id);
-            MakeBindlessIndexTextureForComputeKernel(id);
+      }
+
+      if (!is_depth_stencil && !is_compressed) {
+            MakeBindlessIndexTextureForComputeKernel(id, single_level_view);
       }
 
       return id;
@@ -968,140 +1454,1386 @@ entt::entity Context::CreateTexture2D(void* pixel_data, size_t size, VkFormat fo
       return tex;
 }
 
-entt::entity Context::CreateBuffer(uint64_t size, bool cpu_access, bool bindless) {
-      if (size == 0) {
-            MessageManager::Log(MessageType::Error, "Context::CreateBuffer - Invalid buffer size, size = 0, create buffer failed, return null.");
+entt::entity Context::CreateTexture2DFromKtx2(const std::string& path) {
+      MappedFile file{};
+      if (!file.Open(path)) {
+            const auto err = std::format("Context::CreateTexture2DFromKtx2 - Failed to open \"{}\", create texture failed, return null.", path);
+            MessageManager::Log(MessageType::Error, err);
             return entt::null;
       }
 
-      auto id = _world.create();
-
-      VkBufferCreateInfo buffer_ci{};
-      buffer_ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      buffer_ci.size = size;
-      buffer_ci.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-      buffer_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      std::string error{};
+      const auto image = ParseKtx2(file.GetData(), error);
+      if (!image) {
+            const auto err = std::format("Context::CreateTexture2DFromKtx2 - \"{}\": {}, create texture failed, return null.", path, error);
+            MessageManager::Log(MessageType::Error, err);
+            return entt::null;
+      }
 
-      VmaAllocationCreateInfo alloc_ci{};
-      alloc_ci.usage = cpu_access ? VMA_MEMORY_USAGE_AUTO_PREFER_HOST : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+      // levels the file asks for are generated by blits, which compressed formats don't have
+      const bool generate_mips = image->GenerateMips && !IsBlockCompressedFormat(image->Format);
+      const entt::entity tex = CreateTexture2D(image->Format, image->Width, image->Height, generate_mips ? 0 : (uint32_t)image->Levels.size());
+      if (tex == entt::null) return entt::null;
 
-      _world.emplace<Component::Buffer>(id, id, buffer_ci, alloc_ci);
+      auto& texture = _world.get<Component::Texture>(tex);
+      const auto data = file.GetData();
 
-      if (bindless) {
-            MakeBindlessIndexBuffer(id);
+      // each level goes from the mapped pages straight into the staging ring, the mapping isn't needed past this
+      if (generate_mips) {
+            texture.SetData(data.data() + image->Levels[0].Offset, image->Levels[0].Size);
+      } else {
+            for (uint32_t mip = 0; mip < image->Levels.size(); mip++) {
+                  texture.SetLevelData(mip, data.data() + image->Levels[mip].Offset, image->Levels[mip].Size);
+            }
       }
 
-      return id;
+      return tex;
 }
 
-entt::entity Context::CreateBuffer(const void* data, uint64_t size, bool cpu_access, bool bindless) {
-      if (data == nullptr) {
-            MessageManager::Log(MessageType::Error, "Context::CreateBuffer - Invalid data pointer, data = nullptr, create buffer failed, return null.");
-            return entt::null;
-      }
-      if (size == 0) {
-            MessageManager::Log(MessageType::Error, "Context::CreateBuffer - Invalid buffer size, size = 0, create buffer failed, return null.");
-            return entt::null;
-      }
+// sampled only, holding the source levels from resident_mip down
+static VkImageCreateInfo MakeStreamedImageCI(const Ktx2Image& source, uint32_t resident_mip) {
+      VkImageCreateInfo image_ci{};
+      image_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      image_ci.imageType = VK_IMAGE_TYPE_2D;
+      image_ci.format = source.Format;
+      image_ci.extent = VkExtent3D{std::max(source.Width >> resident_mip, 1u), std::max(source.Height >> resident_mip, 1u), 1};
+      image_ci.mipLevels = (uint32_t)source.Levels.size() - resident_mip;
+      image_ci.arrayLayers = 1;
+      image_ci.samples = VK_SAMPLE_COUNT_1_BIT;
+      image_ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+      image_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      image_ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      image_ci.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+      return image_ci;
+}
+
+static VkImageViewCreateInfo MakeStreamedViewCI(const VkImageCreateInfo& image_ci) {
+      VkImageViewCreateInfo view_ci{};
+      view_ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      view_ci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      view_ci.format = image_ci.format;
+      view_ci.components.r = VK_COMPONENT_SWIZZLE_R;
+      view_ci.components.g = VK_COMPONENT_SWIZZLE_G;
+      view_ci.components.b = VK_COMPONENT_SWIZZLE_B;
+      view_ci.components.a = VK_COMPONENT_SWIZZLE_A;
+      view_ci.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      view_ci.subresourceRange.baseMipLevel = 0;
+      view_ci.subresourceRange.levelCount = image_ci.mipLevels;
+      view_ci.subresourceRange.baseArrayLayer = 0;
+      view_ci.subresourceRange.layerCount = 1;
+      return view_ci;
+}
+
+entt::entity Context::CreateStreamedTexture2DFromKtx2(const std::string& path) {
+      const auto id = _world.create();
+      auto& stream = _world.emplace<Component::StreamedTexture>(id);
+
+      const auto fail = [&](const std::string& reason) {
+            const auto err = std::format("Context::CreateStreamedTexture2DFromKtx2 - \"{}\": {}, create texture failed, return null.", path, reason);
+            MessageManager::Log(MessageType::Error, err);
+            _world.destroy(id);
+            return entt::null;
+      };
+
+      if (!stream.File.Open(path)) {
+            return fail("failed to open the file");
+      }
+
+      std::string error{};
+      auto image = ParseKtx2(stream.File.GetData(), error);
+      if (!image) {
+            return fail(error);
+      }
+      if (image->GenerateMips) {
+            return fail("only files that store their mip levels can be streamed");
+      }
+      if (!IsFormatSampleable(image->Format)) {
+            return fail(std::format("format {} is not supported by this device", GetVkFormatString(image->Format)));
+      }
+
+      stream.Source = std::move(*image);
+
+      const uint32_t level_count = (uint32_t)stream.Source.Levels.size();
+      const auto tail_size = _textureStreamingSettings.TailSize;
+      while (stream.TailMip + 1 < level_count && std::max(stream.Source.Width >> stream.TailMip, stream.Source.Height >> stream.TailMip) > tail_size) {
+            stream.TailMip++;
+      }
+      stream.ResidentMip = stream.TailMip;
+      stream.LastRequestedFrame = _sumFrameCount;
+      stream.UploadEpoch = _uploadEpoch;
+
+      VmaAllocationCreateInfo alloc_ci{};
+      alloc_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+      const auto image_ci = MakeStreamedImageCI(stream.Source, stream.ResidentMip);
+      auto& texture = _world.emplace<Component::Texture>(id, id, image_ci, alloc_ci);
+      texture.CreateView(MakeStreamedViewCI(image_ci));
+      MakeBindlessIndexTextureForSampler(id);
+
+      // the tail goes up right away so the texture can be sampled from the first frame on
+      const auto data = stream.File.GetData();
+      for (uint32_t mip = stream.ResidentMip; mip < level_count; mip++) {
+            texture.SetLevelData(mip - stream.ResidentMip, data.data() + stream.Source.Levels[mip].Offset, stream.Source.Levels[mip].Size);
+      }
+
+      return id;
+}
+
+void Context::RequestTextureMip(entt::entity texture, uint32_t mip) {
+      if (!_world.valid(texture) || !_world.all_of<Component::Texture>(texture)) {
+            const auto err = "Context::RequestTextureMip - this entity is not a texture";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      // a texture that isn't streamed is always fully resident
+      if (auto stream = _world.try_get<Component::StreamedTexture>(texture)) {
+            stream->RequestedMip = std::min(stream->RequestedMip, mip);
+            stream->LastRequestedFrame = _sumFrameCount;
+      }
+}
+
+void Context::UpdateTextureStreaming() {
+      struct Candidate {
+            entt::entity Id;
+            Component::Texture* Texture;
+            Component::StreamedTexture* Stream;
+            uint32_t Wanted; // finest level the last frame asked for, the tail when it asked for none
+            uint32_t Target; // finest level resident after this update
+      };
+
+      std::vector<Candidate> candidates{};
+      uint64_t resident_bytes = 0;
+
+      for (auto&& [id, texture, stream] : _world.view<Component::Texture, Component::StreamedTexture>().each()) {
+            for (uint32_t mip = stream.ResidentMip; mip < stream.Source.Levels.size(); mip++) {
+                  resident_bytes += stream.Source.Levels[mip].Size;
+            }
+
+            // levels queued since the last BeginFrame aren't recorded yet, a resize now would copy an empty image,
+            // the request is kept for the next update
+            if (stream.UploadEpoch == _uploadEpoch) continue;
+
+            const uint32_t wanted = std::min(stream.RequestedMip, stream.TailMip);
+            stream.RequestedMip = UINT32_MAX;
+            candidates.push_back({id, &texture, &stream, wanted, stream.ResidentMip});
+      }
+
+      const auto budget = _textureStreamingSettings.Budget;
+      const auto level_size = [](const Candidate& c, uint32_t mip) { return c.Stream->Source.Levels[mip].Size; };
+
+      // least recently requested first, each gives up its finest levels until the resident bytes fit, levels a frame
+      // still asked for only go when the budget can't be met otherwise
+      std::vector<Candidate*> eviction_order{};
+      for (auto& c : candidates) eviction_order.push_back(&c);
+      std::ranges::sort(eviction_order, {}, [](const Candidate* c) { return c->Stream->LastRequestedFrame; });
+
+      const auto evict = [&](uint64_t limit, bool needed_levels) {
+            for (auto c : eviction_order) {
+                  const uint32_t keep_from = needed_levels ? c->Stream->TailMip : c->Wanted;
+                  while (resident_bytes > limit && c->Target < keep_from) {
+                        resident_bytes -= level_size(*c, c->Target);
+                        c->Target++;
+                  }
+                  if (resident_bytes <= limit) return;
+            }
+      };
+
+      if (resident_bytes > budget) {
+            evict(budget, false);
+            evict(budget, true);
+      }
+
+      // most recently requested first, then the ones furthest from what they asked for, levels come in coarse to fine
+      std::vector<Candidate*> upgrades{};
+      for (auto& c : candidates) {
+            if (c.Wanted < c.Target && c.Target == c.Stream->ResidentMip) upgrades.push_back(&c);
+      }
+      std::ranges::sort(upgrades, [](const Candidate* a, const Candidate* b) {
+            if (a->Stream->LastRequestedFrame != b->Stream->LastRequestedFrame) return a->Stream->LastRequestedFrame > b->Stream->LastRequestedFrame;
+            return a->Target - a->Wanted > b->Target - b->Wanted;
+      });
+
+      uint64_t upload_left = _textureStreamingSettings.UploadBytesPerFrame;
+      bool uploaded = false;
+      bool stalled = false;
+      for (auto c : upgrades) {
+            while (!stalled && c->Target > c->Wanted) {
+                  const auto cost = level_size(*c, c->Target - 1);
+
+                  // a level larger than the whole allowance still goes up as the first of a frame
+                  if (cost > budget || (uploaded && cost > upload_left)) {
+                        stalled = true;
+                        break;
+                  }
+
+                  if (resident_bytes + cost > budget) {
+                        evict(budget - cost, false);
+                  }
+                  if (resident_bytes + cost > budget) {
+                        stalled = true;
+                        break;
+                  }
+
+                  resident_bytes += cost;
+                  upload_left -= std::min(cost, upload_left);
+                  uploaded = true;
+                  c->Target--;
+            }
+            if (stalled) break;
+      }
+
+      for (auto& c : candidates) {
+            if (c.Target != c.Stream->ResidentMip) {
+                  ResizeStreamedTexture(c.Id, *c.Texture, *c.Stream, c.Target);
+            }
+      }
+
+      _frameStatistics.StreamedTextureBytes = resident_bytes;
+}
+
+void Context::ResizeStreamedTexture(entt::entity id, Component::Texture& texture, Component::StreamedTexture& stream, uint32_t resident_mip) {
+      const uint32_t old_mip = stream.ResidentMip;
+      const uint32_t level_count = (uint32_t)stream.Source.Levels.size();
+      const VkImage old_image = texture.GetImage();
+      auto old_states = texture._subresourceStates;
+
+      VmaAllocationCreateInfo alloc_ci{};
+      alloc_ci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+      const auto image_ci = MakeStreamedImageCI(stream.Source, resident_mip);
+      texture.Reallocate(image_ci, alloc_ci);
+      texture.CreateView(MakeStreamedViewCI(image_ci));
+      MakeBindlessIndexTextureForSampler(id);
+      stream.ResidentMip = resident_mip;
+      stream.UploadEpoch = _uploadEpoch;
+
+      // levels both images hold are copied on the gpu, the old image lives until the frames using it have finished
+      const uint32_t first_shared = std::max(old_mip, resident_mip);
+      std::vector<VkImageCopy> regions{};
+      for (uint32_t mip = first_shared; mip < level_count; mip++) {
+            regions.push_back(VkImageCopy{
+                  .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - old_mip, 0, 1},
+                  .srcOffset = {},
+                  .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - resident_mip, 0, 1},
+                  .dstOffset = {},
+                  .extent = {std::max(stream.Source.Width >> mip, 1u), std::max(stream.Source.Height >> mip, 1u), 1}
+            });
+      }
+
+      const VkImageSubresourceRange src_range{VK_IMAGE_ASPECT_COLOR_BIT, first_shared - old_mip, level_count - first_shared, 0, 1};
+      const auto dst_range = texture.GetSubresourceRange(first_shared - resident_mip);
+      const VkImage new_image = texture.GetImage();
+
+      EnqueueCommand([=, this](VkCommandBuffer cmd) mutable {
+            auto tex = _world.valid(id) ? _world.try_get<Component::Texture>(id) : nullptr;
+            if (!tex || tex->GetImage() != new_image) return;
+
+            // the old image's tracked state orders the copy after the frames that sampled it
+            _barrierBatcher.Image(old_image, old_states, src_range, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+            TrackTextureAccess(*tex, dst_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, true);
+            FlushBarriers(cmd);
+            vkCmdCopyImage(cmd, old_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, new_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+      });
+
+      // newly resident levels come straight from the mapped file
+      const auto data = stream.File.GetData();
+      for (uint32_t mip = resident_mip; mip < old_mip; mip++) {
+            texture.SetLevelData(mip - resident_mip, data.data() + stream.Source.Levels[mip].Offset, stream.Source.Levels[mip].Size);
+      }
+}
+
+bool Context::IsFormatSampleable(VkFormat format) const {
+      VkFormatProperties properties{};
+      vkGetPhysicalDeviceFormatProperties(_physicalDevice, format, &properties);
+      return properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+}
+
+entt::entity Context::CreateBuffer(uint64_t size, bool cpu_access, bool bindless) {
+      if (size == 0) {
+            MessageManager::Log(MessageType::Error, "Context::CreateBuffer - Invalid buffer size, size = 0, create buffer failed, return null.");
+            return entt::null;
+      }
+
+      auto id = _world.create();
+
+      VkBufferCreateInfo buffer_ci{};
+      buffer_ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      buffer_ci.size = size;
+      buffer_ci.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+      buffer_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      VmaAllocationCreateInfo alloc_ci{};
+      alloc_ci.usage = cpu_access ? VMA_MEMORY_USAGE_AUTO_PREFER_HOST : VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+      _world.emplace<Component::Buffer>(id, id, buffer_ci, alloc_ci);
+
+      if (bindless) {
+            MakeBindlessIndexBuffer(id);
+      }
+
+      return id;
+}
+
+entt::entity Context::CreateBuffer(const void* data, uint64_t size, bool cpu_access, bool bindless) {
+      if (data == nullptr) {
+            MessageManager::Log(MessageType::Error, "Context::CreateBuffer - Invalid data pointer, data = nullptr, create buffer failed, return null.");
+            return entt::null;
+      }
+      if (size == 0) {
+            MessageManager::Log(MessageType::Error, "Context::CreateBuffer - Invalid buffer size, size = 0, create buffer failed, return null.");
+            return entt::null;
+      }
+
+      auto id = CreateBuffer(size, cpu_access, bindless);
+      auto& buffer = _world.get<Component::Buffer>(id);
+      buffer.SetData(data, size);
+      return id;
+}
+
+entt::entity Context::CreateGraphicKernel(entt::entity program) {
+      // a program from CreateProgramAsync is still written by a worker, CreateGraphicKernelAsync waits for it
+      const auto prog = _world.valid(program) ? _world.try_get<Component::Program>(program) : nullptr;
+      if (!prog || _world.all_of<Component::PendingProgram>(program)) {
+            const auto err = "Context::CreateGraphicKernel - Invalid or not yet compiled program entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto id = _world.create();
+      auto& kernel = _world.emplace<Component::GraphicKernel>(id, id, program);
+      _pipelineCache.Record(prog->GetCacheKey(), Internal::PipelineKind::Graphics);
+      const auto& map = kernel.GetStructTable();
+      const auto& map2 = kernel.GetStructMemberTable();
+      const auto& map3 = kernel.GetSampledTextureTable();
+
+      printf("Kernel Variable Table:\n");
+      printf("Structs:\n");
+
+      for (const auto& i : map) {
+            printf("\t%s - index: %u, size: %u\n", i.first.c_str(), i.second.Index, i.second.Size);
+      }
+
+      printf("Struct Members:\n");
+      for (const auto& i : map2) {
+            printf("\t%s - index: %u, size: %u, offset: %u\n", i.first.c_str(), i.second.StructIndex, i.second.Size, i.second.Offset);
+      }
+
+      printf("Sampled Textures:\n");
+      for (const auto& i : map3) {
+            printf("\t%s\n", i.first.c_str());
+      }
+
+      return id;
+}
+
+entt::entity Context::CreateGraphicKernel(entt::entity program, const std::vector<std::pair<std::string, Component::SpecConstantValue>>& constants) {
+      const auto prog = _world.valid(program) ? _world.try_get<Component::Program>(program) : nullptr;
+      if (!prog || _world.all_of<Component::PendingProgram>(program)) {
+            const auto err = "Context::CreateGraphicKernel - Invalid or not yet compiled program entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto spec_data = prog->ResolveSpecConstants(constants);
+
+      XXH64_state_t state{};
+      XXH64_reset(&state, 0);
+      XXH64_update(&state, &program, sizeof(program));
+      XXH64_update(&state, spec_data.data(), spec_data.size() * sizeof(uint32_t));
+      const uint64_t key = XXH64_digest(&state);
+
+      if (const auto finder = _specializedKernels.find(key); finder != _specializedKernels.end()) {
+            if (_world.valid(finder->second) && _world.all_of<Component::GraphicKernel>(finder->second)) {
+                  return finder->second;
+            }
+            _specializedKernels.erase(finder);
+      }
+
+      auto id = _world.create();
+      _world.emplace<Component::GraphicKernel>(id, id, program, true, spec_data);
+      _pipelineCache.Record(prog->GetCacheKey(), Internal::PipelineKind::Graphics, spec_data);
+      _specializedKernels.emplace(key, id);
+
+      return id;
+}
+
+entt::entity Context::CreateComputeKernel(entt::entity program) {
+      const auto prog = _world.valid(program) ? _world.try_get<Component::Program>(program) : nullptr;
+      if (!prog || _world.all_of<Component::PendingProgram>(program)) {
+            const auto err = "Context::CreateComputeKernel - Invalid or not yet compiled program entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto id = _world.create();
+      _world.emplace<Component::ComputeKernel>(id, id, program);
+      _pipelineCache.Record(prog->GetCacheKey(), Internal::PipelineKind::Compute);
+
+      return id;
+}
+
+entt::entity Context::CreateComputeKernel(entt::entity program, const std::vector<std::pair<std::string, Component::SpecConstantValue>>& constants) {
+      const auto prog = _world.valid(program) ? _world.try_get<Component::Program>(program) : nullptr;
+      if (!prog || _world.all_of<Component::PendingProgram>(program)) {
+            const auto err = "Context::CreateComputeKernel - Invalid or not yet compiled program entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto spec_data = prog->ResolveSpecConstants(constants);
+
+      XXH64_state_t state{};
+      XXH64_reset(&state, 0);
+      XXH64_update(&state, &program, sizeof(program));
+      XXH64_update(&state, spec_data.data(), spec_data.size() * sizeof(uint32_t));
+      const uint64_t key = XXH64_digest(&state);
+
+      if (const auto finder = _specializedKernels.find(key); finder != _specializedKernels.end()) {
+            if (_world.valid(finder->second) && _world.all_of<Component::ComputeKernel>(finder->second)) {
+                  return finder->second;
+            }
+            _specializedKernels.erase(finder);
+      }
+
+      auto id = _world.create();
+      _world.emplace<Component::ComputeKernel>(id, id, program, spec_data);
+      _pipelineCache.Record(prog->GetCacheKey(), Internal::PipelineKind::Compute, spec_data);
+      _specializedKernels.emplace(key, id);
+
+      return id;
+}
+
+void Context::AddShaderSearchPath(const std::string& directory) {
+      _shaderFileSystem.AddSearchPath(directory);
+}
+
+void Context::AddShaderVirtualFile(const std::string& path, std::string source) {
+      _shaderFileSystem.AddVirtualFile(path, std::move(source));
+}
+
+entt::entity Context::CreateProgram(const std::vector<std::string_view>& source_code, std::string_view name) {
+      auto id = _world.create();
+      auto& comp = _world.emplace<Component::Program>(id, id);
+      if (!comp.CompileFromSourceCode(name, source_code)) {
+            _world.destroy(id);
+            return entt::null;
+      }
+      return id;
+}
+
+entt::entity Context::CreateProgramFromFiles(const std::vector<std::string>& paths, std::string_view name) {
+      Component::ProgramHotReload reload{.Paths = paths};
+      std::vector<std::string_view> sources{};
+      for (const auto& path : paths) {
+            auto file = _shaderFileSystem.Load(path, "");
+            if (!file) {
+                  const auto err = std::format("Context::CreateProgramFromFiles - Can't read shader file \"{}\", return null.", path);
+                  MessageManager::Log(MessageType::Error, err);
+                  return entt::null;
+            }
+            sources.emplace_back(file->Source);
+            reload.Files.push_back(std::move(file));
+      }
+
+      auto id = CreateProgram(sources, name);
+      if (id == entt::null) return entt::null;
+
+      const auto& included = _world.get<Component::Program>(id)._includedFiles;
+      reload.Files.insert(reload.Files.end(), included.begin(), included.end());
+      _world.emplace<Component::ProgramHotReload>(id, std::move(reload));
+      return id;
+}
+
+void Context::SetShaderHotReload(bool enable) {
+      _shaderHotReload = enable;
+}
+
+std::vector<entt::entity> Context::CreatePrograms(const std::vector<std::vector<std::string_view>>& batch) {
+      std::vector<entt::entity> ids(batch.size());
+      for (auto& id : ids) {
+            id = _world.create();
+            _world.emplace<Component::Program>(id, id);
+      }
+
+      // the registry is only touched on this thread, workers get plain pointers
+      std::vector<Component::Program*> programs(batch.size());
+      for (size_t i = 0; i < ids.size(); i++) {
+            programs[i] = &_world.get<Component::Program>(ids[i]);
+      }
+
+      std::vector<uint8_t> results(batch.size());
+      _threadPool.ParallelFor((uint32_t)batch.size(), [&](uint32_t i) {
+            results[i] = programs[i]->CompileFromSourceCode("hello", batch[i]);
+      });
+
+      for (size_t i = 0; i < ids.size(); i++) {
+            if (!results[i]) {
+                  _world.destroy(ids[i]);
+                  ids[i] = entt::null;
+            }
+      }
+
+      return ids;
+}
+
+entt::entity Context::CreateProgramAsync(const std::vector<std::string_view>& source_code, std::string_view name) {
+      auto id = _world.create();
+      auto prog = &_world.emplace<Component::Program>(id, id);
+      auto job = std::make_shared<Internal::AsyncJob>();
+      _world.emplace<Component::PendingProgram>(id, job);
+
+      // the caller's views only have to live for this call
+      std::vector<std::string> sources{source_code.begin(), source_code.end()};
+      _threadPool.Submit([prog, job, sources = std::move(sources), name = std::string(name)] {
+            const std::vector<std::string_view> views{sources.begin(), sources.end()};
+            try {
+                  job->Succeeded = prog->CompileFromSourceCode(name, views);
+            } catch (const std::exception&) {
+                  job->Succeeded = false;
+            }
+            job->Done.store(true, std::memory_order_release);
+      });
+
+      return id;
+}
+
+entt::entity Context::CreateGraphicKernelAsync(entt::entity program) {
+      if (!_world.valid(program) || !_world.all_of<Component::Program>(program)) {
+            const auto err = std::format("Context::CreateGraphicKernelAsync - Invalid program entity, return null.");
+            MessageManager::Log(MessageType::Error, err);
+            return entt::null;
+      }
+
+      auto id = _world.create();
+      auto& pending = _world.emplace<Component::PendingGraphicKernel>(id, program);
+      if (!_world.all_of<Component::PendingProgram>(program) && !StartGraphicKernelBuild(id, pending)) {
+            _world.destroy(id);
+            return entt::null;
+      }
+
+      return id;
+}
+
+entt::entity Context::CreateGraphicKernel(entt::entity program, uint64_t variant_mask) {
+      const auto prog = _world.valid(program) ? _world.try_get<Component::Program>(program) : nullptr;
+      if (!prog || _world.all_of<Component::PendingProgram>(program)) {
+            const auto err = std::format("Context::CreateGraphicKernel - Invalid or not yet compiled program entity");
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      const auto keyword_count = prog->GetKeywords().size();
+      if (keyword_count < Component::Program::MaxKeywords && (variant_mask >> keyword_count) != 0) {
+            const auto err = std::format("Context::CreateGraphicKernel - Variant mask {:#x} sets bits past the {} keywords of program \"{}\"",
+            variant_mask, keyword_count, prog->_programName);
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto& variant = prog->_variants[variant_mask];
+      variant.Requests++;
+
+      if (_world.valid(variant.Kernel) && _world.any_of<Component::GraphicKernel, Component::PendingGraphicKernel>(variant.Kernel)) {
+            return variant.Kernel;
+      }
+
+      // mask 0 is what the program itself was compiled with
+      if (variant_mask != 0 && !(_world.valid(variant.VariantProgram) && _world.all_of<Component::Program>(variant.VariantProgram))) {
+            variant.VariantProgram = _world.create();
+            auto variant_prog = &_world.emplace<Component::Program>(variant.VariantProgram, variant.VariantProgram);
+            auto job = std::make_shared<Internal::AsyncJob>();
+            _world.emplace<Component::PendingProgram>(variant.VariantProgram, job);
+
+            std::string name = prog->_programName + "[";
+            for (uint32_t bit = 0; bit < keyword_count; bit++) {
+                  if (variant_mask & (1ull << bit)) {
+                        name += name.back() == '[' ? "" : "|";
+                        name += prog->GetKeywords()[bit];
+                  }
+            }
+            name += "]";
+
+            _threadPool.Submit([variant_prog, job, sources = prog->_variantSources, name = std::move(name), variant_mask] {
+                  const std::vector<std::string_view> views{sources.begin(), sources.end()};
+                  try {
+                        job->Succeeded = variant_prog->CompileFromSourceCode(name, views, variant_mask);
+                  } catch (const std::exception&) {
+                        job->Succeeded = false;
+                  }
+                  job->Done.store(true, std::memory_order_release);
+            });
+      }
+
+      variant.Kernel = CreateGraphicKernelAsync(variant_mask == 0 ? program : variant.VariantProgram);
+      return variant.Kernel;
+}
+
+uint64_t Context::ResolveVariantMask(entt::entity program, const std::vector<std::string_view>& keywords) const {
+      const auto prog = _world.valid(program) ? _world.try_get<Component::Program>(program) : nullptr;
+      if (!prog) {
+            const auto err = "Context::ResolveVariantMask - Invalid program entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+      return prog->ResolveVariantMask(keywords);
+}
+
+std::string Context::GenerateVariantReport(entt::entity program) const {
+      const auto prog = _world.valid(program) ? _world.try_get<Component::Program>(program) : nullptr;
+      if (!prog) {
+            const auto err = "Context::GenerateVariantReport - this entity is not a program";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      const auto& keywords = prog->GetKeywords();
+      const auto& variants = prog->GetVariants();
+
+      std::vector<std::pair<uint64_t, const Component::ProgramVariant*>> sorted{};
+      uint64_t used_keywords = 0;
+      for (const auto& [mask, variant] : variants) {
+            sorted.emplace_back(mask, &variant);
+            used_keywords |= mask;
+      }
+      std::ranges::sort(sorted, [](const auto& a, const auto& b) { return a.second->Requests > b.second->Requests; });
+
+      auto out = std::format("Program \"{}\" - {} keywords, {} variants requested\n", prog->_programName, keywords.size(), variants.size());
+      for (const auto& [mask, variant] : sorted) {
+            std::string names{};
+            for (uint32_t bit = 0; bit < keywords.size(); bit++) {
+                  if (mask & (1ull << bit)) {
+                        names += names.empty() ? "" : "|";
+                        names += keywords[bit];
+                  }
+            }
+
+            const char* state = "destroyed";
+            if (_world.valid(variant->Kernel)) {
+                  const auto pending = _world.try_get<Component::PendingGraphicKernel>(variant->Kernel);
+                  state = !pending ? "ready" : pending->Failed ? "failed" : "compiling";
+            }
+            out += std::format("      [{}] {:#x} - {} requests, {}\n", names.empty() ? "base" : names, mask, variant->Requests, state);
+      }
+
+      std::string unused{};
+      for (uint32_t bit = 0; bit < keywords.size(); bit++) {
+            if (!(used_keywords & (1ull << bit))) {
+                  unused += unused.empty() ? "" : ", ";
+                  unused += keywords[bit];
+            }
+      }
+      if (!unused.empty()) {
+            out += std::format("      never enabled: {}\n", unused);
+      }
+
+      return out;
+}
+
+bool Context::IsReady(entt::entity handle) const {
+      if (!_world.valid(handle) || _world.any_of<Component::PendingProgram, Component::PendingGraphicKernel>(handle)) {
+            return false;
+      }
+
+      if (const auto ki = _world.try_get<Component::GrapicsKernelInstance>(handle)) {
+            return IsReady(ki->GetParentGraphicsKernel());
+      }
+
+      return true;
+}
+
+void Context::WarmUpPipelines() {
+      for (const auto& entry : _pipelineCache.GetManifest()) {
+            if (!std::filesystem::exists(Component::Program::GetCachePath(entry.ProgramKey))) continue;
+
+            auto program = _world.create();
+            auto prog = &_world.emplace<Component::Program>(program, program);
+            auto job = std::make_shared<Internal::AsyncJob>();
+            _world.emplace<Component::PendingProgram>(program, job);
+
+            _threadPool.Submit([prog, job, key = entry.ProgramKey] {
+                  try {
+                        job->Succeeded = prog->CompileFromCache(key);
+                  } catch (const std::exception&) {
+                        job->Succeeded = false;
+                  }
+                  job->Done.store(true, std::memory_order_release);
+            });
+
+            // specialized kernels are rebuilt with the constants they were recorded with
+            if (entry.Kind == Internal::PipelineKind::Graphics) {
+                  auto kernel = _world.create();
+                  _world.emplace<Component::PendingGraphicKernel>(kernel, Component::PendingGraphicKernel{.ProgramEntity = program, .SpecData = entry.SpecData});
+                  _warmUpKernels.emplace_back(program, kernel);
+            } else {
+                  _warmUpComputePrograms.emplace_back(program, entry.SpecData);
+            }
+      }
+
+      auto str = std::format("Context::WarmUpPipelines - Warming up {} kernels", _warmUpKernels.size() + _warmUpComputePrograms.size());
+      MessageManager::Log(MessageType::Normal, str);
+}
+
+void Context::SetFallbackKernel(entt::entity kernel) {
+      if (kernel != entt::null && (!_world.valid(kernel) || !_world.any_of<Component::GraphicKernel, Component::PendingGraphicKernel, Component::GrapicsKernelInstance>(kernel))) {
+            const auto err = "Context::SetFallbackKernel - this entity is not a graphics kernel or a graphics kernel instance";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      _fallbackGraphicsKernel = kernel;
+}
+
+std::string Context::GenerateProgramCppHeader(entt::entity program, std::string_view name_space) const {
+      auto prog = _world.try_get<Component::Program>(program);
+      if (!prog) {
+            const auto err = "Context::GenerateProgramCppHeader - this entity is not a program";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      return prog->GenerateCppHeader(name_space);
+}
+
+entt::entity Context::CreateGraphicsKernelInstance(entt::entity graphics_kernel, bool is_cpu_side) {
+      if (!_world.valid(graphics_kernel)) {
+            const auto err = "Context::CreateFrameResource - Invalid graphics kernel entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto id = _world.create();
+      auto& instance = _world.emplace<Component::GrapicsKernelInstance>(id, id, graphics_kernel, is_cpu_side);
+      instance.MarkParameterChanged(); // slots may hold a previous owner's data
+      return id;
+}
+
+entt::entity Context::CreateComputeKernelInstance(entt::entity compute_kernel) {
+      if (!_world.valid(compute_kernel) || !_world.all_of<Component::ComputeKernel>(compute_kernel)) {
+            const auto err = "Context::CreateComputeKernelInstance - Invalid compute kernel entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto id = _world.create();
+      auto& instance = _world.emplace<Component::GrapicsKernelInstance>(id, id, compute_kernel);
+      instance.MarkParameterChanged(); // slots may hold a previous owner's data
+      return id;
+}
+
+void Context::DestroyHandle(entt::entity handle) {
+      if (_world.valid(handle)) {
+            // a worker may still be compiling this program or building a pipeline from it
+            if (_world.any_of<Component::Program, Component::GraphicKernel>(handle)) {
+                  WaitPendingJobs();
+            }
+
+            // a swap built but not yet taken would leak its pipeline
+            if (const auto swap = _world.try_get<Component::PendingPipelineSwap>(handle); swap && swap->Job->Succeeded && *swap->Pipeline) {
+                  const ContextResourceRecoveryInfo info{
+                        .Type = ContextResourceType::PIPELINE,
+                        .Resource1 = (size_t)*swap->Pipeline
+                  };
+                  RecoveryContextResource(info);
+            }
+
+            // variant programs belong to their base program, kernels built from them stay valid
+            if (const auto prog = _world.try_get<Component::Program>(handle)) {
+                  for (const auto& [mask, variant] : prog->GetVariants()) {
+                        if (_world.valid(variant.VariantProgram)) {
+                              _world.destroy(variant.VariantProgram);
+                        }
+                  }
+            }
+            _world.destroy(handle);
+      }
+}
+
+void Context::SetBufferData(entt::entity buffer, void* data, uint64_t size) {
+      if (!_world.valid(buffer)) {
+            const auto err = "Context::SetBufferData - Invalid buffer entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto buffer_component = _world.try_get<Component::Buffer>(buffer);
+
+      if (!buffer_component) {
+            const auto err = "Context::SetBufferData - this entity is not a buffer";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      buffer_component->SetData(data, size);
+}
+
+void Context::FillTexture2D(entt::entity texture, void* data, uint64_t size) {
+      if (!_world.valid(texture)) {
+            const auto err = "Context::SetTexture2DData - Invalid texture entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto texture_component = _world.try_get<Component::Texture>(texture);
+      if (!texture_component) {
+            const auto err = "Context::SetTexture2DData - this entity is not a texture";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      texture_component->SetData(data, size);
+}
+
+void Context::ReadbackBuffer(entt::entity buffer, const ReadbackCallback& callback, uint64_t offset, std::optional<uint64_t> size) {
+      if (!callback) {
+            const auto err = "Context::ReadbackBuffer - Invalid callback";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (!_world.valid(buffer) || !_world.try_get<Component::Buffer>(buffer)) {
+            const auto err = "Context::ReadbackBuffer - Invalid buffer entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      if (_isRenderPassOpen) {
+            const auto err = "Context::ReadbackBuffer - Render pass is still open, readback must be recorded outside of a render pass";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
 
-      auto id = CreateBuffer(size, cpu_access, bindless);
-      auto& buffer = _world.get<Component::Buffer>(id);
-      buffer.SetData(data, size);
-      return id;
+      if (_isFrameRecording) {
+            RecordReadbackBuffer(GetCurrentCommandBuffer(), buffer, callback, offset, size);
+      } else {
+            EnqueueCommand([this, buffer, callback, offset, size](VkCommandBuffer cmd) {
+                  RecordReadbackBuffer(cmd, buffer, callback, offset, size);
+            });
+      }
 }
 
-entt::entity Context::CreateGraphicKernel(entt::entity program) {
-      auto id = _world.create();
-      auto& kernel = _world.emplace<Component::GraphicKernel>(id, id, program);
-      const auto& map = kernel.GetStructTable();
-      const auto& map2 = kernel.GetStructMemberTable();
-      const auto& map3 = kernel.GetSampledTextureTable();
+void Context::ReadbackTexture(entt::entity texture, const ReadbackCallback& callback) {
+      if (!callback) {
+            const auto err = "Context::ReadbackTexture - Invalid callback";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
 
-      printf("Kernel Variable Table:\n");
-      printf("Structs:\n");
+      if (!_world.valid(texture) || !_world.try_get<Component::Texture>(texture)) {
+            const auto err = "Context::ReadbackTexture - Invalid texture entity";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
 
-      for (const auto& i : map) {
-            printf("\t%s - index: %u, size: %u\n", i.first.c_str(), i.second.Index, i.second.Size);
+      if (_isRenderPassOpen) {
+            const auto err = "Context::ReadbackTexture - Render pass is still open, readback must be recorded outside of a render pass";
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
       }
 
-      printf("Struct Members:\n");
-      for (const auto& i : map2) {
-            printf("\t%s - index: %u, size: %u, offset: %u\n", i.first.c_str(), i.second.StructIndex, i.second.Size, i.second.Offset);
+      if (_isFrameRecording) {
+            RecordReadbackTexture(GetCurrentCommandBuffer(), texture, callback);
+      } else {
+            EnqueueCommand([this, texture, callback](VkCommandBuffer cmd) {
+                  RecordReadbackTexture(cmd, texture, callback);
+            });
       }
+}
 
-      printf("Sampled Textures:\n");
-      for (const auto& i : map3) {
-            printf("\t%s\n", i.first.c_str());
+void Context::UpdatePendingCreation() {
+      std::vector<entt::entity> finished{};
+
+      for (auto&& [id, pending] : _world.view<Component::PendingProgram>().each()) {
+            if (!pending.Failed && pending.Job->Done.load(std::memory_order_acquire)) {
+                  finished.push_back(id);
+            }
       }
 
-      return id;
+      for (const auto id : finished) {
+            auto& pending = _world.get<Component::PendingProgram>(id);
+            if (pending.Job->Succeeded) {
+                  _world.remove<Component::PendingProgram>(id);
+            } else {
+                  // keep the handle, it simply never becomes ready
+                  pending.Failed = true;
+                  const auto err = std::format("Context::UpdatePendingCreation - Program {} failed to compile", (uint32_t)id);
+                  MessageManager::Log(MessageType::Error, err);
+            }
+      }
+
+      for (auto&& [id, pending] : _world.view<Component::PendingGraphicKernel>().each()) {
+            if (pending.Failed) continue;
+
+            if (!pending.Job) {
+                  const bool program_alive = _world.valid(pending.ProgramEntity) && _world.all_of<Component::Program>(pending.ProgramEntity);
+                  if (!program_alive || _world.all_of<Component::PendingProgram>(pending.ProgramEntity)) {
+                        pending.Failed = !program_alive || _world.get<Component::PendingProgram>(pending.ProgramEntity).Failed;
+                        if (pending.Failed) {
+                              const auto err = std::format("Context::UpdatePendingCreation - Graphics kernel {} lost its program", (uint32_t)id);
+                              MessageManager::Log(MessageType::Error, err);
+                        }
+                        continue;
+                  }
+
+                  if (!StartGraphicKernelBuild(id, pending)) {
+                        pending.Failed = true;
+                  }
+                  continue;
+            }
+
+            if (!pending.Job->Done.load(std::memory_order_acquire)) continue;
+
+            if (pending.Job->Succeeded) {
+                  finished.push_back(id);
+            } else {
+                  pending.Failed = true;
+                  const auto err = std::format("Context::UpdatePendingCreation - Graphics kernel {} failed to build its pipeline", (uint32_t)id);
+                  MessageManager::Log(MessageType::Error, err);
+            }
+      }
+
+      for (const auto id : finished) {
+            _world.remove<Component::PendingGraphicKernel>(id);
+      }
+
+      // warm-up kernels only had to pass through the pipeline cache
+      std::erase_if(_warmUpKernels, [&](const std::pair<entt::entity, entt::entity>& warm_up) {
+            const auto& [program, kernel] = warm_up;
+            if (_world.valid(kernel)) {
+                  const auto pending = _world.try_get<Component::PendingGraphicKernel>(kernel);
+                  if (pending && !pending->Failed) return false;
+                  _world.destroy(kernel);
+            }
+            _world.destroy(program);
+            return true;
+      });
+
+      // compute pipelines have no async path, they are built here once their program has loaded
+      std::erase_if(_warmUpComputePrograms, [&](const std::pair<entt::entity, std::vector<uint32_t>>& warm_up) {
+            const auto& [program, spec_data] = warm_up;
+            if (const auto pending = _world.try_get<Component::PendingProgram>(program)) {
+                  if (!pending->Failed) return false;
+            } else {
+                  try {
+                        const auto kernel = _world.create();
+                        _world.emplace<Component::ComputeKernel>(kernel, kernel, program, spec_data);
+                        _pipelineCache.Record(_world.get<Component::Program>(program).GetCacheKey(), Internal::PipelineKind::Compute, spec_data);
+                        _world.destroy(kernel);
+                  } catch (const std::exception& e) {
+                        const auto err = std::format("Context::UpdatePendingCreation - Warm-up compute kernel of program {} failed, {}", (uint32_t)program, e.what());
+                        MessageManager::Log(MessageType::Warning, err);
+                  }
+            }
+            _world.destroy(program);
+            return true;
+      });
 }
 
-entt::entity Context::CreateProgram(const std::vector<std::string_view>& source_code) {
-      auto id = _world.create();
-      auto& comp = _world.emplace<Component::Program>(id, id);
-      if (!comp.CompileFromSourceCode("hello", source_code)) {
-            _world.destroy(id);
-            return entt::null;
+bool Context::StartGraphicKernelBuild(entt::entity kernel, Component::PendingGraphicKernel& pending) {
+      // layout and reflection tables are built here, the registry is only touched on this thread
+      Component::GraphicKernel* k = nullptr;
+      try {
+            k = &_world.emplace<Component::GraphicKernel>(kernel, kernel, pending.ProgramEntity, false, pending.SpecData);
+      } catch (const std::exception&) {
+            return false;
+      }
+
+      auto prog = &_world.get<Component::Program>(pending.ProgramEntity);
+      auto job = std::make_shared<Internal::AsyncJob>();
+      pending.Job = job;
+      _pipelineCache.Record(prog->GetCacheKey(), Internal::PipelineKind::Graphics, pending.SpecData);
+
+      _threadPool.Submit([k, prog, job] {
+            try {
+                  k->BuildPipeline(prog);
+                  job->Succeeded = true;
+            } catch (const std::exception&) {
+                  job->Succeeded = false;
+            }
+            job->Done.store(true, std::memory_order_release);
+      });
+
+      return true;
+}
+
+void Context::WaitPendingJobs() {
+      auto is_running = [](const std::shared_ptr<Internal::AsyncJob>& job) {
+            return job && !job->Done.load(std::memory_order_acquire);
+      };
+
+      for (auto&& [id, pending] : _world.view<Component::PendingProgram>().each()) {
+            while (is_running(pending.Job)) {
+                  if (!_threadPool.RunOne()) std::this_thread::yield();
+            }
+      }
+
+      for (auto&& [id, pending] : _world.view<Component::PendingGraphicKernel>().each()) {
+            while (is_running(pending.Job)) {
+                  if (!_threadPool.RunOne()) std::this_thread::yield();
+            }
+      }
+
+      for (auto&& [id, reload] : _world.view<Component::ProgramHotReload>().each()) {
+            while (is_running(reload.Job)) {
+                  if (!_threadPool.RunOne()) std::this_thread::yield();
+            }
+      }
+
+      for (auto&& [id, swap] : _world.view<Component::PendingPipelineSwap>().each()) {
+            while (is_running(swap.Job)) {
+                  if (!_threadPool.RunOne()) std::this_thread::yield();
+            }
       }
-      return id;
 }
 
-entt::entity Context::CreateGraphicsKernelInstance(entt::entity graphics_kernel, bool is_cpu_side) {
-      if (!_world.valid(graphics_kernel)) {
-            const auto err = "Context::CreateFrameResource - Invalid graphics kernel entity";
+void Context::UpdateShaderHotReload() {
+      // finished pipelines go live between frames, the old one is retired with the frames that may still use it
+      std::vector<entt::entity> swapped{};
+      for (auto&& [id, swap, kernel] : _world.view<Component::PendingPipelineSwap, Component::GraphicKernel>().each()) {
+            if (!swap.Job->Done.load(std::memory_order_acquire)) continue;
+            swapped.push_back(id);
+            if (!swap.Job->Succeeded) continue;
+
+            if (kernel._pipeline) {
+                  const ContextResourceRecoveryInfo info{
+                        .Type = ContextResourceType::PIPELINE,
+                        .Resource1 = (size_t)kernel._pipeline
+                  };
+                  RecoveryContextResource(info);
+            }
+            kernel._pipeline = *swap.Pipeline;
+      }
+
+      for (const auto id : swapped) {
+            _world.remove<Component::PendingPipelineSwap>(id);
+      }
+
+      for (auto&& [id, reload] : _world.view<Component::ProgramHotReload>().each()) {
+            if (reload.Job && reload.Job->Done.load(std::memory_order_acquire)) {
+                  FinishShaderHotReload(id, reload);
+            }
+      }
+
+      const auto now = std::chrono::steady_clock::now();
+      if (!_shaderHotReload || now - _lastShaderHotReloadPoll < ShaderHotReloadPollInterval) return;
+      _lastShaderHotReloadPoll = now;
+
+      for (auto&& [id, reload] : _world.view<Component::ProgramHotReload>().each()) {
+            if (reload.Job || _world.all_of<Component::PendingProgram>(id)) continue;
+
+            // the file system only rereads a file whose write time moved, a touched but unchanged file keeps its hash
+            bool changed = false;
+            for (auto& file : reload.Files) {
+                  auto current = _shaderFileSystem.Load(file->Path, "");
+                  if (current && current->Hash != file->Hash) {
+                        changed = true;
+                        file = std::move(current);
+                  }
+            }
+
+            if (changed) {
+                  StartShaderHotReload(id, reload);
+            }
+      }
+}
+
+void Context::StartShaderHotReload(entt::entity program, Component::ProgramHotReload& reload) {
+      auto& prog = _world.get<Component::Program>(program);
+
+      std::vector<std::string> sources{};
+      for (uint32_t i = 0; i < reload.Paths.size(); i++) {
+            sources.push_back(reload.Files[i]->Source);
+      }
+
+      // the program and each live variant rebuild into detached programs, seeded with the SPIR-V they compiled last time
+      std::vector<uint64_t> masks{0};
+      reload.Rebuilt.clear();
+      reload.Rebuilt.emplace_back(program, std::make_unique<Component::Program>(program));
+      reload.Rebuilt.back().second->SeedReusableStages(prog);
+      for (const auto& [mask, variant] : prog._variants) {
+            if (mask == 0 || !_world.valid(variant.VariantProgram) || !_world.all_of<Component::Program>(variant.VariantProgram)) continue;
+            if (_world.all_of<Component::PendingProgram>(variant.VariantProgram)) continue;
+            masks.push_back(mask);
+            reload.Rebuilt.emplace_back(variant.VariantProgram, std::make_unique<Component::Program>(variant.VariantProgram));
+            reload.Rebuilt.back().second->SeedReusableStages(_world.get<Component::Program>(variant.VariantProgram));
+      }
+
+      std::vector<std::pair<Component::Program*, std::string>> targets{};
+      for (const auto& [entity, rebuilt] : reload.Rebuilt) {
+            targets.emplace_back(rebuilt.get(), _world.get<Component::Program>(entity)._programName);
+      }
+
+      auto str = std::format("Context::StartShaderHotReload - Reloading program \"{}\" and {} variants", prog._programName, masks.size() - 1);
+      MessageManager::Log(MessageType::Normal, str);
+
+      reload.Job = std::make_shared<Internal::AsyncJob>();
+      _threadPool.Submit([job = reload.Job, targets = std::move(targets), masks = std::move(masks), sources = std::move(sources)] {
+            const std::vector<std::string_view> views{sources.begin(), sources.end()};
+            bool succeeded = true;
+            try {
+                  for (uint32_t i = 0; i < targets.size() && succeeded; i++) {
+                        succeeded = targets[i].first->CompileFromSourceCode(targets[i].second, views, masks[i]);
+                  }
+            } catch (const std::exception&) {
+                  succeeded = false;
+            }
+            job->Succeeded = succeeded;
+            job->Done.store(true, std::memory_order_release);
+      });
+}
+
+void Context::FinishShaderHotReload(entt::entity program, Component::ProgramHotReload& reload) {
+      const bool succeeded = reload.Job->Succeeded;
+      auto rebuilt = std::move(reload.Rebuilt);
+      reload.Job.reset();
+
+      if (!succeeded) {
+            // the old program keeps running, the next save of a watched file tries again
+            const auto err = std::format("Context::FinishShaderHotReload - Program {} failed to reload, keeping the previous version", (uint32_t)program);
+            MessageManager::Log(MessageType::Error, err);
+            return;
+      }
+
+      // no worker may be building a pipeline from the state about to be swapped out
+      WaitPendingJobs();
+
+      entt::dense_set<entt::entity> reloaded{};
+      for (auto& [entity, fresh] : rebuilt) {
+            if (!_world.valid(entity) || !_world.all_of<Component::Program>(entity)) continue;
+            _world.get<Component::Program>(entity).SwapCompiledState(*fresh);
+            reloaded.emplace(entity);
+      }
+
+      // the roots stay, includes may have been added or removed
+      reload.Files.resize(reload.Paths.size());
+      const auto& included = _world.get<Component::Program>(program)._includedFiles;
+      reload.Files.insert(reload.Files.end(), included.begin(), included.end());
+
+      uint32_t rebuilding = 0;
+      for (auto&& [id, kernel] : _world.view<Component::GraphicKernel>().each()) {
+            if (!reloaded.contains(kernel.GetProgram()) || _world.any_of<Component::PendingGraphicKernel>(id)) continue;
+
+            auto prog = &_world.get<Component::Program>(kernel.GetProgram());
+            if (!kernel.IsLayoutCompatible(prog)) {
+                  const auto warn = std::format("Context::FinishShaderHotReload - Kernel {} keeps its old pipeline, the reloaded program \"{}\" changed its parameter layout",
+                  (uint32_t)id, prog->_programName);
+                  MessageManager::Log(MessageType::Warning, warn);
+                  continue;
+            }
+
+            // a swap of the previous reload not taken yet was built from the replaced state, WaitPendingJobs finished its job,
+            // its pipeline was never bound and is retired instead of dropped
+            if (const auto stale = _world.try_get<Component::PendingPipelineSwap>(id); stale && stale->Job->Succeeded && *stale->Pipeline) {
+                  const ContextResourceRecoveryInfo info{
+                        .Type = ContextResourceType::PIPELINE,
+                        .Resource1 = (size_t)*stale->Pipeline
+                  };
+                  RecoveryContextResource(info);
+            }
+
+            auto& swap = _world.emplace_or_replace<Component::PendingPipelineSwap>(id);
+            swap.Job = std::make_shared<Internal::AsyncJob>();
+            _threadPool.Submit([k = &kernel, prog, job = swap.Job, pipeline = swap.Pipeline] {
+                  try {
+                        *pipeline = k->CreatePipeline(prog);
+                        job->Succeeded = true;
+                  } catch (const std::exception&) {
+                        job->Succeeded = false;
+                  }
+                  job->Done.store(true, std::memory_order_release);
+            });
+            rebuilding++;
+      }
+
+      auto str = std::format("Context::FinishShaderHotReload - Reloaded {} programs, rebuilding {} pipelines", reloaded.size(), rebuilding);
+      MessageManager::Log(MessageType::Normal, str);
+}
+
+void Context::RecordReadbackBuffer(VkCommandBuffer cmd, entt::entity buffer, const ReadbackCallback& callback, uint64_t offset, std::optional<uint64_t> size) {
+      auto buf = _world.valid(buffer) ? _world.try_get<Component::Buffer>(buffer) : nullptr;
+      if (!buf) {
+            MessageManager::Log(MessageType::Warning, "Context::RecordReadbackBuffer - Buffer destroyed before readback, skipped");
+            return;
+      }
+
+      const uint64_t copy_size = size.value_or(buf->GetSize() > offset ? buf->GetSize() - offset : 0);
+      if (copy_size == 0 || offset + copy_size > buf->GetCapacity()) {
+            const auto err = std::format("Context::RecordReadbackBuffer - Invalid readback range, offset {}, size {}, capacity {}", offset, copy_size, buf->GetCapacity());
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 
-      auto id = _world.create();
-      _world.emplace<Component::GrapicsKernelInstance>(id, id, graphics_kernel, is_cpu_side);
-      return id;
+      const auto allocation = _readbackRing.Allocate(copy_size, 4);
+
+      TrackBufferAccess(*buf, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+      FlushBarriers(cmd);
+
+      const VkBufferCopy region{
+            .srcOffset = offset,
+            .dstOffset = allocation.Offset,
+            .size = copy_size
+      };
+      vkCmdCopyBuffer(cmd, buf->GetBuffer(), allocation.Buffer, 1, &region);
+
+      const VkMemoryBarrier2 after{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+            .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT
+      };
+
+      const VkDependencyInfo after_info{
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &after
+      };
+      vkCmdPipelineBarrier2(cmd, &after_info);
+
+      _pendingReadbacks[GetCurrentFrameIndex()].push_back(PendingReadback{allocation, callback});
 }
 
-void Context::DestroyHandle(entt::entity handle) {
-      if (_world.valid(handle)) {
-            _world.destroy(handle);
+void Context::RecordReadbackTexture(VkCommandBuffer cmd, entt::entity texture, const ReadbackCallback& callback) {
+      auto tex = _world.valid(texture) ? _world.try_get<Component::Texture>(texture) : nullptr;
+      if (!tex) {
+            MessageManager::Log(MessageType::Warning, "Context::RecordReadbackTexture - Texture destroyed before readback, skipped");
+            return;
+      }
+
+      const uint32_t texel_size = GetFormatTexelSize(tex->GetFormat());
+      if (texel_size == 0) {
+            const auto err = std::format("Context::RecordReadbackTexture - Unsupported readback format {}", GetVkFormatString(tex->GetFormat()));
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      const auto extent = tex->GetExtent();
+      const uint64_t copy_size = (uint64_t)extent.width * extent.height * texel_size;
+
+      // bufferOffset must be a multiple of the texel size and of 4
+      const auto allocation = _readbackRing.Allocate(copy_size, std::lcm<VkDeviceSize>(texel_size, 4));
+
+      const VkImageLayout restore_layout = tex->GetCurrentLayout();
+      TrackTextureAccess(*tex, tex->GetSubresourceRange(0, 1, 0, 1), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+      FlushBarriers(cmd);
+
+      const VkBufferImageCopy region{
+            .bufferOffset = allocation.Offset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {
+                  .aspectMask = IsDepthStencilFormat(tex->GetFormat()) ? (VkImageAspectFlags)VK_IMAGE_ASPECT_DEPTH_BIT : (VkImageAspectFlags)VK_IMAGE_ASPECT_COLOR_BIT,
+                  .mipLevel = 0,
+                  .baseArrayLayer = 0,
+                  .layerCount = 1
+            },
+            .imageOffset = {},
+            .imageExtent = {extent.width, extent.height, 1}
+      };
+      vkCmdCopyImageToBuffer(cmd, tex->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, allocation.Buffer, 1, &region);
+
+      if (restore_layout != VK_IMAGE_LAYOUT_UNDEFINED && restore_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+            tex->BarrierLayout(restore_layout, tex->GetSubresourceRange(0, 1, 0, 1));
       }
+
+      const VkMemoryBarrier2 after{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+            .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT
+      };
+
+      const VkDependencyInfo after_info{
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &after
+      };
+      vkCmdPipelineBarrier2(cmd, &after_info);
+
+      _pendingReadbacks[GetCurrentFrameIndex()].push_back(PendingReadback{allocation, callback});
 }
 
-void Context::SetBufferData(entt::entity buffer, void* data, uint64_t size) {
-      if (!_world.valid(buffer)) {
-            const auto err = "Context::SetBufferData - Invalid buffer entity";
+RingAllocation Context::UploadToStaging(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+      const auto allocation = _uploadRing.Allocate(size, alignment);
+      memcpy(allocation.MappedPtr, data, size);
+      _uploadRing.Flush(allocation);
+      _frameUploadedBytes += size;
+      return allocation;
+}
+
+void Context::ResolveReadback(uint32_t frame_index) {
+      auto& list = _pendingReadbacks[frame_index];
+      for (const auto& pending : list) {
+            _readbackRing.Invalidate(pending.Allocation);
+            pending.Callback(pending.Allocation.MappedPtr, pending.Allocation.Size);
+      }
+      list.clear();
+}
+
+void Context::SubmitCommandQueueImmediately() {
+      if (_commandQueue.empty()) return;
+
+      // the device is idle and every slot resolved, reuse the current frame's command buffer and readback region
+      const auto frame_index = GetCurrentFrameIndex();
+      auto cmd = GetCurrentCommandBuffer();
+      _readbackRing.BeginRegion(frame_index);
+
+      if (vkResetCommandBuffer(cmd, 0) != VK_SUCCESS) {
+            const auto err = "Context::SubmitCommandQueueImmediately - Failed to reset command buffer";
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 
-      auto buffer_component = _world.try_get<Component::Buffer>(buffer);
+      VkCommandBufferBeginInfo begin_info{};
+      begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-      if (!buffer_component) {
-            const auto err = "Context::SetBufferData - this entity is not a buffer";
+      if (vkBeginCommandBuffer(cmd, &begin_info) != VK_SUCCESS) {
+            const auto err = "Context::SubmitCommandQueueImmediately - Failed to begin command buffer";
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 
-      buffer_component->SetData(data, size);
-}
+      _barrierBatcher.Begin(cmd);
+      _isFrameRecording = true;
 
-void Context::FillTexture2D(entt::entity texture, void* data, uint64_t size) {
-      if (!_world.valid(texture)) {
-            const auto err = "Context::SetTexture2DData - Invalid texture entity";
+      for (const auto& i : _commandQueue) {
+            i(cmd);
+      }
+      _commandQueue.clear();
+
+      FlushBarriers(cmd);
+
+      if (vkEndCommandBuffer(cmd) != VK_SUCCESS) {
+            const auto err = "Context::SubmitCommandQueueImmediately - Failed to end command buffer";
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 
-      auto texture_component = _world.try_get<Component::Texture>(texture);
-      if (!texture_component) {
-            const auto err = "Context::SetTexture2DData - this entity is not a texture";
+      _isFrameRecording = false;
+
+      VkSubmitInfo submit_info{};
+      submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submit_info.commandBufferCount = 1;
+      submit_info.pCommandBuffers = &cmd;
+
+      if (vkQueueSubmit(_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            const auto err = "Context::SubmitCommandQueueImmediately - Failed to submit command buffer";
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 
-      texture_component->SetData(data, size);
+      vkQueueWaitIdle(_queue);
+      ResolveReadback(frame_index);
 }
 
 void* Context::PollEvent() {
+      if (_bHeadless) {
+            return nullptr;
+      }
+
       static SDL_Event event{};
 
       SDL_PollEvent(&event);
@@ -1127,6 +2859,13 @@ void Context::EnqueueCommand(const std::function<void(VkCommandBuffer)>& command
 }
 
 void Context::BeginFrame() {
+      PrepareWindowRenderTarget();
+      UpdatePendingCreation();
+      UpdateShaderHotReload();
+      UpdateTextureStreaming();
+      auto cmd = GetCurrentCommandBuffer();
+
+      // parameter pages are written in place, only touch this frame's region once its fence has been waited
       _world.view<Component::GrapicsKernelInstance, Component::TagGrapicsKernelInstanceParameterChanged>().each([](entt::entity, Component::GrapicsKernelInstance& res) {
             res.PushResourceChanged();
       });
@@ -1138,8 +2877,8 @@ void Context::BeginFrame() {
 
       _world.remove<Component::TagGrapicsKernelInstanceParameterChanged, Component::TagGrapicsKernelInstanceParameterUpdateCompleted>(buffer_udpate_completed.begin(), buffer_udpate_completed.end());
 
-      PrepareWindowRenderTarget();
-      auto cmd = GetCurrentCommandBuffer();
+      ResolveReadback(GetCurrentFrameIndex());
+      _readbackRing.BeginRegion(GetCurrentFrameIndex());
 
       if (vkResetCommandBuffer(cmd, 0) != VK_SUCCESS) {
             const auto err = "Context::BeginFrame Failed to reset command buffer";
@@ -1156,12 +2895,22 @@ void Context::BeginFrame() {
             throw std::runtime_error(err);
       }
 
+      _barrierBatcher.Begin(cmd);
+
+      _isFrameRecording = true;
+      _currentComputeKernel = entt::null;
+      _isDynamicStateKernelBound = false;
+      _isAppliedDynamicStateValid = false;
+
       for (const auto& i : _commandQueue) {
             i(cmd);
       }
 
       _commandQueue.clear();
 
+      _uploadEpoch++;
+      _uploadRing.BeginRegion(_uploadEpoch % _uploadRing.GetRegionCount());
+
       _world.view<Component::Swapchain>().each([&](auto entity, Component::Swapchain& swapchain) {
             swapchain.BeginFrame(cmd);
       });
@@ -1198,12 +2947,17 @@ void Context::EndFrame() {
             present_image_index.push_back(swapchain.GetCurrentRenderTargetIndex());
       });
 
+      // transitions queued by the swapchains and by readbacks that ended the frame
+      FlushBarriers(cmd_buf);
+
       if (vkEndCommandBuffer(cmd_buf) != VK_SUCCESS) {
             const auto err = "Context::EndFrame Failed to end command buffer";
             MessageManager::Log(MessageType::Error, err);
             throw std::runtime_error(err);
       }
 
+      _isFrameRecording = false;
+
       VkSubmitInfo vk_submit_info{};
       VkCommandBuffer buffers[] = {cmd_buf};
       vk_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1212,8 +2966,11 @@ void Context::EndFrame() {
       vk_submit_info.pWaitSemaphores = semaphores_wait_for.data();
       vk_submit_info.waitSemaphoreCount = semaphores_wait_for.size();
       vk_submit_info.pWaitDstStageMask = dst_stage_wait_for.data();
-      vk_submit_info.pSignalSemaphores = &_mainCommandQueueSemaphore[GetCurrentFrameIndex()];
-      vk_submit_info.signalSemaphoreCount = 1;
+
+      // nothing to present (headless or all windows closed), only the fence is needed
+      const bool need_present = !swap_chains.empty();
+      vk_submit_info.pSignalSemaphores = need_present ? &_mainCommandQueueSemaphore[GetCurrentFrameIndex()] : nullptr;
+      vk_submit_info.signalSemaphoreCount = need_present ? 1 : 0;
 
       if (vkQueueSubmit(_queue, 1, &vk_submit_info, GetCurrentFence()) != VK_SUCCESS) {
             const auto err = "Context::EndFrame Failed to submit command buffer";
@@ -1221,6 +2978,12 @@ void Context::EndFrame() {
             throw std::runtime_error(err);
       }
 
+      if (!need_present) {
+            StageRecoveryContextResource();
+            GoNextFrame();
+            return;
+      }
+
       VkPresentInfoKHR present_info{};
       present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
       present_info.waitSemaphoreCount = 1;
@@ -1278,10 +3041,11 @@ void Context::CmdBeginRenderPass(const std::vector<RenderPassBeginArgument>& tex
       VkRenderingAttachmentInfo _frameRenderingDepthAttachment{};
       auto cmd = GetCurrentCommandBuffer();
 
+      TrackGraphicsReadsOfWrittenResources(textures);
+
       _frameRenderingRenderArea = {};
       for (const auto& entity : textures) {
             entt::entity handle = entity.TextureHandle;
-            uint32_t view_index = entity.ViewIndex;
             bool clear = entity.ClearBeforeRendering;
             if (!_world.valid(handle)) {
                   const auto err = std::format("Context::CmdBindRenderTarget - Invalid texture entity.");
@@ -1296,6 +3060,14 @@ void Context::CmdBeginRenderPass(const std::vector<RenderPassBeginArgument>& tex
                   throw std::runtime_error(err);
             }
 
+            // an attachment is a single level, a view over the mip chain would move and discard every level
+            const uint32_t view_index = entity.ViewIndex.value_or(texture->GetViewIndexForAttachment());
+            if (texture->GetViewSubresourceRange(view_index).levelCount != 1) {
+                  const auto err = std::format("Context::CmdBindRenderTarget - View {} of texture id: {} covers more than one mip level.", view_index, (uint32_t)handle);
+                  MessageManager::Log(MessageType::Error, err);
+                  throw std::runtime_error(err);
+            }
+
             auto extent = texture->GetExtent();
             if (_frameRenderingRenderArea.extent.width == 0 || _frameRenderingRenderArea.extent.height == 0) {
                   _frameRenderingRenderArea = {0, 0, extent.width, extent.height};
@@ -1310,10 +3082,9 @@ void Context::CmdBeginRenderPass(const std::vector<RenderPassBeginArgument>& tex
 
             if (texture->IsTextureFormatColor()) {
                   // RenderTarget:
-                  auto crruent_layout = texture->GetCurrentLayout();
-                  if (crruent_layout != VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
-                        texture->BarrierLayout(GetCurrentCommandBuffer(), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, std::nullopt, std::nullopt, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
-                  }
+                  // a cleared attachment doesn't need its old contents, its transition starts from undefined
+                  TrackTextureAccess(*texture, texture->GetViewSubresourceRange(view_index), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, clear);
 
                   const VkRenderingAttachmentInfo info{
                         .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
@@ -1329,10 +3100,8 @@ void Context::CmdBeginRenderPass(const std::vector<RenderPassBeginArgument>& tex
                   render_info.pColorAttachments = _frameRenderingColorAttachments.data();
             } else if (texture->IsTextureFormatDepthOnly()) {
                   // Depth:
-                  auto layout = texture->GetCurrentLayout();
-                  if (layout != VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) {
-                        texture->BarrierLayout(GetCurrentCommandBuffer(), VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, std::nullopt, std::nullopt, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT);
-                  }
+                  TrackTextureAccess(*texture, texture->GetViewSubresourceRange(view_index), VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, clear);
 
                   _frameRenderingDepthAttachment = VkRenderingAttachmentInfo{
                         .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
@@ -1347,10 +3116,8 @@ void Context::CmdBeginRenderPass(const std::vector<RenderPassBeginArgument>& tex
                   render_info.pStencilAttachment = nullptr;
             } else if (texture->IsTextureFormatDepthStencil()) {
                   //Depth Stencil
-                  auto layout = texture->GetCurrentLayout();
-                  if (layout != VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-                        texture->BarrierLayout(GetCurrentCommandBuffer(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, std::nullopt, std::nullopt, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT);
-                  }
+                  TrackTextureAccess(*texture, texture->GetViewSubresourceRange(view_index), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, clear);
 
                   _frameRenderingDepthStencilAttachment = VkRenderingAttachmentInfo{
                         .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
@@ -1371,6 +3138,7 @@ void Context::CmdBeginRenderPass(const std::vector<RenderPassBeginArgument>& tex
       }
 
       render_info.renderArea = _frameRenderingRenderArea;
+      FlushBarriers(cmd);
       vkCmdBeginRenderingKHR(cmd, &render_info);
       _isRenderPassOpen = true;
 }
@@ -1427,7 +3195,7 @@ uint32_t Context::MakeBindlessIndexTextureForSampler(entt::entity texture, uint3
 
       vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
 
-      texture_component->SetBindlessIndexForSampler(free_index);
+      texture_component->SetBindlessIndexForSampler(free_index, viewIndex);
 
       auto str = std::format("Context::MakeBindlessIndexTextureForSampler - Texture id: {}, index: {}", (uint32_t)texture_component->GetID(), free_index);
       MessageManager::Log(MessageType::Normal, str);
@@ -1479,7 +3247,7 @@ uint32_t Context::MakeBindlessIndexTextureForComputeKernel(entt::entity texture,
 
       vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
 
-      texture_component->SetBindlessIndexForComputeKernel(free_index);
+      texture_component->SetBindlessIndexForComputeKernel(free_index, viewIndex);
 
       auto str = std::format("Context::MakeBindlessIndexTextureForComputeKernel - Texture id: {}, index: {}", (uint32_t)texture_component->GetID(), free_index);
       MessageManager::Log(MessageType::Normal, str);
@@ -1533,6 +3301,33 @@ uint32_t Context::MakeBindlessIndexBuffer(entt::entity buffer) {
       return free_index;
 }
 
+uint32_t Context::MakeBindlessIndexBufferRange(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+      VkDescriptorBufferInfo buffer_info = {
+            .buffer = buffer,
+            .offset = offset,
+            .range = range
+      };
+
+      auto free_index = _bindlessIndexFreeList[0].Gen();
+
+      VkWriteDescriptorSet write{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = _bindlessDescriptorSet,
+            .dstBinding = 0,
+            .dstArrayElement = free_index,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pImageInfo = nullptr,
+            .pBufferInfo = &buffer_info,
+            .pTexelBufferView = nullptr
+      };
+
+      vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+      return free_index;
+}
+
 void Context::SetTextureSampler(entt::entity image, const VkSamplerCreateInfo& sampler_ci) {
       auto texture = _world.try_get<Component::Texture>(image);
 
@@ -1582,6 +3377,23 @@ VkFence Context::GetCurrentFence() const {
 
 void Context::GoNextFrame() {
       _currentCommandBufferIndex = (_currentCommandBufferIndex + 1) % 3;
+      _sumFrameCount++;
+
+      const auto now = std::chrono::steady_clock::now();
+      _frameStatistics.FrameCount = _sumFrameCount;
+      _frameStatistics.FrameTime = std::chrono::duration<double>(now - _lastFrameTimePoint).count();
+      _lastFrameTimePoint = now;
+
+      _frameStatistics.BytesUploaded = _frameUploadedBytes;
+      _frameUploadedBytes = 0;
+
+      _statisticsWindowFrameCount++;
+      const double window_time = std::chrono::duration<double>(now - _statisticsWindowBegin).count();
+      if (window_time >= 1.0) {
+            _frameStatistics.FramesPerSecond = (double)_statisticsWindowFrameCount / window_time;
+            _statisticsWindowFrameCount = 0;
+            _statisticsWindowBegin = now;
+      }
 }
 
 void Context::StageRecoveryContextResource() {
@@ -12,8 +12,15 @@
 #include "Components/Buffer.h"
 #include "Components/Program.h"
 #include "Components/GraphicKernel.h"
+#include "Components/ComputeKernel.h"
 #include "Components/GrapicsKernelInstance.h"
 
+#include "FrameRingBuffer.h"
+#include "ParameterPagePool.h"
+#include "ThreadPool.h"
+#include "PipelineCache.h"
+#include "ResourceAccess.h"
+
 #include "../Third/xxHash/xxh3.h"
 
 namespace LoFi {
@@ -66,7 +73,24 @@ namespace LoFi {
       }
 
       struct ContextSetupParam {
-            bool Debug = false;
+            bool Debug = true;
+            bool Headless = false; // no surface extensions and no swapchain, render targets are plain textures
+            bool Offline = false; // no vulkan instance or device, programs only compile and reflect, for build tools like LoFiShaderCodegen
+            std::string ProgramCacheDirectory{}; // compiled programs, the pipeline cache and its manifest are stored here, empty disables them
+      };
+
+      struct FrameStatistics {
+            uint64_t FrameCount = 0;
+            double FrameTime = 0.0; // seconds, cpu time between two EndFrame
+            double FramesPerSecond = 0.0; // averaged over the last second
+            uint64_t BytesUploaded = 0; // kernel parameter and staging bytes written by the cpu during the last frame
+            uint64_t StreamedTextureBytes = 0; // mip levels of streamed textures resident on the gpu
+      };
+
+      struct TextureStreamingSettings {
+            uint64_t Budget = 512ull << 20; // bytes of streamed mip levels kept on the gpu, the least recently requested are evicted past it
+            uint64_t UploadBytesPerFrame = 16ull << 20; // mip levels streamed in per frame, the rest follow in later frames
+            uint32_t TailSize = 64; // levels whose larger side is at most this many texels are loaded at creation and never evicted
       };
 
       struct LayoutVariableBindInfo {
@@ -74,10 +98,13 @@ namespace LoFi {
             entt::entity Buffer;
       };
 
+      // data is only valid during the call
+      using ReadbackCallback = std::function<void(const void* data, uint64_t size)>;
+
       struct RenderPassBeginArgument {
             entt::entity TextureHandle = entt::null;
             bool ClearBeforeRendering = true;
-            uint32_t ViewIndex = 0;
+            std::optional<uint32_t> ViewIndex{}; // the texture's attachment view when unset, the view has to cover one level
       };
 
       class Context {
@@ -86,7 +113,9 @@ namespace LoFi {
             friend class Component::GraphicKernel;
             friend class Component::ComputeKernel;
             friend class Component::Texture;
+            friend class Component::Swapchain;
             friend class Component::GrapicsKernelInstance;
+            friend class Internal::ParameterPagePool;
 
             struct SamplerCIHash {
                   std::size_t operator()(const VkSamplerCreateInfo& s) const noexcept {
@@ -111,7 +140,21 @@ namespace LoFi {
 
             ~Context();
 
-            void Init();
+            void Init(const ContextSetupParam& param = {});
+
+            [[nodiscard]] bool IsHeadless() const { return _bHeadless; }
+
+            [[nodiscard]] bool IsOffline() const { return _bOffline; }
+
+            [[nodiscard]] bool IsDebug() const { return _bDebugMode; }
+
+            [[nodiscard]] const FrameStatistics& GetFrameStatistics() const { return _frameStatistics; }
+
+            [[nodiscard]] const TextureStreamingSettings& GetTextureStreamingSettings() const { return _textureStreamingSettings; }
+
+            void SetTextureStreamingSettings(const TextureStreamingSettings& settings) { _textureStreamingSettings = settings; }
+
+            [[nodiscard]] const std::string& GetProgramCacheDirectory() const { return _programCacheDirectory; }
 
             entt::entity CreateWindow(const char* title, int w, int h);
 
@@ -121,6 +164,10 @@ namespace LoFi {
 
              [[nodiscard]] entt::entity  CreateTextureCube();*/
 
+            // mipMapCounts 0 is the full chain down to 1x1, the levels below mip 0 are generated whenever mip 0 is filled.
+            // View 0 covers every level and is the sampled one, a mipmapped texture has view 1 on mip 0 alone for storage
+            // images and attachments, render passes pick it unless told otherwise. BC and ETC2 formats are sampled only, null when the device lacks the format, and
+            // each of their levels is filled on its own.
             [[nodiscard]] entt::entity CreateTexture2D(VkFormat format, uint32_t w, uint32_t h, uint32_t mipMapCounts = 1);
 
             [[nodiscard]] entt::entity CreateTexture2D(void* pixel_data, size_t size, VkFormat format, uint32_t w, uint32_t h, uint32_t mipMapCounts = 1);
@@ -130,6 +177,21 @@ namespace LoFi {
                   return CreateTexture2D((void*)data.data(), data.size() * sizeof(T), format, w, h, mipMapCounts);
             }
 
+            // The file is memory mapped and its levels copied from the mapping into the staging ring, null when the file
+            // can't be read or isn't a 2D KTX2 texture without supercompression.
+            [[nodiscard]] entt::entity CreateTexture2DFromKtx2(const std::string& path);
+
+            // Starts with the tail levels resident, finer levels are streamed in as RequestTextureMip asks for them and
+            // evicted under the budget. The texture is sampled only, its extent and level count are those of the
+            // resident levels, and its sampler bindless index changes with them, kernel instances pick that up on bind.
+            // The file has to store its mip levels and stays mapped until the texture is destroyed.
+            [[nodiscard]] entt::entity CreateStreamedTexture2DFromKtx2(const std::string& path);
+
+            // The finest source level the frame samples the texture at, e.g. from the application's LOD selection or a
+            // readback of a gpu feedback buffer. The finest request since the last BeginFrame wins, a texture nothing
+            // asks for keeps its levels until the budget needs them.
+            void RequestTextureMip(entt::entity texture, uint32_t mip);
+
             [[nodiscard]] entt::entity CreateBuffer(uint64_t size, bool cpu_access = false, bool bindless = true);
 
             [[nodiscard]] entt::entity CreateBuffer(const void* data, uint64_t size, bool cpu_access = false, bool bindless = true);
@@ -146,16 +208,80 @@ namespace LoFi {
 
             [[nodiscard]] entt::entity CreateGraphicKernel(entt::entity program);
 
-            [[nodiscard]] entt::entity CreateProgram(const std::vector<std::string_view>& source_code);
+            // like CreateGraphicKernel(program, {{"TILE", 16u}, {"USE_FOG", false}}), values override the SPECCONST defaults,
+            // the same program and resolved values return the kernel created before as long as it is alive
+            [[nodiscard]] entt::entity CreateGraphicKernel(entt::entity program, const std::vector<std::pair<std::string, Component::SpecConstantValue>>& constants);
+
+            // "#include" paths resolve against the including file's directory first, then the search paths in order
+            void AddShaderSearchPath(const std::string& directory);
+
+            // an in-memory file "#include" finds before any disk file, e.g. engine libraries baked into the binary
+            void AddShaderVirtualFile(const std::string& path, std::string source);
+
+            [[nodiscard]] entt::entity CreateProgram(const std::vector<std::string_view>& source_code, std::string_view name = "hello");
+
+            // one file per stage, read through the shader file system, the program can be hot reloaded
+            [[nodiscard]] entt::entity CreateProgramFromFiles(const std::vector<std::string>& paths, std::string_view name = "hello");
+
+            // Polls the files of every CreateProgramFromFiles program from BeginFrame. A changed program and its variants
+            // rebuild on the thread pool, reusing the SPIR-V of unchanged stages, then every kernel made from them gets a new
+            // pipeline in the background. Kernels whose reflected layout changed keep the old pipeline, so instance data stays valid.
+            // Compute kernels are not rebuilt, they keep the code they were created with, a kernel created from the program after
+            // the reload gets the new code (CreateComputeKernel with constants returns its cached kernel, destroy that one first).
+            void SetShaderHotReload(bool enable);
+
+            // compiles every program of the batch concurrently, failed ones come back as entt::null
+            [[nodiscard]] std::vector<entt::entity> CreatePrograms(const std::vector<std::vector<std::string_view>>& batch);
+
+            // The returned handles are usable right away, the work finishes on the thread pool and is picked up
+            // by BeginFrame. Instances can be created once the kernel's program has compiled, binding a kernel that
+            // is not ready binds the fallback kernel instead, or skips the draws when there is none. The blocking
+            // CreateGraphicKernel and CreateComputeKernel throw for a program that is still compiling.
+            [[nodiscard]] entt::entity CreateProgramAsync(const std::vector<std::string_view>& source_code, std::string_view name = "hello");
+
+            [[nodiscard]] entt::entity CreateGraphicKernelAsync(entt::entity program);
+
+            // Kernel of one "#set keywords" combination, bit i enables the i-th keyword. The variant compiles on the
+            // thread pool the first time it is asked for, like CreateGraphicKernelAsync, later calls return the same kernel.
+            [[nodiscard]] entt::entity CreateGraphicKernel(entt::entity program, uint64_t variant_mask);
+
+            [[nodiscard]] uint64_t ResolveVariantMask(entt::entity program, const std::vector<std::string_view>& keywords) const;
+
+            // requested keyword combinations with their request counts, and keywords no request ever enabled
+            [[nodiscard]] std::string GenerateVariantReport(entt::entity program) const;
+
+            [[nodiscard]] bool IsReady(entt::entity handle) const;
+
+            // rebuilds the graphics and compute kernels recorded by the last session, programs load in the background and
+            // compute pipelines are built by the BeginFrame that finds their program loaded, call once after Init
+            void WarmUpPipelines();
+
+            void SetFallbackKernel(entt::entity kernel);
+
+            [[nodiscard]] std::string GenerateProgramCppHeader(entt::entity program, std::string_view name_space) const;
 
             [[nodiscard]] entt::entity CreateGraphicsKernelInstance(entt::entity graphics_kernel, bool is_cpu_side = true);
 
+            // the program needs a "CSMain" stage, STRUCT, TEXTURE, IMAGE and BUFFER parameters are set through an instance
+            [[nodiscard]] entt::entity CreateComputeKernel(entt::entity program);
+
+            // like CreateGraphicKernel(program, constants), e.g. the work group size as SPECCONST
+            [[nodiscard]] entt::entity CreateComputeKernel(entt::entity program, const std::vector<std::pair<std::string, Component::SpecConstantValue>>& constants);
+
+            [[nodiscard]] entt::entity CreateComputeKernelInstance(entt::entity compute_kernel);
+
             void DestroyHandle(entt::entity);
 
             void SetBufferData(entt::entity buffer, void* data, uint64_t size);
 
             void FillTexture2D(entt::entity texture, void* data, uint64_t size);
 
+            // Copies are recorded into the current frame (or the next one when called outside BeginFrame/EndFrame),
+            // the callback runs inside a later BeginFrame once that frame's fence has signaled.
+            void ReadbackBuffer(entt::entity buffer, const ReadbackCallback& callback, uint64_t offset = 0, std::optional<uint64_t> size = {});
+
+            void ReadbackTexture(entt::entity texture, const ReadbackCallback& callback);
+
             //void SetTexture2DData(entt::entity texture, entt::entity buffer);
 
             void EnqueueCommand(const std::function<void(VkCommandBuffer)>& command);
@@ -186,6 +312,34 @@ namespace LoFi {
 
             void SetKernelTexture(entt::entity frame_resource, const std::string& texture_name, entt::entity texture);
 
+            // "IMAGE Name;" of a compute kernel instance, the texture is moved to the general layout when the instance is bound
+            void SetKernelStorageTexture(entt::entity kernel_instance, const std::string& image_name, entt::entity texture);
+
+            // "BUFFER Name { ... };" of a compute kernel instance, the buffer has to be bindless
+            void SetKernelBuffer(entt::entity kernel_instance, const std::string& buffer_name, entt::entity buffer);
+
+            // kernel can be a graphics kernel or one of its instances, resolve once and keep the handle
+            [[nodiscard]] Component::GraphicKernelParameterHandle ResolveKernelParameter(entt::entity kernel, const std::string& name) const;
+
+            void SetKernelParameter(entt::entity kernel_instance, const Component::GraphicKernelParameterHandle& handle, const void* data);
+
+            template<class T> requires !std::is_pointer_v<T>
+            void SetKernelParameter(entt::entity kernel_instance, const Component::GraphicKernelParameterHandle& handle, const T& data) {
+                  if constexpr (std::is_same_v<T, bool>) {
+                        // a glsl bool in a std430 block is 4 bytes
+                        const uint32_t value = data ? 1 : 0;
+#ifndef NDEBUG
+                        ValidateKernelParameter(handle, sizeof(value), Component::ShaderTypeName<T>::Value);
+#endif
+                        SetKernelParameter(kernel_instance, handle, &value);
+                  } else {
+#ifndef NDEBUG
+                        ValidateKernelParameter(handle, sizeof(T), Component::ShaderTypeName<T>::Value);
+#endif
+                        SetKernelParameter(kernel_instance, handle, &data);
+                  }
+            }
+
             template<class T> requires !std::is_pointer_v<T>
             void SetKernelParamter(entt::entity frame_resource, const std::string& variable_name, const T& data) {
                   SetKernelParamter(frame_resource, variable_name, &data);
@@ -201,12 +355,36 @@ namespace LoFi {
                   SetKernelParamterStructMember(frame_resource, variable_name, &data);
             }
 
+            // Only affect kernels compiled with "#set dynamic_state = true", binding one resets the state to its
+            // setters, call these after CmdBindKernel. Commands are emitted at the next draw and only for changed values.
+            void CmdSetCullMode(VkCullModeFlags cull_mode);
+
+            void CmdSetFrontFace(VkFrontFace front_face);
+
+            void CmdSetPrimitiveTopology(VkPrimitiveTopology topology);
+
+            void CmdSetDepthTest(bool enable, VkCompareOp compare_op = VK_COMPARE_OP_LESS_OR_EQUAL);
+
+            void CmdSetDepthWrite(bool enable);
+
             void CmdBindVertexBuffer(entt::entity buffer, size_t offset = 0);
 
-            void CmdDraw(uint32_t vertex_count, uint32_t instance_count = 1, uint32_t first_vertex = 0, uint32_t first_instance = 0) const;
+            void CmdDraw(uint32_t vertex_count, uint32_t instance_count = 1, uint32_t first_vertex = 0, uint32_t first_instance = 0);
 
             void CmdDrawIndex(entt::entity index_buffer, size_t offset = 0, std::optional<uint32_t> index_count = {});
 
+            // Compute commands are recorded outside of render passes. Binding does not disturb the bound graphics kernel,
+            // a dispatch uses the last compute kernel or instance bound in this frame.
+            void CmdBindComputeKernel(entt::entity kernel);
+
+            void CmdDispatch(uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1);
+
+            // reads a VkDispatchIndirectCommand at offset, e.g. written by a culling kernel
+            void CmdDispatchIndirect(entt::entity buffer, uint64_t offset = 0);
+
+            // Regenerates every level below mip 0 by a chain of linear blits, e.g. after a kernel wrote mip 0.
+            void CmdGenerateMipmaps(entt::entity texture);
+
             //
             // void CmdBindTexture(entt::entity texture, uint32_t position = 0);
             //
@@ -223,14 +401,63 @@ namespace LoFi {
 
             uint32_t MakeBindlessIndexBuffer(entt::entity buffer);
 
+            uint32_t MakeBindlessIndexBufferRange(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
             uint32_t MakeBindlessIndexTextureForSampler(entt::entity texture, uint32_t viewIndex = 0);
 
             uint32_t MakeBindlessIndexTextureForComputeKernel(entt::entity texture, uint32_t viewIndex = 0);
 
             void SetTextureSampler(entt::entity image, const VkSamplerCreateInfo& sampler_ci);
 
+            void ValidateKernelParameter(const Component::GraphicKernelParameterHandle& handle, size_t size, std::string_view type_name) const;
+
             void PrepareWindowRenderTarget();
 
+            void UpdatePendingCreation();
+
+            void UpdateShaderHotReload();
+
+            void UpdateTextureStreaming();
+
+            void ResizeStreamedTexture(entt::entity id, Component::Texture& texture, Component::StreamedTexture& stream, uint32_t resident_mip);
+
+            [[nodiscard]] bool IsFormatSampleable(VkFormat format) const;
+
+            void StartShaderHotReload(entt::entity program, Component::ProgramHotReload& reload);
+
+            void FinishShaderHotReload(entt::entity program, Component::ProgramHotReload& reload);
+
+            bool StartGraphicKernelBuild(entt::entity kernel, Component::PendingGraphicKernel& pending);
+
+            void WaitPendingJobs();
+
+            void FlushDynamicState();
+
+            void ValidateComputeCommand(const char* command) const;
+
+            void TrackBufferAccess(Component::Buffer& buffer, VkPipelineStageFlags2 stage, VkAccessFlags2 access);
+
+            void TrackTextureAccess(Component::Texture& texture, const VkImageSubresourceRange& range, VkImageLayout layout, VkPipelineStageFlags2 stage, VkAccessFlags2 access, bool discard = false);
+
+            void TrackComputeKernelAccess(entt::entity kernel);
+
+            void TrackGraphicsReadsOfWrittenResources(const std::vector<RenderPassBeginArgument>& attachments);
+
+            void FlushBarriers(VkCommandBuffer cmd);
+
+            void RecordGenerateMipmaps(VkCommandBuffer cmd, Component::Texture& texture);
+
+            void RecordReadbackBuffer(VkCommandBuffer cmd, entt::entity buffer, const ReadbackCallback& callback, uint64_t offset, std::optional<uint64_t> size);
+
+            void RecordReadbackTexture(VkCommandBuffer cmd, entt::entity texture, const ReadbackCallback& callback);
+
+            void ResolveReadback(uint32_t frame_index);
+
+            // records and waits for commands enqueued after the last frame, so their readbacks still reach the callbacks
+            void SubmitCommandQueueImmediately();
+
+            Internal::RingAllocation UploadToStaging(const void* data, VkDeviceSize size, VkDeviceSize alignment = 4);
+
             uint32_t GetCurrentFrameIndex() const;
 
             VkCommandBuffer GetCurrentCommandBuffer() const;
@@ -262,6 +489,12 @@ namespace LoFi {
       private:
             bool _bDebugMode = true;
 
+            bool _bHeadless = false;
+
+            bool _bOffline = false;
+
+            std::string _programCacheDirectory{};
+
             VkInstance _instance{};
 
             VkPhysicalDevice _physicalDevice{};
@@ -286,6 +519,18 @@ namespace LoFi {
 
             uint64_t _sumFrameCount = 0;
 
+            FrameStatistics _frameStatistics{};
+
+            std::chrono::steady_clock::time_point _lastFrameTimePoint{};
+
+            std::chrono::steady_clock::time_point _statisticsWindowBegin{};
+
+            uint64_t _statisticsWindowFrameCount = 0;
+
+            uint64_t _frameUploadedBytes = 0;
+
+            TextureStreamingSettings _textureStreamingSettings{};
+
             //Descriptors
 
             VkDescriptorPool _descriptorPool{};
@@ -313,11 +558,68 @@ namespace LoFi {
 
             std::vector<Internal::ContextResourceRecoveryInfo> _resoureceRecoveryList[3]{};
 
+      private:
+            struct PendingReadback {
+                  Internal::RingAllocation Allocation{};
+                  ReadbackCallback Callback{};
+            };
+
+            Internal::FrameRingBuffer _readbackRing{};
+
+            std::vector<PendingReadback> _pendingReadbacks[3]{};
+
+            // copies using the upload ring are enqueued and run in the next BeginFrame, so one region more than
+            // frames in flight, a region is reused after its copies' frame fence has been waited
+            Internal::FrameRingBuffer _uploadRing{};
+
+            uint64_t _uploadEpoch = 0;
+
+            Internal::ParameterPagePool _parameterPagePool{};
+
+      private:
+            Internal::ThreadPool _threadPool{};
+
+            Internal::PipelineCache _pipelineCache{};
+
+            Internal::ShaderFileSystem _shaderFileSystem{};
+
+            std::vector<std::pair<entt::entity, entt::entity>> _warmUpKernels{}; // program, kernel, destroyed once built
+
+            std::vector<std::pair<entt::entity, std::vector<uint32_t>>> _warmUpComputePrograms{}; // program, spec data, a compute kernel is built and destroyed once the program loaded
+
+            entt::dense_map<uint64_t, entt::entity> _specializedKernels{}; // hash of program and specialization data
+
+            bool _shaderHotReload = false;
+
+            std::chrono::steady_clock::time_point _lastShaderHotReloadPoll{};
+
+            static constexpr std::chrono::milliseconds ShaderHotReloadPollInterval{250};
+
       private:
             VkRect2D _frameRenderingRenderArea{};
 
             entt::entity _currentGraphicsKernel{};
 
+            entt::entity _fallbackGraphicsKernel = entt::null;
+
+            bool _skipDraws = false; // the bound kernel is not ready and there is no fallback
+
+            bool _isDynamicStateKernelBound = false;
+
+            bool _isAppliedDynamicStateValid = false; // reset by a new command buffer and by static pipelines
+
+            Component::GraphicKernelDynamicState _dynamicState{};
+
+            Component::GraphicKernelDynamicState _appliedDynamicState{};
+
+            entt::entity _currentComputeKernel = entt::null; // reset by BeginFrame
+
+            Internal::BarrierBatcher _barrierBatcher{}; // empty between commands, every tracked command flushes it before recording
+
+            entt::dense_set<entt::entity> _writtenResources{}; // written and not yet made visible to a render pass, its draws can't wait on them from inside the pass
+
             bool _isRenderPassOpen = false;
+
+            bool _isFrameRecording = false;
       };
 }
@@ -0,0 +1,137 @@
+#include "FrameRingBuffer.h"
+#include "Message.h"
+
+using namespace LoFi;
+using namespace LoFi::Internal;
+
+FrameRingBuffer::~FrameRingBuffer() {
+      Release();
+}
+
+void FrameRingBuffer::Init(VkDeviceSize region_size, uint32_t region_count, VkBufferUsageFlags usage, bool host_read) {
+      if (region_size == 0 || region_count == 0) {
+            const auto err = std::format("FrameRingBuffer::Init - Invalid ring size, region size {}, region count {}", region_size, region_count);
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      Release();
+
+      _usage = usage;
+      _hostRead = host_read;
+      _regionCount = region_count;
+      _currentRegion = 0;
+      _regionHead.assign(region_count, 0);
+      _retiredBlocks.resize(region_count);
+      _block = CreateBlock(region_size);
+}
+
+void FrameRingBuffer::Release() {
+      for (auto& list : _retiredBlocks) {
+            for (const auto& block : list) {
+                  DestroyBlock(block);
+            }
+            list.clear();
+      }
+
+      DestroyBlock(_block);
+      _block = {};
+      _regionHead.clear();
+      _retiredBlocks.clear();
+      _regionCount = 0;
+      _currentRegion = 0;
+}
+
+void FrameRingBuffer::BeginRegion(uint32_t region) {
+      _currentRegion = region % _regionCount;
+      _regionHead[_currentRegion] = 0;
+
+      for (const auto& block : _retiredBlocks[_currentRegion]) {
+            DestroyBlock(block);
+      }
+      _retiredBlocks[_currentRegion].clear();
+}
+
+RingAllocation FrameRingBuffer::Allocate(VkDeviceSize size, VkDeviceSize alignment) {
+      if (alignment == 0) alignment = 1;
+
+      auto try_allocate = [&](VkDeviceSize& offset) -> bool {
+            const VkDeviceSize region_base = (VkDeviceSize)_currentRegion * _block.RegionSize;
+            offset = (region_base + _regionHead[_currentRegion] + alignment - 1) / alignment * alignment;
+            return offset + size <= region_base + _block.RegionSize;
+      };
+
+      VkDeviceSize offset = 0;
+      if (!try_allocate(offset)) {
+            Grow(size + alignment);
+            try_allocate(offset);
+      }
+
+      _regionHead[_currentRegion] = offset + size - (VkDeviceSize)_currentRegion * _block.RegionSize;
+
+      return RingAllocation{
+            .Buffer = _block.Buffer,
+            .Memory = _block.Memory,
+            .Offset = offset,
+            .Size = size,
+            .MappedPtr = _block.MappedPtr + offset
+      };
+}
+
+void FrameRingBuffer::Flush(const RingAllocation& allocation) const {
+      vmaFlushAllocation(volkGetLoadedVmaAllocator(), allocation.Memory, allocation.Offset, allocation.Size);
+}
+
+void FrameRingBuffer::Invalidate(const RingAllocation& allocation) const {
+      vmaInvalidateAllocation(volkGetLoadedVmaAllocator(), allocation.Memory, allocation.Offset, allocation.Size);
+}
+
+FrameRingBuffer::Block FrameRingBuffer::CreateBlock(VkDeviceSize region_size) const {
+      region_size = (region_size + 255) & ~(VkDeviceSize)255;
+
+      const VkBufferCreateInfo buffer_ci{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = region_size * _regionCount,
+            .usage = _usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+      };
+
+      const VmaAllocationCreateInfo alloc_ci{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | (_hostRead ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT),
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+      };
+
+      Block block{};
+      VmaAllocationInfo info{};
+      if (auto res = vmaCreateBuffer(volkGetLoadedVmaAllocator(), &buffer_ci, &alloc_ci, &block.Buffer, &block.Memory, &info); res != VK_SUCCESS) {
+            const auto err = std::format("FrameRingBuffer::CreateBlock - Failed to create ring buffer, {} bytes, res {}", buffer_ci.size, GetVkResultString(res));
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      block.MappedPtr = (uint8_t*)info.pMappedData;
+      block.RegionSize = region_size;
+
+      auto str = std::format(R"(FrameRingBuffer::CreateBlock - Emplace "{}" x "{}" bytes)", _regionCount, region_size);
+      MessageManager::Log(MessageType::Normal, str);
+
+      return block;
+}
+
+void FrameRingBuffer::DestroyBlock(const Block& block) {
+      if (block.Buffer) {
+            vmaDestroyBuffer(volkGetLoadedVmaAllocator(), block.Buffer, block.Memory);
+      }
+}
+
+void FrameRingBuffer::Grow(VkDeviceSize min_region_size) {
+      // other regions may still be in flight inside the old block, it lives until this region comes around again,
+      // by then every other region has been reset once too
+      _retiredBlocks[_currentRegion].push_back(_block);
+      _block = CreateBlock(std::max(_block.RegionSize * 2, min_region_size));
+      _regionHead[_currentRegion] = 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Helper.h"
+
+namespace LoFi::Internal {
+
+      struct RingAllocation {
+            VkBuffer Buffer{};
+            VmaAllocation Memory{};
+            VkDeviceSize Offset{};
+            VkDeviceSize Size{};
+            void* MappedPtr{};
+      };
+
+      // One persistently mapped buffer split into N equally sized regions, each region is bump allocated
+      // and reset as a whole once the gpu work that used it has completed.
+      class FrameRingBuffer {
+      public:
+            NO_COPY_MOVE_CONS(FrameRingBuffer);
+
+            FrameRingBuffer() = default;
+
+            ~FrameRingBuffer();
+
+            void Init(VkDeviceSize region_size, uint32_t region_count, VkBufferUsageFlags usage, bool host_read);
+
+            void Release();
+
+            // Reset a region and make it current, the caller guarantees the gpu no longer reads or writes it.
+            void BeginRegion(uint32_t region);
+
+            RingAllocation Allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+            void Flush(const RingAllocation& allocation) const;
+
+            void Invalidate(const RingAllocation& allocation) const;
+
+            [[nodiscard]] uint32_t GetCurrentRegion() const { return _currentRegion; }
+
+            [[nodiscard]] uint32_t GetRegionCount() const { return _regionCount; }
+
+            [[nodiscard]] VkDeviceSize GetRegionSize() const { return _block.RegionSize; }
+
+            [[nodiscard]] VkDeviceSize GetRegionUsedSize() const { return _regionHead.empty() ? 0 : _regionHead[_currentRegion]; }
+
+      private:
+            struct Block {
+                  VkBuffer Buffer{};
+                  VmaAllocation Memory{};
+                  uint8_t* MappedPtr{};
+                  VkDeviceSize RegionSize{};
+            };
+
+            Block CreateBlock(VkDeviceSize region_size) const;
+
+            static void DestroyBlock(const Block& block);
+
+            void Grow(VkDeviceSize min_region_size);
+
+      private:
+            Block _block{};
+
+            std::vector<VkDeviceSize> _regionHead{};
+
+            std::vector<std::vector<Block>> _retiredBlocks{}; // per region, destroyed when the region is reset
+
+            uint32_t _regionCount = 0;
+
+            uint32_t _currentRegion = 0;
+
+            VkBufferUsageFlags _usage{};
+
+            bool _hostRead = false;
+      };
+}
@@ -1168,6 +1168,125 @@ namespace LoFi::Internal {
             return IsDepthOnlyFormat(format) || IsDepthStencilOnlyFormat(format);
       }
 
+      uint32_t GetFormatTexelSize(VkFormat format) {
+            // for depth stencil formats this is the size of the depth aspect when copied to a buffer
+            switch (format) {
+                  case VK_FORMAT_R8_UNORM:
+                  case VK_FORMAT_R8_SNORM:
+                  case VK_FORMAT_R8_UINT:
+                  case VK_FORMAT_R8_SINT:
+                  case VK_FORMAT_R8_SRGB:
+                  case VK_FORMAT_S8_UINT:
+                        return 1;
+                  case VK_FORMAT_R8G8_UNORM:
+                  case VK_FORMAT_R8G8_SNORM:
+                  case VK_FORMAT_R8G8_UINT:
+                  case VK_FORMAT_R8G8_SINT:
+                  case VK_FORMAT_R8G8_SRGB:
+                  case VK_FORMAT_R16_UNORM:
+                  case VK_FORMAT_R16_SNORM:
+                  case VK_FORMAT_R16_UINT:
+                  case VK_FORMAT_R16_SINT:
+                  case VK_FORMAT_R16_SFLOAT:
+                  case VK_FORMAT_R5G6B5_UNORM_PACK16:
+                  case VK_FORMAT_B5G6R5_UNORM_PACK16:
+                  case VK_FORMAT_D16_UNORM:
+                  case VK_FORMAT_D16_UNORM_S8_UINT:
+                        return 2;
+                  case VK_FORMAT_R8G8B8A8_UNORM:
+                  case VK_FORMAT_R8G8B8A8_SNORM:
+                  case VK_FORMAT_R8G8B8A8_UINT:
+                  case VK_FORMAT_R8G8B8A8_SINT:
+                  case VK_FORMAT_R8G8B8A8_SRGB:
+                  case VK_FORMAT_B8G8R8A8_UNORM:
+                  case VK_FORMAT_B8G8R8A8_SNORM:
+                  case VK_FORMAT_B8G8R8A8_UINT:
+                  case VK_FORMAT_B8G8R8A8_SINT:
+                  case VK_FORMAT_B8G8R8A8_SRGB:
+                  case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+                  case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+                  case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+                  case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+                  case VK_FORMAT_R16G16_UNORM:
+                  case VK_FORMAT_R16G16_SNORM:
+                  case VK_FORMAT_R16G16_UINT:
+                  case VK_FORMAT_R16G16_SINT:
+                  case VK_FORMAT_R16G16_SFLOAT:
+                  case VK_FORMAT_R32_UINT:
+                  case VK_FORMAT_R32_SINT:
+                  case VK_FORMAT_R32_SFLOAT:
+                  case VK_FORMAT_D32_SFLOAT:
+                  case VK_FORMAT_D24_UNORM_S8_UINT:
+                  case VK_FORMAT_X8_D24_UNORM_PACK32:
+                  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                        return 4;
+                  case VK_FORMAT_R16G16B16A16_UNORM:
+                  case VK_FORMAT_R16G16B16A16_SNORM:
+                  case VK_FORMAT_R16G16B16A16_UINT:
+                  case VK_FORMAT_R16G16B16A16_SINT:
+                  case VK_FORMAT_R16G16B16A16_SFLOAT:
+                  case VK_FORMAT_R32G32_UINT:
+                  case VK_FORMAT_R32G32_SINT:
+                  case VK_FORMAT_R32G32_SFLOAT:
+                        return 8;
+                  case VK_FORMAT_R32G32B32_UINT:
+                  case VK_FORMAT_R32G32B32_SINT:
+                  case VK_FORMAT_R32G32B32_SFLOAT:
+                        return 12;
+                  case VK_FORMAT_R32G32B32A32_UINT:
+                  case VK_FORMAT_R32G32B32A32_SINT:
+                  case VK_FORMAT_R32G32B32A32_SFLOAT:
+                        return 16;
+                  default: return 0;
+            }
+      }
+
+      bool IsBlockCompressedFormat(VkFormat format) {
+            return GetFormatBlockSize(format) != 0 && GetFormatTexelSize(format) == 0;
+      }
+
+      uint32_t GetFormatBlockSize(VkFormat format) {
+            switch (format) {
+                  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                  case VK_FORMAT_BC4_UNORM_BLOCK:
+                  case VK_FORMAT_BC4_SNORM_BLOCK:
+                  case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+                  case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+                  case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+                  case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+                  case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+                  case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+                        return 8;
+                  case VK_FORMAT_BC2_UNORM_BLOCK:
+                  case VK_FORMAT_BC2_SRGB_BLOCK:
+                  case VK_FORMAT_BC3_UNORM_BLOCK:
+                  case VK_FORMAT_BC3_SRGB_BLOCK:
+                  case VK_FORMAT_BC5_UNORM_BLOCK:
+                  case VK_FORMAT_BC5_SNORM_BLOCK:
+                  case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+                  case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+                  case VK_FORMAT_BC7_UNORM_BLOCK:
+                  case VK_FORMAT_BC7_SRGB_BLOCK:
+                  case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+                  case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+                  case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+                  case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+                        return 16;
+                  default: return GetFormatTexelSize(format);
+            }
+      }
+
+      VkDeviceSize GetFormatLevelSize(VkFormat format, uint32_t w, uint32_t h) {
+            if (IsBlockCompressedFormat(format)) {
+                  // partial blocks at the right and bottom edge are stored whole
+                  return (VkDeviceSize)((w + 3) / 4) * ((h + 3) / 4) * GetFormatBlockSize(format);
+            }
+            return (VkDeviceSize)w * h * GetFormatTexelSize(format);
+      }
+
       const char* GetImageLayoutString(VkImageLayout layout) {
             switch (layout) {
                   case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL";
@@ -24,6 +24,8 @@ Class& operator=(const Class&) = delete
 #include <variant>
 #include <ranges>
 #include <optional>
+#include <chrono>
+#include <numeric>
 
 #include "../Third/volk/volk.h"
 #include "VmaLoader.h"
@@ -59,6 +61,14 @@ namespace LoFi::Internal {
 
       bool IsDepthStencilFormat(VkFormat format);
 
+      uint32_t GetFormatTexelSize(VkFormat format);
+
+      bool IsBlockCompressedFormat(VkFormat format); // BC1 - BC7, ETC2 and EAC, all of them 4x4 texel blocks
+
+      uint32_t GetFormatBlockSize(VkFormat format); // bytes of a compressed block, of a texel for uncompressed formats
+
+      VkDeviceSize GetFormatLevelSize(VkFormat format, uint32_t w, uint32_t h); // tightly packed bytes of one w x h layer
+
       const char* GetImageLayoutString(VkImageLayout layout);
 }
 
@@ -0,0 +1,103 @@
+#include "Ktx2.h"
+#include "BinaryStream.h"
+
+#include <bit>
+
+using namespace LoFi;
+using namespace LoFi::Internal;
+
+namespace {
+      constexpr uint8_t Ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+      // little endian on disk, like every host this library runs on
+      struct Ktx2Header {
+            uint8_t Identifier[12];
+            uint32_t VkFormat;
+            uint32_t TypeSize;
+            uint32_t PixelWidth;
+            uint32_t PixelHeight;
+            uint32_t PixelDepth;
+            uint32_t LayerCount;
+            uint32_t FaceCount;
+            uint32_t LevelCount;
+            uint32_t SupercompressionScheme;
+            uint32_t DfdByteOffset;
+            uint32_t DfdByteLength;
+            uint32_t KvdByteOffset;
+            uint32_t KvdByteLength;
+            uint64_t SgdByteOffset;
+            uint64_t SgdByteLength;
+      };
+
+      struct Ktx2LevelIndex {
+            uint64_t ByteOffset;
+            uint64_t ByteLength;
+            uint64_t UncompressedByteLength;
+      };
+
+      static_assert(sizeof(Ktx2Header) == 80);
+}
+
+std::optional<Ktx2Image> LoFi::Internal::ParseKtx2(std::span<const uint8_t> file, std::string& error) {
+      BinaryReader reader(file);
+
+      Ktx2Header header{};
+      if (!reader.Read(header) || std::memcmp(header.Identifier, Ktx2Identifier, sizeof(Ktx2Identifier)) != 0) {
+            error = "not a KTX2 file";
+            return std::nullopt;
+      }
+
+      if (header.VkFormat == VK_FORMAT_UNDEFINED) {
+            error = "Basis Universal data has to be transcoded first";
+            return std::nullopt;
+      }
+      if (header.SupercompressionScheme != 0) {
+            error = std::format("supercompression scheme {} is not supported", header.SupercompressionScheme);
+            return std::nullopt;
+      }
+      if (header.PixelWidth == 0 || header.PixelHeight == 0 || header.PixelDepth > 1) {
+            error = std::format("only 2D textures are supported, extent {}x{}x{}", header.PixelWidth, header.PixelHeight, header.PixelDepth);
+            return std::nullopt;
+      }
+      if (header.LayerCount > 1 || header.FaceCount != 1) {
+            error = std::format("arrays and cube maps are not supported, {} layers, {} faces", header.LayerCount, header.FaceCount);
+            return std::nullopt;
+      }
+
+      const auto format = (VkFormat)header.VkFormat;
+      if (GetFormatBlockSize(format) == 0) {
+            error = std::format("format {} is not supported", GetVkFormatString(format));
+            return std::nullopt;
+      }
+
+      Ktx2Image image{
+            .Format = format,
+            .Width = header.PixelWidth,
+            .Height = header.PixelHeight,
+            .GenerateMips = header.LevelCount == 0
+      };
+
+      const uint32_t level_count = std::max(header.LevelCount, 1u);
+      if (level_count > (uint32_t)std::bit_width(std::max(header.PixelWidth, header.PixelHeight))) {
+            error = std::format("{} levels is more than a full mip chain", level_count);
+            return std::nullopt;
+      }
+
+      for (uint32_t mip = 0; mip < level_count; mip++) {
+            Ktx2LevelIndex level{};
+            if (!reader.Read(level)) {
+                  error = "truncated level index";
+                  return std::nullopt;
+            }
+
+            const auto expected = GetFormatLevelSize(format, std::max(header.PixelWidth >> mip, 1u), std::max(header.PixelHeight >> mip, 1u));
+            if (level.ByteLength != expected || level.ByteOffset > file.size() || level.ByteLength > file.size() - level.ByteOffset) {
+                  error = std::format("level {} is {} bytes at {}, expected {} bytes inside a {} byte file", mip, level.ByteLength, level.ByteOffset, expected, file.size());
+                  return std::nullopt;
+            }
+
+            image.Levels.push_back({level.ByteOffset, level.ByteLength});
+      }
+
+      return image;
+}
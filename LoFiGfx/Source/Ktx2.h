@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Helper.h"
+
+namespace LoFi::Internal {
+
+      struct Ktx2Level {
+            uint64_t Offset; // from the start of the file
+            uint64_t Size;
+      };
+
+      // What a texture needs from a KTX2 file, the level data itself stays in the file.
+      struct Ktx2Image {
+            VkFormat Format = VK_FORMAT_UNDEFINED;
+            uint32_t Width = 0;
+            uint32_t Height = 0;
+            bool GenerateMips = false; // only mip 0 is stored, the file asks for the rest to be generated
+            std::vector<Ktx2Level> Levels{}; // mip 0 first
+      };
+
+      // Single layer, single face 2D files without supercompression, error tells which of these the file isn't.
+      std::optional<Ktx2Image> ParseKtx2(std::span<const uint8_t> file, std::string& error);
+}
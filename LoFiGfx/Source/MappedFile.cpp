@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace LoFi;
+using namespace LoFi::Internal;
+
+MappedFile::~MappedFile() {
+      Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::filesystem::path& path) {
+      Close();
+
+      const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE) return false;
+      _file = file;
+
+      LARGE_INTEGER size{};
+      if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            Close();
+            return false;
+      }
+
+      _mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (!_mapping) {
+            Close();
+            return false;
+      }
+
+      _data = (const uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+      if (!_data) {
+            Close();
+            return false;
+      }
+
+      _size = (size_t)size.QuadPart;
+      return true;
+}
+
+void MappedFile::Close() {
+      if (_data) UnmapViewOfFile(_data);
+      if (_mapping) CloseHandle(_mapping);
+      if (_file) CloseHandle(_file);
+
+      _data = nullptr;
+      _size = 0;
+      _mapping = nullptr;
+      _file = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::filesystem::path& path) {
+      Close();
+
+      _fd = open(path.c_str(), O_RDONLY);
+      if (_fd < 0) return false;
+
+      struct stat info{};
+      if (fstat(_fd, &info) != 0 || info.st_size == 0) {
+            Close();
+            return false;
+      }
+
+      void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+      if (data == MAP_FAILED) {
+            Close();
+            return false;
+      }
+      madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+      _data = (const uint8_t*)data;
+      _size = (size_t)info.st_size;
+      return true;
+}
+
+void MappedFile::Close() {
+      if (_data) munmap((void*)_data, _size);
+      if (_fd >= 0) close(_fd);
+
+      _data = nullptr;
+      _size = 0;
+      _fd = -1;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Helper.h"
+
+#include <filesystem>
+
+namespace LoFi::Internal {
+
+      // Read only view of a whole file, pages are faulted in as they are read so large assets are never copied
+      // into a heap buffer first.
+      class MappedFile {
+      public:
+            NO_COPY_MOVE_CONS(MappedFile);
+
+            MappedFile() = default;
+
+            ~MappedFile();
+
+            bool Open(const std::filesystem::path& path); // false when the file can't be opened or is empty
+
+            void Close();
+
+            [[nodiscard]] std::span<const uint8_t> GetData() const { return {_data, _size}; }
+
+      private:
+            const uint8_t* _data{};
+
+            size_t _size = 0;
+
+#ifdef _WIN32
+            void* _file{};
+
+            void* _mapping{};
+#else
+            int _fd = -1;
+#endif
+      };
+}
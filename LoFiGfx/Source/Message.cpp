@@ -9,6 +9,7 @@
 using namespace LoFi;
 
 void MessageManager::Log(MessageType type, std::string_view content) {
+      std::lock_guard lock(Mutex);
       switch (type) {
             case MessageType::Normal:
                   NormalCount++;
@@ -30,10 +31,12 @@ void MessageManager::Log(MessageType type, std::string_view content) {
 }
 
 void MessageManager::Clear() {
+      std::lock_guard lock(Mutex);
       Messages.clear();
 }
 
 std::string MessageManager::Get(int MessageCount) {
+      std::lock_guard lock(Mutex);
       std::string result{};
       for (const auto& msg : Messages) {
             MessageCount--;
@@ -3,6 +3,7 @@
 //
 
 #include <list>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include "Helper.h"
@@ -34,6 +35,8 @@ namespace LoFi {
             static std::string Get(int messageCount = 0);
 
       private:
+            inline static std::mutex Mutex; // programs are compiled on worker threads
+
             inline static std::list<Message> Messages;
             inline static uint32_t ErrorCount = 0;
             inline static uint32_t WarningCount = 0;
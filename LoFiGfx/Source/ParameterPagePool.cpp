@@ -0,0 +1,130 @@
+#include "ParameterPagePool.h"
+#include "Context.h"
+#include "Message.h"
+
+using namespace LoFi;
+using namespace LoFi::Internal;
+
+ParameterPagePool::~ParameterPagePool() {
+      Release();
+}
+
+void ParameterPagePool::Init(uint32_t region_count, VkDeviceSize region_alignment) {
+      Release();
+
+      _regionCount = region_count;
+      _regionAlignment = std::max<VkDeviceSize>(region_alignment, 1);
+}
+
+void ParameterPagePool::Release() {
+      for (const auto& page : _pages) {
+            vmaDestroyBuffer(volkGetLoadedVmaAllocator(), page.Buffer, page.Memory);
+      }
+      _pages.clear();
+      _pagesByStride.clear();
+}
+
+ParameterSlot ParameterPagePool::Allocate(uint32_t stride) {
+      if (stride == 0) {
+            const auto err = std::format("ParameterPagePool::Allocate - Invalid stride 0");
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      uint32_t page_index = UINT32_MAX;
+      for (const auto idx : _pagesByStride[stride]) {
+            if (_pages[idx].Used < _pages[idx].Capacity) {
+                  page_index = idx;
+                  break;
+            }
+      }
+
+      if (page_index == UINT32_MAX) {
+            page_index = CreatePage(stride);
+      }
+
+      auto& page = _pages[page_index];
+
+      uint32_t element;
+      if (page.FreeElements.empty()) {
+            element = page.Top++;
+      } else {
+            element = page.FreeElements.back();
+            page.FreeElements.pop_back();
+      }
+      page.Used++;
+
+      return ParameterSlot{.Page = page_index, .Element = element};
+}
+
+void ParameterPagePool::Free(const ParameterSlot& slot) {
+      if (!slot.IsValid() || slot.Page >= _pages.size()) return;
+
+      // frames still in flight only read the regions they were recorded with, a new owner writes a region
+      // after its fence has been waited, so the element can be reused right away
+      auto& page = _pages[slot.Page];
+      page.FreeElements.push_back(slot.Element);
+      page.Used--;
+}
+
+uint8_t* ParameterPagePool::GetSlotPtr(const ParameterSlot& slot, uint32_t region) const {
+      const auto& page = _pages.at(slot.Page);
+      return page.MappedPtr + page.RegionSize * region + (VkDeviceSize)page.Stride * slot.Element;
+}
+
+uint32_t ParameterPagePool::GetDescriptorIndex(const ParameterSlot& slot, uint32_t region) const {
+      return _pages.at(slot.Page).DescriptorIndex.at(region);
+}
+
+void ParameterPagePool::Flush(const ParameterSlot& slot, uint32_t region, VkDeviceSize offset, VkDeviceSize size) const {
+      const auto& page = _pages.at(slot.Page);
+      const VkDeviceSize base = page.RegionSize * region + (VkDeviceSize)page.Stride * slot.Element;
+      vmaFlushAllocation(volkGetLoadedVmaAllocator(), page.Memory, base + offset, size);
+}
+
+uint32_t ParameterPagePool::CreatePage(uint32_t stride) {
+      Page page{};
+      page.Stride = stride;
+      page.Capacity = (uint32_t)std::clamp<VkDeviceSize>(PageElementBytes / stride, 1, (1u << ElementIndexBits) - 1);
+      page.RegionSize = ((VkDeviceSize)stride * page.Capacity + _regionAlignment - 1) / _regionAlignment * _regionAlignment;
+
+      const VkBufferCreateInfo buffer_ci{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = page.RegionSize * _regionCount,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+      };
+
+      const VmaAllocationCreateInfo alloc_ci{
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO,
+      };
+
+      VmaAllocationInfo info{};
+      if (auto res = vmaCreateBuffer(volkGetLoadedVmaAllocator(), &buffer_ci, &alloc_ci, &page.Buffer, &page.Memory, &info); res != VK_SUCCESS) {
+            const auto err = std::format("ParameterPagePool::CreatePage - Failed to create parameter page, stride {}, {} bytes, res {}", stride, buffer_ci.size, GetVkResultString(res));
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      page.MappedPtr = (uint8_t*)info.pMappedData;
+
+      auto& ctx = *Context::Get();
+      page.DescriptorIndex.resize(_regionCount);
+      for (uint32_t region = 0; region < _regionCount; region++) {
+            page.DescriptorIndex[region] = ctx.MakeBindlessIndexBufferRange(page.Buffer, page.RegionSize * region, page.RegionSize);
+      }
+
+      const auto index = (uint32_t)_pages.size();
+      _pages.push_back(std::move(page));
+      _pagesByStride[stride].push_back(index);
+
+      auto str = std::format(R"(ParameterPagePool::CreatePage - Page {}, stride "{}", capacity "{}", "{}" x "{}" bytes)", index, stride, _pages[index].Capacity, _regionCount, _pages[index].RegionSize);
+      MessageManager::Log(MessageType::Normal, str);
+
+      return index;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Helper.h"
+
+namespace LoFi::Internal {
+
+      struct ParameterSlot {
+            uint32_t Page = UINT32_MAX;
+            uint32_t Element = 0;
+
+            [[nodiscard]] bool IsValid() const { return Page != UINT32_MAX; }
+      };
+
+      // Kernel instance parameter structs are sub-allocated from a few shared pages instead of one buffer per struct per frame.
+      // A page stores elements of a single std430 stride and holds one region per frame in flight, every region takes one
+      // bindless storage buffer index, shaders address a struct with that index plus its element.
+      class ParameterPagePool {
+      public:
+            NO_COPY_MOVE_CONS(ParameterPagePool);
+
+            ParameterPagePool() = default;
+
+            ~ParameterPagePool();
+
+            void Init(uint32_t region_count, VkDeviceSize region_alignment);
+
+            void Release();
+
+            ParameterSlot Allocate(uint32_t stride);
+
+            void Free(const ParameterSlot& slot);
+
+            [[nodiscard]] uint8_t* GetSlotPtr(const ParameterSlot& slot, uint32_t region) const;
+
+            [[nodiscard]] uint32_t GetDescriptorIndex(const ParameterSlot& slot, uint32_t region) const;
+
+            void Flush(const ParameterSlot& slot, uint32_t region, VkDeviceSize offset, VkDeviceSize size) const;
+
+            [[nodiscard]] uint32_t GetPageCount() const { return (uint32_t)_pages.size(); }
+
+      public:
+            static constexpr uint32_t ElementIndexBits = 16; // packed as (element << 16) | descriptor index in the push constant
+
+            static constexpr VkDeviceSize PageElementBytes = 64 * 1024;
+
+      private:
+            struct Page {
+                  VkBuffer Buffer{};
+                  VmaAllocation Memory{};
+                  uint8_t* MappedPtr{};
+                  VkDeviceSize RegionSize{};
+                  uint32_t Stride{};
+                  uint32_t Capacity{};
+                  uint32_t Used{};
+                  uint32_t Top{};
+                  std::vector<uint32_t> FreeElements{};
+                  std::vector<uint32_t> DescriptorIndex{}; // per region
+            };
+
+            uint32_t CreatePage(uint32_t stride);
+
+      private:
+            std::vector<Page> _pages{};
+
+            entt::dense_map<uint32_t, std::vector<uint32_t>> _pagesByStride{};
+
+            uint32_t _regionCount = 0;
+
+            VkDeviceSize _regionAlignment = 1;
+      };
+}
@@ -0,0 +1,202 @@
+#include "PipelineCache.h"
+#include "BinaryStream.h"
+#include "Message.h"
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <ranges>
+
+#include "../Third/xxHash/xxh3.h"
+
+using namespace LoFi;
+using namespace LoFi::Internal;
+
+PipelineCache::~PipelineCache() {
+      Release();
+}
+
+void PipelineCache::Init(const std::string& directory, const VkPhysicalDeviceProperties& properties) {
+      Release();
+
+      _directory = directory;
+      _properties = properties;
+
+      std::vector<uint8_t> initial_data{};
+      if (!_directory.empty()) {
+            initial_data = LoadCacheData();
+            LoadManifest();
+      }
+
+      const VkPipelineCacheCreateInfo cache_ci{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .initialDataSize = initial_data.size(),
+            .pInitialData = initial_data.empty() ? nullptr : initial_data.data()
+      };
+
+      if (auto res = vkCreatePipelineCache(volkGetLoadedDevice(), &cache_ci, nullptr, &_cache); res != VK_SUCCESS) {
+            const auto err = std::format("PipelineCache::Init - Failed to create pipeline cache, res {}", GetVkResultString(res));
+            MessageManager::Log(MessageType::Error, err);
+            throw std::runtime_error(err);
+      }
+
+      auto str = std::format(R"(PipelineCache::Init - Pipeline cache created with "{}" bytes, "{}" manifest entries)", initial_data.size(), _manifest.size());
+      MessageManager::Log(MessageType::Normal, str);
+}
+
+void PipelineCache::Release() {
+      if (!_cache) return;
+
+      if (!_directory.empty()) {
+            SaveCacheData();
+            SaveManifest();
+      }
+
+      vkDestroyPipelineCache(volkGetLoadedDevice(), _cache, nullptr);
+      _cache = VK_NULL_HANDLE;
+      _manifest.clear();
+      _recorded.clear();
+}
+
+void PipelineCache::Record(uint64_t program_key, PipelineKind kind, const std::vector<uint32_t>& spec_data) {
+      if (program_key == 0) return; // the program did not go through the disk cache, nothing to replay from
+
+      XXH64_state_t state{};
+      XXH64_reset(&state, 0);
+      XXH64_update(&state, &program_key, sizeof(program_key));
+      XXH64_update(&state, &kind, sizeof(kind));
+      XXH64_update(&state, spec_data.data(), spec_data.size() * sizeof(uint32_t));
+      const uint64_t hash = XXH64_digest(&state);
+
+      std::lock_guard lock(_recordMutex);
+      if (!_recorded.contains(hash)) {
+            _recorded.emplace(hash, PipelineManifestEntry{program_key, kind, spec_data});
+      }
+}
+
+std::vector<uint8_t> PipelineCache::LoadCacheData() const {
+      const auto path = std::format("{}/pipeline.lfpl", _directory);
+      std::ifstream file(path, std::ios::binary | std::ios::ate);
+      if (!file) return {};
+
+      std::vector<uint8_t> file_data((size_t)file.tellg());
+      file.seekg(0);
+      file.read((char*)file_data.data(), (std::streamsize)file_data.size());
+      if (!file) return {};
+
+      BinaryReader reader{file_data};
+
+      uint32_t magic = 0, version = 0, vendor_id = 0, device_id = 0, driver_version = 0;
+      std::array<uint8_t, VK_UUID_SIZE> uuid{};
+      uint64_t hash = 0;
+      std::vector<uint8_t> data{};
+      if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(vendor_id) || !reader.Read(device_id) || !reader.Read(driver_version)
+          || !reader.Read(uuid) || !reader.Read(hash) || !reader.ReadVector(data)) {
+            return {};
+      }
+
+      // drivers are supposed to reject foreign data themselves, not all of them do it gracefully
+      if (magic != CacheMagic || version != FormatVersion || vendor_id != _properties.vendorID || device_id != _properties.deviceID
+          || driver_version != _properties.driverVersion || std::memcmp(uuid.data(), _properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            const auto str = std::format("PipelineCache::LoadCacheData - \"{}\" was written by another device or driver, ignored.", path);
+            MessageManager::Log(MessageType::Normal, str);
+            return {};
+      }
+
+      if (hash != XXH64(data.data(), data.size(), 0)) {
+            const auto err = std::format("PipelineCache::LoadCacheData - \"{}\" is corrupted, ignored.", path);
+            MessageManager::Log(MessageType::Warning, err);
+            return {};
+      }
+
+      return data;
+}
+
+void PipelineCache::SaveCacheData() const {
+      size_t size = 0;
+      if (vkGetPipelineCacheData(volkGetLoadedDevice(), _cache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+
+      std::vector<uint8_t> data(size);
+      if (vkGetPipelineCacheData(volkGetLoadedDevice(), _cache, &size, data.data()) != VK_SUCCESS) return;
+      data.resize(size);
+
+      std::array<uint8_t, VK_UUID_SIZE> uuid{};
+      std::memcpy(uuid.data(), _properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+      BinaryWriter writer{};
+      writer.Write(CacheMagic);
+      writer.Write(FormatVersion);
+      writer.Write(_properties.vendorID);
+      writer.Write(_properties.deviceID);
+      writer.Write(_properties.driverVersion);
+      writer.Write(uuid);
+      writer.Write((uint64_t)XXH64(data.data(), data.size(), 0));
+      writer.WriteVector(data);
+
+      WriteFile(std::format("{}/pipeline.lfpl", _directory), writer.GetData());
+}
+
+void PipelineCache::LoadManifest() {
+      const auto path = std::format("{}/pipeline_manifest.lfpm", _directory);
+      std::ifstream file(path, std::ios::binary | std::ios::ate);
+      if (!file) return;
+
+      std::vector<uint8_t> file_data((size_t)file.tellg());
+      file.seekg(0);
+      file.read((char*)file_data.data(), (std::streamsize)file_data.size());
+      if (!file) return;
+
+      BinaryReader reader{file_data};
+
+      uint32_t magic = 0, version = 0, count = 0;
+      if (!reader.Read(magic) || !reader.Read(version) || magic != ManifestMagic || version != FormatVersion || !reader.Read(count)) {
+            return;
+      }
+
+      std::vector<PipelineManifestEntry> entries(count);
+      for (auto& entry : entries) {
+            if (!reader.Read(entry.ProgramKey) || !reader.Read(entry.Kind) || !reader.ReadVector(entry.SpecData)) return;
+      }
+      if (!reader.IsEnd()) return;
+
+      _manifest = std::move(entries);
+}
+
+void PipelineCache::SaveManifest() const {
+      BinaryWriter writer{};
+      writer.Write(ManifestMagic);
+      writer.Write(FormatVersion);
+      writer.Write((uint32_t)_recorded.size());
+      for (const auto& entry : _recorded | std::views::values) {
+            writer.Write(entry.ProgramKey);
+            writer.Write(entry.Kind);
+            writer.WriteVector(entry.SpecData);
+      }
+
+      WriteFile(std::format("{}/pipeline_manifest.lfpm", _directory), writer.GetData());
+}
+
+void PipelineCache::WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+      // write next to the target and rename, a crashed write never leaves a half file under the real name
+      std::error_code ec{};
+      std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+      const auto temp_path = path + ".tmp";
+      {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                  const auto err = std::format("PipelineCache::WriteFile - Failed to open \"{}\" for writing.", temp_path);
+                  MessageManager::Log(MessageType::Warning, err);
+                  return;
+            }
+            file.write((const char*)data.data(), (std::streamsize)data.size());
+      }
+
+      std::filesystem::rename(temp_path, path, ec);
+      if (ec) {
+            const auto err = std::format("PipelineCache::WriteFile - Failed to write \"{}\", {}.", path, ec.message());
+            MessageManager::Log(MessageType::Warning, err);
+      }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Helper.h"
+
+#include <mutex>
+
+namespace LoFi::Internal {
+
+      enum class PipelineKind : uint32_t {
+            Graphics = 0,
+            Compute = 1
+      };
+
+      struct PipelineManifestEntry {
+            uint64_t ProgramKey; // program disk cache key the kernel was built from
+            PipelineKind Kind;
+            std::vector<uint32_t> SpecData{}; // resolved specialization constants, empty for the shader defaults
+      };
+
+      // Owns the VkPipelineCache every kernel is created with. With a directory the cache data is loaded at Init and
+      // written back at Release, guarded by the device's vendor, driver version and pipeline cache UUID. The kernels
+      // created in a session are recorded into a manifest, the next launch can rebuild them before they are needed.
+      class PipelineCache {
+      public:
+            NO_COPY_MOVE_CONS(PipelineCache);
+
+            PipelineCache() = default;
+
+            ~PipelineCache();
+
+            void Init(const std::string& directory, const VkPhysicalDeviceProperties& properties);
+
+            void Release();
+
+            void Record(uint64_t program_key, PipelineKind kind, const std::vector<uint32_t>& spec_data = {});
+
+            [[nodiscard]] VkPipelineCache GetCache() const { return _cache; }
+
+            // entries of the previous session's manifest
+            [[nodiscard]] const std::vector<PipelineManifestEntry>& GetManifest() const { return _manifest; }
+
+      private:
+            static constexpr uint32_t CacheMagic = 0x4C50464C; // "LFPL"
+
+            static constexpr uint32_t ManifestMagic = 0x4D50464C; // "LFPM"
+
+            static constexpr uint32_t FormatVersion = 2;
+
+            std::vector<uint8_t> LoadCacheData() const;
+
+            void SaveCacheData() const;
+
+            void LoadManifest();
+
+            void SaveManifest() const;
+
+            static void WriteFile(const std::string& path, const std::vector<uint8_t>& data);
+
+      private:
+            VkPipelineCache _cache{};
+
+            std::string _directory{};
+
+            VkPhysicalDeviceProperties _properties{};
+
+            std::vector<PipelineManifestEntry> _manifest{};
+
+            std::mutex _recordMutex{};
+
+            entt::dense_map<uint64_t, PipelineManifestEntry> _recorded{}; // by hash of the whole entry
+      };
+}
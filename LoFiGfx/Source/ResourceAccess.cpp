@@ -0,0 +1,256 @@
+#include "ResourceAccess.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace LoFi;
+using namespace LoFi::Internal;
+
+static constexpr VkAccessFlags2 WriteAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+bool LoFi::Internal::IsWriteAccess(VkAccessFlags2 access) {
+      return (access & WriteAccessMask) != 0;
+}
+
+ImageLayoutAccess LoFi::Internal::GetImageLayoutAccess(VkImageLayout layout) {
+      switch (layout) {
+            case VK_IMAGE_LAYOUT_UNDEFINED:
+                  return {};
+
+            case VK_IMAGE_LAYOUT_PREINITIALIZED:
+                  return {VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_WRITE_BIT, VK_ACCESS_2_HOST_WRITE_BIT};
+
+            case VK_IMAGE_LAYOUT_GENERAL: // storage images of compute kernels
+                  return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+
+            case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+                  return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT};
+
+            case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            case VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL:
+            case VK_IMAGE_LAYOUT_STENCIL_ATTACHMENT_OPTIMAL:
+                  return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+
+            case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+            case VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL:
+            case VK_IMAGE_LAYOUT_STENCIL_READ_ONLY_OPTIMAL:
+                  return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_NONE,
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT};
+
+            case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+                  return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT};
+
+            case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+                  return {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_READ_BIT};
+
+            case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+                  return {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT};
+
+            case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+                  // the acquire semaphore is waited at this stage, a transition out of present has to chain onto it,
+                  // the present itself waits on a semaphore signaled after every command
+                  return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_NONE};
+
+            default:
+                  return {VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT};
+      }
+}
+
+void BarrierBatcher::Buffer(VkBuffer buffer, ResourceAccessState& state, VkPipelineStageFlags2 stage, VkAccessFlags2 access) {
+      VkPipelineStageFlags2 src_stage{};
+      VkAccessFlags2 src_access{};
+      if (!ResolveHazard(state, false, stage, access, src_stage, src_access)) return;
+
+      // a buffer hit twice by one command keeps one barrier carrying both sides
+      const auto merged = std::ranges::find_if(_bufferBarriers, [&](const auto& i) { return i.buffer == buffer; });
+      if (merged != _bufferBarriers.end()) {
+            merged->srcStageMask |= src_stage;
+            merged->srcAccessMask |= src_access;
+            merged->dstStageMask |= stage;
+            merged->dstAccessMask |= access;
+            return;
+      }
+
+      _bufferBarriers.push_back(VkBufferMemoryBarrier2{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+            .srcStageMask = src_stage,
+            .srcAccessMask = src_access,
+            .dstStageMask = stage,
+            .dstAccessMask = access,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+      });
+}
+
+void BarrierBatcher::Image(VkImage image, ImageSubresourceStates& states, const VkImageSubresourceRange& range, VkImageLayout new_layout,
+      VkPipelineStageFlags2 stage, VkAccessFlags2 access, bool discard) {
+      states.Update(range, [&](const VkImageSubresourceRange& part, SubresourceState& state) {
+            VkPipelineStageFlags2 src_stage{};
+            VkAccessFlags2 src_access{};
+            const bool layout_changed = state.Layout != new_layout;
+            if (!ResolveHazard(state.Access, layout_changed, stage, access, src_stage, src_access)) return;
+
+            Transition(image, part, discard && layout_changed ? VK_IMAGE_LAYOUT_UNDEFINED : state.Layout, new_layout, src_stage, src_access, stage, access);
+            state.Layout = new_layout;
+      });
+}
+
+static bool IsRangeOverlapping(const VkImageSubresourceRange& a, const VkImageSubresourceRange& b) {
+      return (a.aspectMask & b.aspectMask) != 0 &&
+             a.baseMipLevel < b.baseMipLevel + b.levelCount && b.baseMipLevel < a.baseMipLevel + a.levelCount &&
+             a.baseArrayLayer < b.baseArrayLayer + b.layerCount && b.baseArrayLayer < a.baseArrayLayer + a.layerCount;
+}
+
+void BarrierBatcher::Transition(VkImage image, const VkImageSubresourceRange& range, VkImageLayout old_layout, VkImageLayout new_layout,
+      VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+      const auto overlapping = std::ranges::find_if(_imageBarriers, [&](const auto& i) {
+            return i.image == image && IsRangeOverlapping(i.subresourceRange, range);
+      });
+
+      if (overlapping != _imageBarriers.end()) {
+            if (std::memcmp(&overlapping->subresourceRange, &range, sizeof(VkImageSubresourceRange)) == 0) {
+                  // nothing was recorded in between, so one transition from the first old layout to the last new one does both
+                  overlapping->srcStageMask |= src_stage;
+                  overlapping->srcAccessMask |= src_access;
+                  overlapping->dstStageMask |= dst_stage;
+                  overlapping->dstAccessMask |= dst_access;
+                  overlapping->newLayout = new_layout;
+                  return;
+            }
+            Flush(_commandBuffer);
+      }
+
+      _imageBarriers.push_back(VkImageMemoryBarrier2{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .srcStageMask = src_stage,
+            .srcAccessMask = src_access,
+            .dstStageMask = dst_stage,
+            .dstAccessMask = dst_access,
+            .oldLayout = old_layout,
+            .newLayout = new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = range
+      });
+}
+
+void ImageSubresourceStates::Init(uint32_t mip_levels, uint32_t array_layers, VkImageLayout layout) {
+      _mipLevels = std::max(mip_levels, 1u);
+      _arrayLayers = std::max(array_layers, 1u);
+      _runs.clear();
+      _runs.push_back(Run{_mipLevels * _arrayLayers, SubresourceState{.Layout = layout}});
+}
+
+const SubresourceState& ImageSubresourceStates::Get(uint32_t mip, uint32_t layer) const {
+      return _runs[FindRun(mip * _arrayLayers + layer)].State;
+}
+
+VkImageSubresourceRange ImageSubresourceStates::Resolve(const VkImageSubresourceRange& range) const {
+      auto resolved = range;
+      resolved.baseMipLevel = std::min(range.baseMipLevel, _mipLevels - 1);
+      resolved.baseArrayLayer = std::min(range.baseArrayLayer, _arrayLayers - 1);
+      resolved.levelCount = std::min(range.levelCount, _mipLevels - resolved.baseMipLevel);
+      resolved.layerCount = std::min(range.layerCount, _arrayLayers - resolved.baseArrayLayer);
+      return resolved;
+}
+
+std::optional<SubresourceState> ImageSubresourceStates::GetUniform(const VkImageSubresourceRange& range) const {
+      const SubresourceState* uniform = nullptr;
+      for (uint32_t mip = range.baseMipLevel; mip < range.baseMipLevel + range.levelCount; mip++) {
+            const uint32_t begin = mip * _arrayLayers + range.baseArrayLayer;
+            const auto& run = _runs[FindRun(begin)];
+            if (run.End < begin + range.layerCount) return std::nullopt;
+            if (uniform && *uniform != run.State) return std::nullopt;
+            uniform = &run.State;
+      }
+      if (!uniform) return std::nullopt;
+      return *uniform;
+}
+
+uint32_t ImageSubresourceStates::FindRun(uint32_t index) const {
+      const auto run = std::ranges::upper_bound(_runs, index, {}, &Run::End);
+      return (uint32_t)std::distance(_runs.begin(), run);
+}
+
+void ImageSubresourceStates::Assign(uint32_t begin, uint32_t end, const SubresourceState& state) {
+      std::vector<Run> runs{};
+      runs.reserve(_runs.size() + 2);
+
+      const auto push = [&](uint32_t run_end, const SubresourceState& run_state) {
+            if (!runs.empty() && runs.back().State == run_state) {
+                  runs.back().End = run_end;
+            } else {
+                  runs.push_back(Run{run_end, run_state});
+            }
+      };
+
+      uint32_t run_begin = 0;
+      bool assigned = false;
+      for (const auto& run : _runs) {
+            if (run.End <= begin || run_begin >= end) {
+                  push(run.End, run.State);
+            } else {
+                  if (run_begin < begin) push(begin, run.State);
+                  if (!assigned) push(end, state);
+                  assigned = true;
+                  if (run.End > end) push(run.End, run.State);
+            }
+            run_begin = run.End;
+      }
+
+      _runs = std::move(runs);
+}
+
+void BarrierBatcher::Flush(VkCommandBuffer cmd) {
+      if (IsEmpty()) return;
+
+      const VkDependencyInfo info{
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .bufferMemoryBarrierCount = (uint32_t)_bufferBarriers.size(),
+            .pBufferMemoryBarriers = _bufferBarriers.data(),
+            .imageMemoryBarrierCount = (uint32_t)_imageBarriers.size(),
+            .pImageMemoryBarriers = _imageBarriers.data()
+      };
+      vkCmdPipelineBarrier2(cmd, &info);
+
+      _bufferBarriers.clear();
+      _imageBarriers.clear();
+}
+
+bool BarrierBatcher::ResolveHazard(ResourceAccessState& state, bool layout_changed, VkPipelineStageFlags2 stage, VkAccessFlags2 access,
+      VkPipelineStageFlags2& src_stage, VkAccessFlags2& src_access) {
+      src_stage = VK_PIPELINE_STAGE_2_NONE;
+      src_access = VK_ACCESS_2_NONE;
+
+      if (IsWriteAccess(access) || layout_changed) {
+            // a layout transition writes the image, it waits for every earlier access like a write does
+            src_stage = state.WriteStage | state.ReadStages;
+            src_access = state.WriteAccess;
+            const bool hazard = layout_changed || src_stage != VK_PIPELINE_STAGE_2_NONE;
+
+            if (IsWriteAccess(access)) {
+                  state = ResourceAccessState{.WriteStage = stage, .WriteAccess = access & WriteAccessMask};
+            } else {
+                  // transitioned for reading, readers in other stages still have to wait for the stages it was made visible to
+                  state = ResourceAccessState{.WriteStage = stage, .ReadStages = stage, .VisibleStages = stage, .VisibleAccess = access};
+            }
+            return hazard;
+      }
+
+      // read after read, or a read the last write was already made visible to
+      state.ReadStages |= stage;
+      if (state.WriteStage == VK_PIPELINE_STAGE_2_NONE) return false;
+      if ((stage & ~state.VisibleStages) == 0 && (access & ~state.VisibleAccess) == 0) return false;
+
+      src_stage = state.WriteStage;
+      src_access = state.WriteAccess;
+      state.VisibleStages |= stage;
+      state.VisibleAccess |= access;
+      return true;
+}
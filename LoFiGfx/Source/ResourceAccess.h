@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Helper.h"
+
+#include <algorithm>
+
+namespace LoFi::Internal {
+
+      // Last write to a resource and what has happened to it since, enough to tell a read after write, write after read
+      // or write after write hazard from a read after read, which needs no barrier at all.
+      struct ResourceAccessState {
+            VkPipelineStageFlags2 WriteStage = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 WriteAccess = VK_ACCESS_2_NONE;
+            VkPipelineStageFlags2 ReadStages = VK_PIPELINE_STAGE_2_NONE; // readers since the last write, the next write waits for them
+            VkPipelineStageFlags2 VisibleStages = VK_PIPELINE_STAGE_2_NONE; // the last write was made visible to these stages and accesses
+            VkAccessFlags2 VisibleAccess = VK_ACCESS_2_NONE;
+
+            bool operator==(const ResourceAccessState&) const = default;
+      };
+
+      struct SubresourceState {
+            VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            ResourceAccessState Access{};
+
+            bool operator==(const SubresourceState&) const = default;
+      };
+
+      // Layout and access state of every (mip, layer) of an image, run length encoded over mip major subresource indices,
+      // so an image that is used as a whole keeps a single run.
+      class ImageSubresourceStates {
+      public:
+            void Init(uint32_t mip_levels, uint32_t array_layers, VkImageLayout layout);
+
+            [[nodiscard]] const SubresourceState& Get(uint32_t mip, uint32_t layer) const;
+
+            [[nodiscard]] uint32_t GetRunCount() const { return (uint32_t)_runs.size(); }
+
+            // Resolves VK_REMAINING_MIP_LEVELS / VK_REMAINING_ARRAY_LAYERS against the image.
+            [[nodiscard]] VkImageSubresourceRange Resolve(const VkImageSubresourceRange& range) const;
+
+            // Splits the range into parts of one state, fn(part, state) may change the state of its part. A range that
+            // is uniform is a single part, otherwise parts never cross a mip level.
+            template <class Fn>
+            void Update(const VkImageSubresourceRange& range, Fn&& fn) {
+                  const auto resolved = Resolve(range);
+
+                  if (const auto uniform = GetUniform(resolved)) {
+                        auto state = *uniform;
+                        fn(resolved, state);
+                        if (state != *uniform) {
+                              for (uint32_t mip = resolved.baseMipLevel; mip < resolved.baseMipLevel + resolved.levelCount; mip++) {
+                                    const uint32_t begin = mip * _arrayLayers + resolved.baseArrayLayer;
+                                    Assign(begin, begin + resolved.layerCount, state);
+                              }
+                        }
+                        return;
+                  }
+
+                  for (uint32_t mip = resolved.baseMipLevel; mip < resolved.baseMipLevel + resolved.levelCount; mip++) {
+                        uint32_t index = mip * _arrayLayers + resolved.baseArrayLayer;
+                        const uint32_t end = index + resolved.layerCount;
+                        while (index < end) {
+                              const auto& run = _runs[FindRun(index)];
+                              const uint32_t part_end = std::min(end, run.End);
+                              const VkImageSubresourceRange part{resolved.aspectMask, mip, 1, index - mip * _arrayLayers, part_end - index};
+
+                              auto state = run.State;
+                              fn(part, state);
+                              if (state != run.State) {
+                                    Assign(index, part_end, state);
+                              }
+                              index = part_end;
+                        }
+                  }
+            }
+
+      private:
+            [[nodiscard]] std::optional<SubresourceState> GetUniform(const VkImageSubresourceRange& range) const;
+
+            [[nodiscard]] uint32_t FindRun(uint32_t index) const;
+
+            void Assign(uint32_t begin, uint32_t end, const SubresourceState& state);
+
+      private:
+            struct Run {
+                  uint32_t End; // covers [End of the previous run, End)
+                  SubresourceState State;
+            };
+
+            std::vector<Run> _runs{};
+
+            uint32_t _mipLevels = 1;
+
+            uint32_t _arrayLayers = 1;
+      };
+
+      // Stages an image in a layout is used by, the writes a transition out of it has to make available and the
+      // accesses a transition into it makes visible.
+      struct ImageLayoutAccess {
+            VkPipelineStageFlags2 Stage = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 WriteAccess = VK_ACCESS_2_NONE;
+            VkAccessFlags2 Access = VK_ACCESS_2_NONE;
+      };
+
+      bool IsWriteAccess(VkAccessFlags2 access);
+
+      ImageLayoutAccess GetImageLayoutAccess(VkImageLayout layout);
+
+      // Collects the barriers the next command needs and records them as one vkCmdPipelineBarrier2.
+      class BarrierBatcher {
+      public:
+            NO_COPY_MOVE_CONS(BarrierBatcher);
+
+            BarrierBatcher() = default;
+
+            // Adds a barrier only when the access hazards with the state, the state then describes this access.
+            void Buffer(VkBuffer buffer, ResourceAccessState& state, VkPipelineStageFlags2 stage, VkAccessFlags2 access);
+
+            // Only the subresources of the range whose layout changes or that hazard get a barrier. discard transitions
+            // from undefined, for attachments that are cleared anyway.
+            void Image(VkImage image, ImageSubresourceStates& states, const VkImageSubresourceRange& range, VkImageLayout new_layout,
+                  VkPipelineStageFlags2 stage, VkAccessFlags2 access, bool discard = false);
+
+            // An untracked transition with both sides given. Barriers inside one vkCmdPipelineBarrier2 have no order among
+            // themselves, so a transition of the same subresources is merged and one of overlapping ones flushes first.
+            void Transition(VkImage image, const VkImageSubresourceRange& range, VkImageLayout old_layout, VkImageLayout new_layout,
+                  VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access);
+
+            void Begin(VkCommandBuffer cmd) { _commandBuffer = cmd; } // the command buffer an overlapping transition flushes into
+
+            void Flush(VkCommandBuffer cmd);
+
+            [[nodiscard]] bool IsEmpty() const { return _bufferBarriers.empty() && _imageBarriers.empty(); }
+
+      private:
+            static bool ResolveHazard(ResourceAccessState& state, bool layout_changed, VkPipelineStageFlags2 stage, VkAccessFlags2 access,
+                  VkPipelineStageFlags2& src_stage, VkAccessFlags2& src_access);
+
+      private:
+            std::vector<VkBufferMemoryBarrier2> _bufferBarriers{};
+
+            std::vector<VkImageMemoryBarrier2> _imageBarriers{};
+
+            VkCommandBuffer _commandBuffer{};
+      };
+}
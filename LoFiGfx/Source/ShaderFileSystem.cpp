@@ -0,0 +1,86 @@
+#include "ShaderFileSystem.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "../Third/xxHash/xxh3.h"
+
+using namespace LoFi::Internal;
+
+void ShaderFileSystem::AddSearchPath(const std::string& directory) {
+      std::lock_guard lock(_mutex);
+      _searchPaths.push_back(Normalize(directory));
+}
+
+void ShaderFileSystem::AddVirtualFile(const std::string& path, std::string source) {
+      auto normalized = Normalize(path);
+      auto file = MakeFile(normalized, std::move(source), {});
+
+      std::lock_guard lock(_mutex);
+      _virtualFiles[std::move(normalized)] = std::move(file);
+}
+
+std::shared_ptr<const ShaderFile> ShaderFileSystem::Load(std::string_view path, std::string_view including_file) {
+      std::lock_guard lock(_mutex);
+
+      const std::filesystem::path request{path};
+
+      std::vector<std::string> candidates{};
+      if (!including_file.empty() && request.is_relative()) {
+            candidates.push_back(Normalize(std::filesystem::path(including_file).parent_path() / request));
+      }
+      candidates.push_back(Normalize(request));
+      if (request.is_relative()) {
+            for (const auto& search_path : _searchPaths) {
+                  candidates.push_back(Normalize(std::filesystem::path(search_path) / request));
+            }
+      }
+
+      for (const auto& candidate : candidates) {
+            if (const auto finder = _virtualFiles.find(candidate); finder != _virtualFiles.end()) {
+                  return finder->second;
+            }
+      }
+
+      for (const auto& candidate : candidates) {
+            if (auto file = LoadFromDisk(candidate)) {
+                  return file;
+            }
+      }
+
+      return nullptr;
+}
+
+std::string ShaderFileSystem::Normalize(const std::filesystem::path& path) {
+      return path.lexically_normal().generic_string();
+}
+
+std::shared_ptr<ShaderFile> ShaderFileSystem::MakeFile(std::string path, std::string source, std::filesystem::file_time_type write_time) {
+      auto file = std::make_shared<ShaderFile>();
+      file->Path = std::move(path);
+      file->Source = std::move(source);
+      file->Hash = XXH3_64bits(file->Source.data(), file->Source.size());
+      file->Tokens = ShaderLexer::Tokenize(file->Source); // Source is never touched again, the views stay valid
+      file->WriteTime = write_time;
+      return file;
+}
+
+std::shared_ptr<const ShaderFile> ShaderFileSystem::LoadFromDisk(const std::string& path) {
+      std::error_code ec{};
+      const auto write_time = std::filesystem::last_write_time(path, ec);
+      if (ec) return nullptr;
+
+      if (const auto finder = _diskFiles.find(path); finder != _diskFiles.end() && finder->second->WriteTime == write_time) {
+            return finder->second;
+      }
+
+      std::ifstream stream(path, std::ios::binary);
+      if (!stream) return nullptr;
+
+      std::stringstream ss;
+      ss << stream.rdbuf();
+
+      auto file = MakeFile(path, ss.str(), write_time);
+      _diskFiles[path] = file;
+      return file;
+}
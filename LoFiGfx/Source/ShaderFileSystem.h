@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Helper.h"
+#include "ShaderLexer.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+namespace LoFi::Internal {
+
+      struct ShaderFile {
+            std::string Path; // normalized, the include identity
+            std::string Source;
+            uint64_t Hash; // XXH3 of Source
+            std::vector<ShaderToken> Tokens; // views into Source
+            std::filesystem::file_time_type WriteTime{}; // default for virtual files
+      };
+
+      // Resolves "#include" paths against virtual files first, then the including file's directory and the search paths.
+      // A file is read, hashed and tokenized once and shared until its write time changes, compiles on other threads
+      // keep the old version alive through their shared_ptr.
+      class ShaderFileSystem {
+      public:
+            NO_COPY_MOVE_CONS(ShaderFileSystem);
+
+            ShaderFileSystem() = default;
+
+            void AddSearchPath(const std::string& directory);
+
+            void AddVirtualFile(const std::string& path, std::string source);
+
+            // nullptr when the path can't be resolved, including_file may be empty for a root source
+            [[nodiscard]] std::shared_ptr<const ShaderFile> Load(std::string_view path, std::string_view including_file);
+
+      private:
+            static std::string Normalize(const std::filesystem::path& path);
+
+            static std::shared_ptr<ShaderFile> MakeFile(std::string path, std::string source, std::filesystem::file_time_type write_time);
+
+            std::shared_ptr<const ShaderFile> LoadFromDisk(const std::string& path);
+
+      private:
+            std::mutex _mutex{};
+
+            std::vector<std::string> _searchPaths{};
+
+            entt::dense_map<std::string, std::shared_ptr<const ShaderFile>> _virtualFiles{};
+
+            entt::dense_map<std::string, std::shared_ptr<const ShaderFile>> _diskFiles{};
+      };
+}
@@ -0,0 +1,85 @@
+#include "ShaderLexer.h"
+
+#include <algorithm>
+
+using namespace LoFi::Internal;
+
+static bool IsIdentifierStart(char c) {
+      return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool IsIdentifierChar(char c) {
+      return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+std::vector<ShaderToken> ShaderLexer::Tokenize(std::string_view source) {
+      std::vector<ShaderToken> tokens{};
+      tokens.reserve(source.size() / 4);
+
+      uint32_t line = 1;
+      bool line_start = true; // only whitespace since the last newline, a '#' here opens a directive
+      size_t pos = 0;
+
+      while (pos < source.size()) {
+            const size_t begin = pos;
+            const uint32_t begin_line = line;
+            const char c = source[pos];
+            ShaderTokenType type;
+
+            if (c == '\n') {
+                  type = ShaderTokenType::Newline;
+                  pos++;
+                  line++;
+                  line_start = true;
+            } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+                  type = ShaderTokenType::Whitespace;
+                  while (pos < source.size() && (source[pos] == ' ' || source[pos] == '\t' || source[pos] == '\r' || source[pos] == '\f' || source[pos] == '\v')) pos++;
+            } else if (c == '/' && pos + 1 < source.size() && source[pos + 1] == '/') {
+                  type = ShaderTokenType::Comment;
+                  pos = std::min(source.find('\n', pos), source.size());
+            } else if (c == '/' && pos + 1 < source.size() && source[pos + 1] == '*') {
+                  type = ShaderTokenType::Comment;
+                  const auto end = source.find("*/", pos + 2);
+                  pos = end == std::string_view::npos ? source.size() : end + 2;
+                  line += (uint32_t)std::count(source.begin() + (ptrdiff_t)begin, source.begin() + (ptrdiff_t)pos, '\n');
+            } else if (c == '#' && line_start) {
+                  // a trailing line comment stays part of the directive, "#set" strips it itself
+                  type = ShaderTokenType::Directive;
+                  while (pos < source.size() && source[pos] != '\n') {
+                        if (source[pos] == '\\' && pos + 1 < source.size() && source[pos + 1] == '\n') {
+                              pos += 2;
+                              line++;
+                        } else {
+                              pos++;
+                        }
+                  }
+            } else if (IsIdentifierStart(c)) {
+                  type = ShaderTokenType::Identifier;
+                  while (pos < source.size() && IsIdentifierChar(source[pos])) pos++;
+            } else if ((c >= '0' && c <= '9') || (c == '.' && pos + 1 < source.size() && source[pos + 1] >= '0' && source[pos + 1] <= '9')) {
+                  type = ShaderTokenType::Number;
+                  pos++;
+                  while (pos < source.size()) {
+                        const char n = source[pos];
+                        const bool exponent_sign = (n == '+' || n == '-') && (source[pos - 1] == 'e' || source[pos - 1] == 'E') && source.substr(begin, 2) != "0x";
+                        if (IsIdentifierChar(n) || n == '.' || exponent_sign) { pos++; } else { break; }
+                  }
+            } else {
+                  type = ShaderTokenType::Punctuator;
+                  pos++;
+            }
+
+            if (type != ShaderTokenType::Whitespace && type != ShaderTokenType::Newline) {
+                  line_start = false;
+            }
+
+            tokens.push_back(ShaderToken{type, begin_line, source.substr(begin, pos - begin)});
+      }
+
+      return tokens;
+}
+
+size_t ShaderLexer::SkipTrivia(const std::vector<ShaderToken>& tokens, size_t index) {
+      while (index < tokens.size() && IsTrivia(tokens[index])) index++;
+      return index;
+}
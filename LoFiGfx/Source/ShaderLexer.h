@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Helper.h"
+
+namespace LoFi::Internal {
+
+      enum class ShaderTokenType : uint8_t {
+            Identifier,
+            Number,
+            Punctuator, // single character
+            Directive, // "#..." up to the end of its line
+            Comment,
+            Whitespace,
+            Newline
+      };
+
+      struct ShaderToken {
+            ShaderTokenType Type;
+            uint32_t Line; // 1 based
+            std::string_view Text; // view into the tokenized source
+      };
+
+      // Splits GLSL source in one pass. Concatenating every token's text gives back the source, so a front-end can
+      // rewrite some tokens and copy the rest verbatim, keywords inside comments or longer identifiers never match.
+      class ShaderLexer {
+      public:
+            [[nodiscard]] static std::vector<ShaderToken> Tokenize(std::string_view source);
+
+            [[nodiscard]] static bool IsTrivia(const ShaderToken& token) {
+                  return token.Type == ShaderTokenType::Whitespace || token.Type == ShaderTokenType::Newline || token.Type == ShaderTokenType::Comment;
+            }
+
+            // index of the first non trivia token at or after index, tokens.size() when there is none
+            [[nodiscard]] static size_t SkipTrivia(const std::vector<ShaderToken>& tokens, size_t index);
+      };
+}
@@ -0,0 +1,100 @@
+#include "ThreadPool.h"
+
+using namespace LoFi;
+using namespace LoFi::Internal;
+
+ThreadPool::~ThreadPool() {
+      Release();
+}
+
+void ThreadPool::Init(uint32_t thread_count) {
+      Release();
+
+      if (thread_count == 0) {
+            thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+      }
+
+      _stop = false;
+      for (uint32_t i = 0; i < thread_count; i++) {
+            _workers.emplace_back(&ThreadPool::WorkerLoop, this);
+      }
+}
+
+void ThreadPool::Release() {
+      _stop = true;
+      for (auto& worker : _workers) {
+            worker.join();
+      }
+      _workers.clear();
+
+      // run what is left on this thread so no submitted task outlives the pool
+      std::function<void()> task{};
+      while (_tasks.try_dequeue(task)) {
+            task();
+      }
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& fn) {
+      if (count == 0) return;
+
+      if (_workers.empty() || count == 1) {
+            for (uint32_t i = 0; i < count; i++) {
+                  fn(i);
+            }
+            return;
+      }
+
+      std::atomic<uint32_t> remaining = count;
+      std::exception_ptr exception{};
+      std::mutex exception_mutex{};
+
+      auto run = [&](uint32_t i) {
+            try {
+                  fn(i);
+            } catch (...) {
+                  std::lock_guard lock(exception_mutex);
+                  if (!exception) exception = std::current_exception();
+            }
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+      };
+
+      for (uint32_t i = 1; i < count; i++) {
+            _tasks.enqueue([&run, i] { run(i); });
+      }
+
+      run(0);
+
+      while (remaining.load(std::memory_order_acquire) != 0) {
+            if (!RunOne()) {
+                  std::this_thread::yield();
+            }
+      }
+
+      if (exception) {
+            std::rethrow_exception(exception);
+      }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+      if (_workers.empty()) {
+            task();
+            return;
+      }
+      _tasks.enqueue(std::move(task));
+}
+
+bool ThreadPool::RunOne() {
+      std::function<void()> task{};
+      if (!_tasks.try_dequeue(task)) return false;
+      task();
+      return true;
+}
+
+void ThreadPool::WorkerLoop() {
+      std::function<void()> task{};
+      while (!_stop.load(std::memory_order_relaxed)) {
+            if (_tasks.wait_dequeue_timed(task, std::chrono::milliseconds(10))) {
+                  task();
+            }
+      }
+}
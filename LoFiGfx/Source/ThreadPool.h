@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Helper.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "Concurrent/blockingconcurrentqueue.h"
+
+namespace LoFi::Internal {
+
+      // Shared by a submitted task and the thread polling it, Succeeded is only meaningful once Done reads true.
+      struct AsyncJob {
+            std::atomic<bool> Done = false;
+            bool Succeeded = false;
+      };
+
+      // Fixed worker threads fed by one lock free queue. A thread waiting in ParallelFor keeps running queued
+      // tasks, so a task may start a nested ParallelFor without starving the pool.
+      class ThreadPool {
+      public:
+            NO_COPY_MOVE_CONS(ThreadPool);
+
+            ThreadPool() = default;
+
+            ~ThreadPool();
+
+            void Init(uint32_t thread_count = 0); // 0 uses every hardware thread but the caller's
+
+            void Release();
+
+            // Runs fn(0 .. count - 1) on the pool and the calling thread, returns once all have finished,
+            // the first exception thrown by a task is rethrown here.
+            void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& fn);
+
+            // Queued for any worker, runs inline when the pool has no threads.
+            void Submit(std::function<void()> task);
+
+            // Runs one queued task on the calling thread, false if the queue was empty.
+            bool RunOne();
+
+            [[nodiscard]] uint32_t GetThreadCount() const { return (uint32_t)_workers.size(); }
+
+      private:
+
+            void WorkerLoop();
+
+      private:
+            moodycamel::BlockingConcurrentQueue<std::function<void()>> _tasks{};
+
+            std::vector<std::thread> _workers{};
+
+            std::atomic<bool> _stop = false;
+      };
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <iostream>
+
+// minimal checks for the device free unit tests, each test executable returns the failure count to ctest
+namespace LoFi::Test {
+      inline int Failures = 0;
+}
+
+#define LOFI_CHECK(expr) \
+do { \
+      if (!(expr)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << " LOFI_CHECK(" #expr ") failed\n"; \
+            LoFi::Test::Failures++; \
+      } \
+} while (0)
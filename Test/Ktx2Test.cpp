@@ -0,0 +1,122 @@
+#include "Check.h"
+
+#include "BinaryStream.h"
+#include "Ktx2.h"
+
+#include <array>
+
+using namespace LoFi::Internal;
+
+// a KTX2 file with the given level index and zeroed level data right after it, level_sizes.size() index entries are
+// written whatever level_count says
+static std::vector<uint8_t> MakeKtx2(VkFormat format, uint32_t w, uint32_t h, uint32_t level_count, const std::vector<uint64_t>& level_sizes) {
+      constexpr std::array<uint8_t, 12> identifier = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+      BinaryWriter writer{};
+      writer.Write(identifier);
+      writer.Write((uint32_t)format);
+      writer.Write(1u); // typeSize
+      writer.Write(w);
+      writer.Write(h);
+      writer.Write(0u); // pixelDepth
+      writer.Write(0u); // layerCount
+      writer.Write(1u); // faceCount
+      writer.Write(level_count);
+      writer.Write(0u); // supercompressionScheme
+      for (uint32_t i = 0; i < 4; i++) writer.Write(0u); // dfd and kvd
+      writer.Write((uint64_t)0); // sgd
+      writer.Write((uint64_t)0);
+
+      uint64_t offset = 80 + level_sizes.size() * 24;
+      for (const auto size : level_sizes) {
+            writer.Write(offset);
+            writer.Write(size);
+            writer.Write(size);
+            offset += size;
+      }
+
+      auto data = writer.GetData();
+      data.resize(offset);
+      return data;
+}
+
+static void TestLevelSize() {
+      // uncompressed formats are texel exact
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_R8G8B8A8_UNORM, 5, 3) == 60);
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_R32G32B32A32_SFLOAT, 1, 1) == 16);
+
+      // partial blocks at the edges still take a whole 4x4 block
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 5, 5) == 2 * 2 * 8);
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_BC1_RGB_UNORM_BLOCK, 1, 1) == 8);
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_BC3_UNORM_BLOCK, 6, 2) == 2 * 1 * 16);
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_BC7_SRGB_BLOCK, 2, 2) == 16);
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, 3, 9) == 1 * 3 * 8);
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, 4, 4) == 16);
+      LOFI_CHECK(GetFormatLevelSize(VK_FORMAT_EAC_R11G11_UNORM_BLOCK, 17, 1) == 5 * 1 * 16);
+}
+
+static void TestParse() {
+      std::string error{};
+
+      const auto rgba = MakeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 3, {64, 16, 4});
+      const auto image = ParseKtx2(rgba, error);
+      LOFI_CHECK(image.has_value());
+      if (image) {
+            LOFI_CHECK(image->Format == VK_FORMAT_R8G8B8A8_UNORM);
+            LOFI_CHECK(image->Width == 4 && image->Height == 4);
+            LOFI_CHECK(!image->GenerateMips);
+            LOFI_CHECK(image->Levels.size() == 3);
+            LOFI_CHECK(image->Levels.size() == 3 && image->Levels[0].Offset == 80 + 3 * 24 && image->Levels[2].Size == 4);
+      }
+
+      // the 1x1 and 2x2 levels of a BC1 chain are one block each
+      const auto bc1 = MakeKtx2(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 8, 8, 4, {32, 8, 8, 8});
+      LOFI_CHECK(ParseKtx2(bc1, error).has_value());
+
+      // no levels asks for generated mips, mip 0 is still stored
+      const auto generate = MakeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 2, 0, {32});
+      const auto generated = ParseKtx2(generate, error);
+      LOFI_CHECK(generated.has_value() && generated->GenerateMips && generated->Levels.size() == 1);
+}
+
+static void TestRejected() {
+      std::string error{};
+
+      // the header alone, without any index
+      auto header_only = MakeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 1, {64});
+      header_only.resize(80);
+      LOFI_CHECK(!ParseKtx2(header_only, error).has_value());
+      LOFI_CHECK(error == "truncated level index");
+
+      // two levels announced, the file ends after the first entry, whose data is moved inside the file to pass its checks
+      auto truncated = MakeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 2, {64});
+      const uint64_t inside = 0;
+      std::memcpy(truncated.data() + 80, &inside, sizeof(inside));
+      truncated.resize(80 + 24);
+      LOFI_CHECK(!ParseKtx2(truncated, error).has_value());
+      LOFI_CHECK(error == "truncated level index");
+
+      // level data past the end of the file
+      auto short_data = MakeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 1, {64});
+      short_data.resize(short_data.size() - 1);
+      LOFI_CHECK(!ParseKtx2(short_data, error).has_value());
+
+      // a level whose size doesn't match its extent, BC1 4x4 is one 8 byte block
+      LOFI_CHECK(!ParseKtx2(MakeKtx2(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 4, 1, {16}), error).has_value());
+
+      // more levels than a 4x4 chain has
+      LOFI_CHECK(!ParseKtx2(MakeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 4, {64, 16, 4, 4}), error).has_value());
+
+      LOFI_CHECK(!ParseKtx2(MakeKtx2(VK_FORMAT_UNDEFINED, 4, 4, 1, {64}), error).has_value());
+
+      const std::vector<uint8_t> not_ktx(100, 0);
+      LOFI_CHECK(!ParseKtx2(not_ktx, error).has_value());
+      LOFI_CHECK(error == "not a KTX2 file");
+}
+
+int main() {
+      TestLevelSize();
+      TestParse();
+      TestRejected();
+      return LoFi::Test::Failures;
+}
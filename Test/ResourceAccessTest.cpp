@@ -0,0 +1,103 @@
+#include "Check.h"
+
+#include "ResourceAccess.h"
+
+using namespace LoFi::Internal;
+
+static VkImageSubresourceRange Range(uint32_t mip, uint32_t mip_count, uint32_t layer, uint32_t layer_count) {
+      return VkImageSubresourceRange{VK_IMAGE_ASPECT_COLOR_BIT, mip, mip_count, layer, layer_count};
+}
+
+static void SetLayout(ImageSubresourceStates& states, const VkImageSubresourceRange& range, VkImageLayout layout) {
+      states.Update(range, [&](const VkImageSubresourceRange&, SubresourceState& state) { state.Layout = layout; });
+}
+
+// 4 mips of 2 layers, subresource index mip * 2 + layer
+static void TestSplitAndMerge() {
+      ImageSubresourceStates states{};
+      states.Init(4, 2, VK_IMAGE_LAYOUT_UNDEFINED);
+      LOFI_CHECK(states.GetRunCount() == 1);
+
+      // a whole mip in the middle splits the single run in three
+      SetLayout(states, Range(1, 1, 0, 2), VK_IMAGE_LAYOUT_GENERAL);
+      LOFI_CHECK(states.GetRunCount() == 3);
+      LOFI_CHECK(states.Get(0, 1).Layout == VK_IMAGE_LAYOUT_UNDEFINED);
+      LOFI_CHECK(states.Get(1, 0).Layout == VK_IMAGE_LAYOUT_GENERAL);
+      LOFI_CHECK(states.Get(1, 1).Layout == VK_IMAGE_LAYOUT_GENERAL);
+      LOFI_CHECK(states.Get(2, 0).Layout == VK_IMAGE_LAYOUT_UNDEFINED);
+
+      // one layer of the last run splits it again
+      SetLayout(states, Range(2, 1, 1, 1), VK_IMAGE_LAYOUT_GENERAL);
+      LOFI_CHECK(states.GetRunCount() == 5);
+      LOFI_CHECK(states.Get(2, 0).Layout == VK_IMAGE_LAYOUT_UNDEFINED);
+      LOFI_CHECK(states.Get(2, 1).Layout == VK_IMAGE_LAYOUT_GENERAL);
+      LOFI_CHECK(states.Get(3, 0).Layout == VK_IMAGE_LAYOUT_UNDEFINED);
+
+      // the layer between the two GENERAL runs joins them into one
+      SetLayout(states, Range(2, 1, 0, 1), VK_IMAGE_LAYOUT_GENERAL);
+      LOFI_CHECK(states.GetRunCount() == 3);
+      LOFI_CHECK(states.Get(1, 0).Layout == VK_IMAGE_LAYOUT_GENERAL);
+      LOFI_CHECK(states.Get(2, 1).Layout == VK_IMAGE_LAYOUT_GENERAL);
+
+      // and going back to the neighbours' state merges everything
+      SetLayout(states, Range(1, 2, 0, 2), VK_IMAGE_LAYOUT_UNDEFINED);
+      LOFI_CHECK(states.GetRunCount() == 1);
+}
+
+static void TestParts() {
+      ImageSubresourceStates states{};
+      states.Init(4, 2, VK_IMAGE_LAYOUT_UNDEFINED);
+
+      // a uniform range is one part, with the remaining counts resolved
+      uint32_t parts = 0;
+      states.Update(Range(0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS), [&](const VkImageSubresourceRange& part, SubresourceState&) {
+            parts++;
+            LOFI_CHECK(part.baseMipLevel == 0 && part.levelCount == 4);
+            LOFI_CHECK(part.baseArrayLayer == 0 && part.layerCount == 2);
+      });
+      LOFI_CHECK(parts == 1);
+
+      // mixed states split at every run and never cross a mip level
+      SetLayout(states, Range(1, 1, 0, 2), VK_IMAGE_LAYOUT_GENERAL);
+      SetLayout(states, Range(2, 1, 1, 1), VK_IMAGE_LAYOUT_GENERAL);
+      parts = 0;
+      states.Update(Range(0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS), [&](const VkImageSubresourceRange& part, SubresourceState& state) {
+            parts++;
+            LOFI_CHECK(part.levelCount == 1);
+            LOFI_CHECK(part.baseArrayLayer + part.layerCount <= 2);
+            state.Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      });
+      LOFI_CHECK(parts == 5);
+      LOFI_CHECK(states.GetRunCount() == 1);
+      LOFI_CHECK(states.Get(3, 1).Layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+      // a part left unchanged doesn't split anything
+      states.Update(Range(2, 1, 0, 1), [](const VkImageSubresourceRange&, SubresourceState&) {});
+      LOFI_CHECK(states.GetRunCount() == 1);
+}
+
+static void TestAccessState() {
+      ImageSubresourceStates states{};
+      states.Init(2, 1, VK_IMAGE_LAYOUT_GENERAL);
+
+      // runs compare the access state too, not only the layout
+      states.Update(Range(1, 1, 0, 1), [](const VkImageSubresourceRange&, SubresourceState& state) {
+            state.Access.WriteStage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            state.Access.WriteAccess = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+      });
+      LOFI_CHECK(states.GetRunCount() == 2);
+      LOFI_CHECK(states.Get(0, 0).Access.WriteStage == VK_PIPELINE_STAGE_2_NONE);
+      LOFI_CHECK(states.Get(1, 0).Access.WriteAccess == VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+      // out of range bases clamp to the image instead of indexing past the runs
+      SetLayout(states, Range(7, 1, 3, 1), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      LOFI_CHECK(states.Get(1, 0).Layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      LOFI_CHECK(states.Get(0, 0).Layout == VK_IMAGE_LAYOUT_GENERAL);
+}
+
+int main() {
+      TestSplitAndMerge();
+      TestParts();
+      TestAccessState();
+      return LoFi::Test::Failures;
+}
@@ -0,0 +1,30 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// written by LoFiShaderCodegen at build time from Shaders/CodegenTest.*.glsl, this file compiling is the test
+#include "CodegenTestShader.h"
+
+using Transform = CodegenTest::TransformStruct;
+using TransformParam = CodegenTest::TransformParam;
+
+// std430: mat4 and vec3 align to 16, the float after the vec3 fills its last 4 bytes
+static_assert(offsetof(Transform, model) == 0);
+static_assert(offsetof(Transform, tint) == 64);
+static_assert(offsetof(Transform, scale) == 76);
+static_assert(offsetof(Transform, offset) == 80);
+static_assert(offsetof(Transform, flags) == 88);
+
+static_assert(std::is_same_v<decltype(Transform::model), std::array<float, 16>>);
+static_assert(std::is_same_v<decltype(Transform::tint), std::array<float, 3>>);
+static_assert(std::is_same_v<decltype(Transform::scale), float>);
+static_assert(std::is_same_v<decltype(Transform::flags), uint32_t>);
+
+static_assert(TransformParam::Self.Offset == 0 && TransformParam::Self.Size == sizeof(Transform));
+static_assert(TransformParam::scale.Offset == 76 && TransformParam::scale.Size == 4);
+static_assert(TransformParam::flags.Offset == 88 && TransformParam::flags.StructIndex == TransformParam::Self.StructIndex);
+
+int main() {
+      return 0;
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "Context.h"
+
+using namespace LoFi;
+
+// a fragment shader of about target_size bytes, the mix the front-end sees in practice: comments, STRUCTEXT and TEXTURE
+// marcos, preprocessor lines and plain functions
+static std::string GenerateSource(size_t target_size) {
+      std::string source = "#set rt = r8g8b8a8_unorm\n\nlayout(location = 0) in vec2 uv;\nlayout(location = 0) out vec4 color;\n\n";
+
+      for (uint32_t i = 0; source.size() < target_size; i++) {
+            source += std::format("// block {}, keywords like STRUCTEXT or TEXTURE inside comments never match\n", i);
+            if (i % 8 == 0) {
+                  source += std::format("STRUCTEXT Info{} {{\n      float time;\n      vec4 tint;\n      mat4 transform;\n}}\n\nTEXTURE Albedo{};\n\n", i, i);
+            }
+            source += std::format("#define SCALE_{} {}.5\n", i, i % 16);
+            source += std::format("vec4 Shade{}(vec2 p) {{\n      float d = length(p - vec2(0.{}, 0.5)) * SCALE_{};\n", i, i % 10, i);
+            source += "      /* a block comment\n         over two lines */\n";
+            source += "      return vec4(sin(d), cos(d), d * d, 1.0);\n}\n\n";
+      }
+
+      source += "void FSMain() {\n      color = Shade0(uv);\n}\n";
+      return source;
+}
+
+int main(int argc, char** argv) {
+      const uint32_t iterations = argc > 1 ? (uint32_t)std::max(1, std::atoi(argv[1])) : 50;
+
+      Context ctx{};
+      ctx.Init({.Debug = false, .Offline = true});
+
+      const auto source = GenerateSource(100 * 1024);
+
+      double lexer_best = 1e30, lexer_total = 0;
+      double marco_best = 1e30, marco_total = 0;
+
+      for (uint32_t i = 0; i < iterations; i++) {
+            const auto lexer_begin = std::chrono::steady_clock::now();
+            const auto tokens = Internal::ShaderLexer::Tokenize(source);
+            const double lexer_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lexer_begin).count();
+
+            // a fresh program each round, the marco tables start empty like in a real compile
+            auto& world = *Internal::volkGetLoadedEcsWorld();
+            const auto id = world.create();
+            Component::Program program{id};
+
+            std::string output{};
+            std::string error{};
+            const auto marco_begin = std::chrono::steady_clock::now();
+            if (!program.PreprocessStage(tokens, GLSLANG_STAGE_FRAGMENT, output, error)) {
+                  std::cerr << "ShaderFrontendBenchmark - ParseMarco failed:\n" << error << "\n";
+                  return 1;
+            }
+            const double marco_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - marco_begin).count();
+            world.destroy(id);
+
+            lexer_best = std::min(lexer_best, lexer_time);
+            lexer_total += lexer_time;
+            marco_best = std::min(marco_best, marco_time);
+            marco_total += marco_time;
+      }
+
+      const double megabytes = (double)source.size() / (1024.0 * 1024.0);
+      std::cout << std::format("ShaderFrontendBenchmark - {} bytes, {} iterations\n", source.size(), iterations);
+      std::cout << std::format("      Lexer       best {:.3f} ms, mean {:.3f} ms, {:.1f} MB/s\n", lexer_best, lexer_total / iterations, megabytes / (lexer_best / 1000.0));
+      std::cout << std::format("      ParseMarco  best {:.3f} ms, mean {:.3f} ms, {:.1f} MB/s\n", marco_best, marco_total / iterations, megabytes / (marco_best / 1000.0));
+      return 0;
+}
@@ -0,0 +1,91 @@
+#include "Check.h"
+#include "Context.h"
+
+using namespace LoFi;
+
+static const char* VertexSource = R"(
+      layout(location = 0) in vec3 pos;
+
+      STRUCTEXT Flags {
+            float scale;
+            bool enabled;
+            uint count;
+      }
+
+      void VSMain() {
+            float s = GetVar(Flags).enabled ? GetVar(Flags).scale : float(GetVar(Flags).count);
+            gl_Position = vec4(pos * s, 1.0f);
+      }
+)";
+
+static const char* FragmentSource = R"(
+      #set rt = r8g8b8a8_unorm
+
+      layout(location = 0) out vec4 color;
+
+      void FSMain() {
+            color = vec4(1.0f);
+      }
+)";
+
+static const char* ReservedVertexSource = R"(
+      layout(location = 0) in vec3 pos;
+
+      STRUCTEXT Bounds {
+            float Self;
+      }
+
+      void VSMain() {
+            gl_Position = vec4(pos * GetVar(Bounds).Self, 1.0f);
+      }
+)";
+
+// a bool member reflects to the same 4 byte uint SetKernelParameter<bool> writes and validates against
+static void TestBoolMember(Context& ctx) {
+      const auto id = ctx.CreateProgram({VertexSource, FragmentSource}, "ShaderReflectionTest");
+      LOFI_CHECK(id != entt::null);
+      if (id == entt::null) return;
+
+      const auto& program = Internal::volkGetLoadedEcsWorld()->get<Component::Program>(id);
+      const auto& members = program.GetStructMemberTable();
+
+      const auto enabled = members.find("Flags.enabled");
+      LOFI_CHECK(enabled != members.end());
+      if (enabled == members.end()) return;
+
+      constexpr auto bool_name = Component::ShaderTypeName<bool>::Value;
+      LOFI_CHECK(enabled->second.Size == sizeof(uint32_t));
+      LOFI_CHECK(enabled->second.Offset == 4);
+      LOFI_CHECK(enabled->second.TypeHash == XXH64(bool_name.data(), bool_name.size(), 0));
+
+      // the uint next to it hashes the same, the value type only differs on the c++ side
+      const auto count = members.find("Flags.count");
+      LOFI_CHECK(count != members.end() && count->second.TypeHash == enabled->second.TypeHash);
+
+      const auto header = ctx.GenerateProgramCppHeader(id, "ShaderReflectionTest");
+      LOFI_CHECK(header.find("uint32_t enabled;") != std::string::npos);
+}
+
+// "Self" is the handle of the whole struct in the generated header, a member can't take it
+static void TestReservedMemberName(Context& ctx) {
+      const auto id = ctx.CreateProgram({ReservedVertexSource, FragmentSource}, "ShaderReflectionTestReserved");
+      LOFI_CHECK(id != entt::null);
+      if (id == entt::null) return;
+
+      bool threw = false;
+      try {
+            (void)ctx.GenerateProgramCppHeader(id, "ShaderReflectionTest");
+      } catch (const std::runtime_error&) {
+            threw = true;
+      }
+      LOFI_CHECK(threw);
+}
+
+int main() {
+      Context ctx{};
+      ctx.Init({.Debug = false, .Offline = true});
+
+      TestBoolMember(ctx);
+      TestReservedMemberName(ctx);
+      return Test::Failures;
+}
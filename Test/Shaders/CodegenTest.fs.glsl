@@ -0,0 +1,7 @@
+#set rt = r8g8b8a8_unorm
+
+layout(location = 0) out vec4 color;
+
+void FSMain() {
+      color = vec4(1.0f);
+}
@@ -0,0 +1,14 @@
+layout(location = 0) in vec3 pos;
+
+STRUCTEXT Transform {
+      mat4 model;
+      vec3 tint;
+      float scale;
+      vec2 offset;
+      uint flags;
+}
+
+void VSMain() {
+      vec3 p = pos * GetVar(Transform).scale + vec3(GetVar(Transform).offset, float(GetVar(Transform).flags));
+      gl_Position = GetVar(Transform).model * vec4(p + GetVar(Transform).tint, 1.0f);
+}
@@ -0,0 +1,52 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "Context.h"
+
+// LoFiShaderCodegen <output header> <namespace> <source files...>
+int main(int argc, char** argv) {
+      if (argc < 4) {
+            std::cerr << "usage: LoFiShaderCodegen <output header> <namespace> <source files...>\n";
+            return 1;
+      }
+
+      std::vector<std::string> sources;
+      for (int i = 3; i < argc; i++) {
+            std::ifstream file(argv[i], std::ios::binary);
+            if (!file) {
+                  std::cerr << "LoFiShaderCodegen - can't open " << argv[i] << "\n";
+                  return 1;
+            }
+            std::stringstream ss;
+            ss << file.rdbuf();
+            sources.push_back(ss.str());
+      }
+
+      std::vector<std::string_view> views{sources.begin(), sources.end()};
+
+      try {
+            LoFi::Context ctx{};
+            ctx.Init({.Debug = false, .Offline = true});
+
+            const auto program = ctx.CreateProgram(views, argv[2]);
+            if (program == entt::null) {
+                  std::cerr << "LoFiShaderCodegen - failed to compile program " << argv[2] << "\n";
+                  return 1;
+            }
+
+            const auto header = ctx.GenerateProgramCppHeader(program, argv[2]);
+
+            std::ofstream out(argv[1], std::ios::binary);
+            if (!out) {
+                  std::cerr << "LoFiShaderCodegen - can't write " << argv[1] << "\n";
+                  return 1;
+            }
+            out << header;
+      } catch (const std::exception& e) {
+            std::cerr << "LoFiShaderCodegen - " << e.what() << "\n";
+            return 1;
+      }
+
+      return 0;
+}